@@ -0,0 +1,294 @@
+# in-process binding of the simulator through the C API (src/capi.h), no text files in between
+# result arrays are NumPy views over buffers owned by the simulator, valid while the Run is alive
+
+import ctypes
+import os
+
+import numpy as np
+
+STRATEGIES = {"V1": 0, "V1B": 1, "V2": 2, "V2B": 3, "V3": 4}
+EVALUATORS = {"V0": 0, "V1": 1}
+
+_c_double_p = ctypes.POINTER(ctypes.c_double)
+_c_int32_p = ctypes.POINTER(ctypes.c_int32)
+_c_uint8_p = ctypes.POINTER(ctypes.c_uint8)
+_c_char_pp = ctypes.POINTER(ctypes.c_char_p)
+
+
+def _load(path=None):
+    here = os.path.dirname(os.path.abspath(__file__))
+    default = os.path.join(here, "..", "build", "libdssim.so")
+    path = path or os.environ.get("DSSIM_LIB") or default
+    lib = ctypes.CDLL(path)
+    lib.ds_last_error.restype = ctypes.c_char_p
+    lib.ds_set_logging.argtypes = [ctypes.c_int]
+    lib.ds_scenario_create.restype = ctypes.c_void_p
+    lib.ds_scenario_create.argtypes = (
+        [ctypes.c_int32, _c_char_pp, _c_double_p, _c_double_p, _c_double_p]
+        + [ctypes.c_int32, _c_int32_p, _c_int32_p, _c_double_p, _c_double_p]
+        + [ctypes.c_int32, _c_char_pp, _c_double_p, _c_int32_p, _c_int32_p, _c_int32_p]
+    )
+    lib.ds_scenario_read.restype = ctypes.c_void_p
+    lib.ds_scenario_read.argtypes = [ctypes.c_char_p]
+    lib.ds_scenario_free.argtypes = [ctypes.c_void_p]
+    lib.ds_scenario_station_cnt.restype = ctypes.c_int32
+    lib.ds_scenario_station_cnt.argtypes = [ctypes.c_void_p]
+    lib.ds_scenario_order_cnt.restype = ctypes.c_int32
+    lib.ds_scenario_order_cnt.argtypes = [ctypes.c_void_p]
+    lib.ds_scenario_station_id.restype = ctypes.c_char_p
+    lib.ds_scenario_station_id.argtypes = [ctypes.c_void_p, ctypes.c_int32]
+    lib.ds_scenario_order_id.restype = ctypes.c_char_p
+    lib.ds_scenario_order_id.argtypes = [ctypes.c_void_p, ctypes.c_int32]
+    lib.ds_run_create.restype = ctypes.c_void_p
+    lib.ds_run_create.argtypes = [ctypes.c_void_p, ctypes.c_int32]
+    lib.ds_run_free.argtypes = [ctypes.c_void_p]
+    lib.ds_run_execute.restype = ctypes.c_int64
+    lib.ds_run_execute.argtypes = [ctypes.c_void_p]
+    lib.ds_run_until.restype = ctypes.c_int64
+    lib.ds_run_until.argtypes = [ctypes.c_void_p, ctypes.c_double]
+    lib.ds_run_step.restype = ctypes.c_int64
+    lib.ds_run_step.argtypes = [ctypes.c_void_p, ctypes.c_int64]
+    lib.ds_run_done.restype = ctypes.c_int
+    lib.ds_run_done.argtypes = [ctypes.c_void_p]
+    lib.ds_run_now.restype = ctypes.c_double
+    lib.ds_run_now.argtypes = [ctypes.c_void_p]
+    lib.ds_run_costs.restype = ctypes.c_int32
+    lib.ds_run_costs.argtypes = [ctypes.c_void_p, _c_int32_p, ctypes.c_int32, _c_double_p]
+    lib.ds_run_occupancy.restype = ctypes.c_int64
+    lib.ds_run_occupancy.argtypes = [ctypes.c_void_p] + [ctypes.POINTER(_c_double_p)] + [
+        ctypes.POINTER(_c_int32_p)
+    ] * 2
+    lib.ds_run_trips.restype = ctypes.c_int64
+    lib.ds_run_trips.argtypes = [ctypes.c_void_p] + [ctypes.POINTER(_c_double_p)] + [
+        ctypes.POINTER(_c_int32_p)
+    ] * 3
+    lib.ds_run_packages.restype = ctypes.c_int64
+    lib.ds_run_packages.argtypes = [
+        ctypes.c_void_p,
+        ctypes.POINTER(_c_double_p),
+        ctypes.POINTER(_c_double_p),
+        ctypes.POINTER(_c_uint8_p),
+    ]
+    return lib
+
+
+_lib = None
+
+
+def lib():
+    global _lib
+    if _lib is None:
+        _lib = _load()
+    return _lib
+
+
+def _check(handle):
+    if not handle:
+        raise RuntimeError(lib().ds_last_error().decode())
+    return handle
+
+
+def _strings(values):
+    encoded = [str(v).encode() for v in values]
+    return (ctypes.c_char_p * len(encoded))(*encoded)
+
+
+def _array(values, dtype):
+    return np.ascontiguousarray(values, dtype=dtype)
+
+
+def _ptr(array, ctype):
+    return array.ctypes.data_as(ctypes.POINTER(ctype))
+
+
+def set_logging(enabled):
+    """per-event stdout logging of every simulation in this process"""
+    lib().ds_set_logging(int(enabled))
+
+
+class Scenario:
+    """immutable stations, routes and orders, shared by any number of Runs"""
+
+    def __init__(self, handle):
+        self._handle = _check(handle)
+
+    def __del__(self):
+        if getattr(self, "_handle", None):
+            lib().ds_scenario_free(self._handle)
+            self._handle = None
+
+    @classmethod
+    def read(cls, path):
+        return cls(lib().ds_scenario_read(str(path).encode()))
+
+    @classmethod
+    def from_arrays(cls, stations, routes, orders):
+        """stations: dict of id, throughput, process_delay, cost
+        routes: dict of src, dst (station indices), time, cost
+        orders: dict of id, time, ctg (0 standard / 1 express), src, dst (station indices)"""
+        # keep every converted array referenced until the call returns
+        keep = {
+            "station_id": _strings(stations["id"]),
+            "throughput": _array(stations["throughput"], np.float64),
+            "process_delay": _array(stations["process_delay"], np.float64),
+            "station_cost": _array(stations["cost"], np.float64),
+            "route_src": _array(routes["src"], np.int32),
+            "route_dst": _array(routes["dst"], np.int32),
+            "route_time": _array(routes["time"], np.float64),
+            "route_cost": _array(routes["cost"], np.float64),
+            "order_id": _strings(orders["id"]),
+            "order_time": _array(orders["time"], np.float64),
+            "order_ctg": _array(orders["ctg"], np.int32),
+            "order_src": _array(orders["src"], np.int32),
+            "order_dst": _array(orders["dst"], np.int32),
+        }
+        f64, i32 = ctypes.c_double, ctypes.c_int32
+        handle = lib().ds_scenario_create(
+            len(keep["station_id"]),
+            keep["station_id"],
+            _ptr(keep["throughput"], f64),
+            _ptr(keep["process_delay"], f64),
+            _ptr(keep["station_cost"], f64),
+            len(keep["route_src"]),
+            _ptr(keep["route_src"], i32),
+            _ptr(keep["route_dst"], i32),
+            _ptr(keep["route_time"], f64),
+            _ptr(keep["route_cost"], f64),
+            len(keep["order_id"]),
+            keep["order_id"],
+            _ptr(keep["order_time"], f64),
+            _ptr(keep["order_ctg"], i32),
+            _ptr(keep["order_src"], i32),
+            _ptr(keep["order_dst"], i32),
+        )
+        return cls(handle)
+
+    @property
+    def stations(self):
+        n = lib().ds_scenario_station_cnt(self._handle)
+        return [lib().ds_scenario_station_id(self._handle, i).decode() for i in range(n)]
+
+    @property
+    def orders(self):
+        n = lib().ds_scenario_order_cnt(self._handle)
+        return [lib().ds_scenario_order_id(self._handle, i).decode() for i in range(n)]
+
+
+class Run:
+    """one simulation of a Scenario under a strategy; no CSV is written"""
+
+    def __init__(self, scenario, strategy="V3"):
+        self.scenario = scenario
+        self._handle = _check(lib().ds_run_create(scenario._handle, STRATEGIES[strategy]))
+        self.events = None
+
+    def __del__(self):
+        if getattr(self, "_handle", None):
+            lib().ds_run_free(self._handle)
+            self._handle = None
+
+    def run(self):
+        """run to the end, continuing from where run_until / step stopped"""
+        events = lib().ds_run_execute(self._handle)
+        if events < 0:
+            raise RuntimeError(lib().ds_last_error().decode())
+        self.events = events
+        return self
+
+    def run_until(self, time):
+        """process every event not later than `time`; returns the number processed"""
+        n = lib().ds_run_until(self._handle, float(time))
+        if n < 0:
+            raise RuntimeError(lib().ds_last_error().decode())
+        return n
+
+    def step(self, n):
+        """process at most n events; returns the number processed"""
+        n = lib().ds_run_step(self._handle, int(n))
+        if n < 0:
+            raise RuntimeError(lib().ds_last_error().decode())
+        return n
+
+    @property
+    def done(self):
+        return bool(lib().ds_run_done(self._handle))
+
+    @property
+    def now(self):
+        """simulated time of the last processed event"""
+        return lib().ds_run_now(self._handle)
+
+    def costs(self, evaluators=("V0", "V1")):
+        """total cost under each evaluator, from the same single simulation"""
+        ids = _array([EVALUATORS[e] for e in evaluators], np.int32)
+        res = np.empty(len(ids), dtype=np.float64)
+        ok = lib().ds_run_costs(
+            self._handle, _ptr(ids, ctypes.c_int32), len(ids), _ptr(res, ctypes.c_double)
+        )
+        if ok < 0:
+            raise RuntimeError(lib().ds_last_error().decode())
+        return dict(zip(evaluators, res.tolist()))
+
+    def _view(self, pointer, n, dtype):
+        # the view keeps this Run alive through its base, so the buffer outlives the array
+        if n == 0:
+            return np.empty(0, dtype=dtype)
+        array = np.ctypeslib.as_array(pointer, (n,))
+        if not self.done:
+            # buffers still grow while the run advances, so mid-run results are copied
+            return array.astype(dtype, copy=True)
+        array.flags.writeable = False
+        return np.asarray(_Owner(array, self))
+
+    def occupancy(self):
+        """columns of number_package_in_station.csv; station is an index into scenario.stations"""
+        time, station, size = _c_double_p(), _c_int32_p(), _c_int32_p()
+        n = lib().ds_run_occupancy(self._handle, time, station, size)
+        return {
+            "time": self._view(time, n, np.float64),
+            "station": self._view(station, n, np.int32),
+            "size": self._view(size, n, np.int32),
+        }
+
+    def trips(self):
+        """columns of package_trip.csv; package indexes scenario.orders,
+        src / dst index scenario.stations"""
+        time, package, src, dst = _c_double_p(), _c_int32_p(), _c_int32_p(), _c_int32_p()
+        n = lib().ds_run_trips(self._handle, time, package, src, dst)
+        return {
+            "time": self._view(time, n, np.float64),
+            "package": self._view(package, n, np.int32),
+            "src": self._view(src, n, np.int32),
+            "dst": self._view(dst, n, np.int32),
+        }
+
+    def packages(self):
+        """one row per order in scenario order"""
+        created, finished_time, finished = _c_double_p(), _c_double_p(), _c_uint8_p()
+        n = lib().ds_run_packages(self._handle, created, finished_time, finished)
+        return {
+            "time_created": self._view(created, n, np.float64),
+            "time_finished": self._view(finished_time, n, np.float64),
+            "finished": self._view(finished, n, np.uint8).view(np.bool_),
+        }
+
+
+class _Owner:
+    """exposes a view through __array_interface__ while holding a reference to its Run"""
+
+    def __init__(self, array, owner):
+        self.__array_interface__ = array.__array_interface__
+        self._array = array
+        self._owner = owner
+
+
+if __name__ == "__main__":
+    import sys
+
+    set_logging(False)
+    scenario = Scenario.read(sys.argv[1] if len(sys.argv) > 1 else "./data/data.txt")
+    for strategy in STRATEGIES:
+        run = Run(scenario, strategy).run()
+        trips = run.trips()
+        costs = run.costs()
+        print(f"{strategy:>4}: {run.events} events, {len(trips['time'])} trips, costs {costs}")
@@ -0,0 +1,154 @@
+# reader of the columnar trace written by `enable_trace` (layout: src/trace.cpp)
+# only the chunks overlapping the query are read and decoded
+
+import struct
+
+MAGIC = b"DSTRACE1"
+
+
+class _Cursor:
+    def __init__(self, data, pos=0, end=None):
+        self.data = data
+        self.pos = pos
+        self.end = len(data) if end is None else end
+
+    def f64(self):
+        (value,) = struct.unpack_from("<d", self.data, self.pos)
+        self.pos += 8
+        return value
+
+    def u64(self):
+        (value,) = struct.unpack_from("<Q", self.data, self.pos)
+        self.pos += 8
+        return value
+
+    def varint(self):
+        value, shift = 0, 0
+        while self.pos < self.end:
+            byte = self.data[self.pos]
+            self.pos += 1
+            value |= (byte & 0x7F) << shift
+            if byte & 0x80 == 0:
+                break
+            shift += 7
+        return value
+
+    def zigzag(self):
+        value = self.varint()
+        return (value >> 1) ^ -(value & 1)
+
+    def times(self, n):
+        res = []
+        while len(res) < n and self.pos < self.end:
+            run = self.varint()
+            res.extend([self.f64()] * min(run, n - len(res)))
+        return res
+
+    def deltas(self, n):
+        res, last = [], 0
+        for _ in range(n):
+            last += self.zigzag()
+            res.append(last)
+        return res
+
+
+class TraceStore:
+    def __init__(self, path):
+        self.file = open(path, "rb")
+        if self.file.read(8) != MAGIC:
+            raise ValueError(f"{path} is not a trace file")
+        self.file.seek(-16, 2)
+        (footer_offset,) = struct.unpack("<Q", self.file.read(8))
+        if self.file.read(8) != MAGIC:
+            raise ValueError(f"{path} is truncated")
+        self.file.seek(footer_offset)
+        cur = _Cursor(self.file.read()[:-16])
+
+        self.names = []
+        for _ in range(cur.varint()):
+            length = cur.varint()
+            self.names.append(cur.data[cur.pos : cur.pos + length].decode())
+            cur.pos += length
+        # (offset, length, t_min, t_max)
+        self.chunks = [(cur.u64(), cur.u64(), cur.f64(), cur.f64()) for _ in range(cur.varint())]
+        # package -> (name id, chunks)
+        self.packages = {}
+        for _ in range(cur.varint()):
+            package = cur.varint()
+            chunks, last = [], 0
+            for _ in range(cur.varint()):
+                last += cur.varint()
+                chunks.append(last)
+            self.packages[self.names[package]] = (package, chunks)
+
+    def begin_time(self):
+        return min((c[2] for c in self.chunks), default=0)
+
+    def end_time(self):
+        return max((c[3] for c in self.chunks), default=0)
+
+    def _tables(self, chunk):
+        offset, length, _, _ = self.chunks[chunk]
+        self.file.seek(offset)
+        data = self.file.read(length)
+        head = _Cursor(data)
+        sizes = [head.varint() for _ in range(6)]
+        tables, pos = [], head.pos
+        for i in range(3):
+            tables.append((sizes[2 * i], _Cursor(data, pos, pos + sizes[2 * i + 1])))
+            pos += sizes[2 * i + 1]
+        return tables
+
+    @staticmethod
+    def _trip_rows(n, cur):
+        time = cur.times(n)
+        package = cur.deltas(n)
+        src = cur.deltas(n)
+        dst = [s + cur.zigzag() for s in src]
+        return zip(time, package, src, dst)
+
+    def window(self, t0, t1):
+        """rows with t0 <= time <= t1 as (occupancy, trips, events) lists of tuples,
+        column order matches number_package_in_station.csv / package_trip.csv"""
+        name = self.names
+        occupancy, trips, events = [], [], []
+        for i, (_, _, t_min, t_max) in enumerate(self.chunks):
+            if t_max < t0 or t_min > t1:
+                continue
+            (occ_n, occ), (trip_n, trip), (event_n, event) = self._tables(i)
+            time = occ.times(occ_n)
+            station = occ.deltas(occ_n)
+            for t, s in zip(time, station):
+                size = occ.zigzag()
+                if t0 <= t <= t1:
+                    occupancy.append((t, name[s], size))
+            for t, p, s, d in self._trip_rows(trip_n, trip):
+                if t0 <= t <= t1:
+                    trips.append((t, name[p], name[s], name[d]))
+            for t in event.times(event_n):
+                kind = event.varint()
+                if t0 <= t <= t1:
+                    events.append((t, name[kind]))
+        return occupancy, trips, events
+
+    def trip(self, package):
+        """all (time, package, src, dst) rows of one package"""
+        if package not in self.packages:
+            return []
+        package_id, chunks = self.packages[package]
+        res = []
+        for i in chunks:
+            trip_n, trip = self._tables(i)[1]
+            for t, p, s, d in self._trip_rows(trip_n, trip):
+                if p == package_id:
+                    res.append((t, package, self.names[s], self.names[d]))
+        return res
+
+
+if __name__ == "__main__":
+    import sys
+
+    store = TraceStore(sys.argv[1] if len(sys.argv) > 1 else "./build/trace.bin")
+    occupancy, trips, events = store.window(store.begin_time(), store.end_time())
+    print(f"{len(store.chunks)} chunks, time {store.begin_time()} ~ {store.end_time()}")
+    print(f"{len(occupancy)} occupancy rows, {len(trips)} trips, {len(events)} events")
@@ -135,7 +135,7 @@ def data_gen():
         id = uuid.uuid4()
         packets.append((id, create_time, category, f"s{src}", f"s{dst}"))
     # Sort packets by create time
-    packets.sort(key=lambda x: x[0])    # Sort by create time from small to large
+    packets.sort(key=lambda x: x[1])    # Sort by create time from small to large
     # Output Packets
     # for packet in packets:
     #     print(uuid.uuid4(), packet)
@@ -0,0 +1,43 @@
+#include "arena.hpp"
+
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+namespace arena {
+
+namespace {
+
+struct Scratch {
+    // 一次决策的临时容器通常放得下；不够时向上游申请，release 时一并归还
+    std::vector<std::byte> initial = std::vector<std::byte>(64 * 1024);
+    std::pmr::monotonic_buffer_resource resource { this->initial.data(), this->initial.size() };
+    int depth = 0;
+};
+
+Scratch& local() {
+    thread_local Scratch scratch;
+    return scratch;
+}
+
+} // namespace
+
+std::pmr::memory_resource* scratch() {
+    // 范围外分配的内存不会随决策归还，之后打开的 Scope 结束时还会被提前释放
+    assert(local().depth > 0);
+    return &local().resource;
+}
+
+Scope::Scope() {
+    local().depth += 1;
+}
+
+Scope::~Scope() {
+    Scratch& scratch = local();
+    scratch.depth -= 1;
+    if (scratch.depth == 0) {
+        scratch.resource.release();
+    }
+}
+
+} // namespace arena
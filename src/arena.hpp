@@ -0,0 +1,24 @@
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include <memory_resource>
+
+namespace arena {
+
+// 路径规划的临时内存：每个线程一块，只分配不逐个释放
+// 最外层的 Scope 结束时整块归还，下一次决策从头复用同一块内存
+// 只给调用内的临时容器（dist、prev、堆）用，返回值和缓存不能放在这里
+// 只能在 Scope 内调用
+std::pmr::memory_resource* scratch();
+
+// 一次决策的范围，可以嵌套
+struct Scope {
+public:
+    Scope();
+    ~Scope();
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+};
+
+} // namespace arena
+#endif
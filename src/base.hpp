@@ -1,6 +1,8 @@
 #ifndef BASE_HPP
 #define BASE_HPP
 
+#include <map>
+#include <memory_resource>
 #include <set>
 #include <string>
 
@@ -25,7 +27,8 @@ public:
     double cost;
 
     // dynamic
-    set<string> buffer;
+    // 节点从所属模拟的 arena 分配，见 SimulationBase::resource
+    std::pmr::set<string> buffer;
     // 下一个可以开始处理的时间
     double start_process_ok_time = std::numeric_limits<double>::min();
     // optional<string> processing_package;
@@ -54,5 +57,8 @@ struct Package {
     double time_finished;
 };
 
+// 一次模拟的全部包裹，节点从该模拟的 arena 分配
+using Packages = std::pmr::map<string, Package>;
+
 } // namespace base
 #endif
@@ -0,0 +1,599 @@
+// 性能基准：微基准（事件队列、选包、各路径规划）与宏基准（各 StrategyVersion 跑放大后的数据）
+// ./bench [--data ../data/data.txt] [--scales 1,10,100,1000] [--repeat 10] [--warmup 2]
+//         [--filter route/] [--json bench.json]
+// 模拟日志（stdout）重定向到 /dev/null，结果打印到 stderr，--json 时另存一份便于跨 commit 比较
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <queue>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "fmt/core.h"
+
+#include "base.hpp"
+#include "eval.hpp"
+#include "event.hpp"
+#include "log.hpp"
+#include "pool.hpp"
+#include "sim.hpp"
+#include "strategy.hpp"
+#include "strategy/alt.hpp"
+#include "strategy/ch.hpp"
+#include "strategy/delta.hpp"
+#include "strategy/dense.hpp"
+#include "strategy/v1.hpp"
+#include "strategy/v2.hpp"
+#include "strategy/v3.hpp"
+
+namespace bench {
+using std::map;
+using std::string;
+using std::vector;
+
+using base::Package;
+using base::PackageCategory;
+using base::Route;
+using base::Station;
+using eval::EvaluateVersion;
+using strategy::StrategyVersion;
+
+struct Options {
+    string data = "../data/data.txt";
+    vector<int> scales = { 1 };
+    int repeat = 10;
+    int warmup = 2;
+    string filter;
+    string json;
+};
+
+struct Result {
+    string name;
+    long long items; // 每次试验处理的查询 / 包裹数
+    vector<double> trials_ms;
+    double cost = 0; // 宏基准的评估代价，用于确认不同 commit 跑的是同一个结果
+};
+
+struct Stats {
+    double mean;
+    double stddev;
+    double median;
+    double min;
+    double ci_low; // 均值的 95% 置信区间
+    double ci_high;
+};
+
+// 双侧 95% 的 t 分位数
+double t_quantile(int dof) {
+    static const double table[] = {
+        12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201,  2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080,  2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+    };
+    if (dof <= 0) {
+        return 0;
+    }
+    return dof <= 30 ? table[dof - 1] : 1.96;
+}
+
+Stats summarize(vector<double> trials) {
+    const int n = trials.size();
+    Stats s {};
+    for (double t: trials) {
+        s.mean += t;
+    }
+    s.mean /= n;
+    for (double t: trials) {
+        s.stddev += (t - s.mean) * (t - s.mean);
+    }
+    s.stddev = n > 1 ? std::sqrt(s.stddev / (n - 1)) : 0;
+    std::sort(trials.begin(), trials.end());
+    s.median = n % 2 ? trials[n / 2] : (trials[n / 2 - 1] + trials[n / 2]) / 2;
+    s.min = trials.front();
+    const double half = t_quantile(n - 1) * s.stddev / std::sqrt(n);
+    s.ci_low = s.mean - half;
+    s.ci_high = s.mean + half;
+    return s;
+}
+
+template<typename F>
+double time_ms(F&& f) {
+    auto start = std::chrono::high_resolution_clock::now();
+    f();
+    auto spent = std::chrono::high_resolution_clock::now() - start;
+    return std::chrono::duration<double, std::milli>(spent).count();
+}
+
+// trial() 自行计时并返回毫秒数，以便把准备工作排除在外；被 filter 跳过时返回 nullptr
+Result* measure(
+    const Options& options,
+    vector<Result>& results,
+    const string& name,
+    long long items,
+    const std::function<double()>& trial
+) {
+    if (name.find(options.filter) == string::npos) {
+        return nullptr;
+    }
+    for (int i = 0; i < options.warmup; i++) {
+        trial();
+    }
+    Result result { name, items, {} };
+    for (int i = 0; i < options.repeat; i++) {
+        result.trials_ms.push_back(trial());
+    }
+    const Stats s = summarize(result.trials_ms);
+    log::ecargo(
+        "Bench",
+        "{:<28} {:>10.3f}ms ± {:<8.3f} [{:.3f}, {:.3f}] {:>10.1f} items/s",
+        name,
+        s.mean,
+        s.stddev,
+        s.ci_low,
+        s.ci_high,
+        items / s.mean * 1e3
+    );
+    results.push_back(std::move(result));
+    return &results.back();
+}
+
+// 从数据文件读出的场景，路线按 id 排序以保证重新建图后 id 一致
+struct Scenario {
+    vector<Station> stations;
+    vector<Route> routes;
+    vector<Package> orders;
+
+    map<string, Station> station_map() const {
+        map<string, Station> res;
+        for (const auto& station: this->stations) {
+            res.emplace(station.id, station);
+        }
+        return res;
+    }
+    map<string, map<int, Route>> route_map() const {
+        map<string, map<int, Route>> res;
+        for (const auto& station: this->stations) {
+            res[station.id];
+        }
+        for (const auto& route: this->routes) {
+            res[route.src].emplace(route.id, route);
+        }
+        return res;
+    }
+    void feed(sim::SimulationBase& sim) const {
+        for (const auto& s: this->stations) {
+            sim.add_station(s.id, s.throughput, s.process_delay, s.cost);
+        }
+        for (const auto& r: this->routes) {
+            sim.add_route(r.src, r.dst, r.time, r.cost);
+        }
+        for (const auto& p: this->orders) {
+            sim.add_order(p.id, p.time_created, p.category, p.src, p.dst);
+        }
+    }
+};
+
+Scenario load(const string& path) {
+    sim::Simulation<strategy::v1::V1Policy> sim;
+    sim.read_data(path);
+    Scenario scenario;
+    for (const auto& [id, station]: sim.stations) {
+        scenario.stations.push_back(Station {
+            station.id, station.throughput, station.process_delay, station.cost });
+    }
+    for (const auto& [src, edges]: sim.routes()) {
+        for (const auto& [id, route]: edges) {
+            scenario.routes.push_back(route);
+        }
+    }
+    std::sort(scenario.routes.begin(), scenario.routes.end(), [](const Route& a, const Route& b) {
+        return a.id < b.id;
+    });
+    for (const auto& [id, pkg]: sim.packages) {
+        scenario.orders.push_back(pkg);
+    }
+    return scenario;
+}
+
+// 放大 k 倍：订单按原时间跨度平移 k 次，包裹 id 加后缀，结果确定
+Scenario scale(const Scenario& base, int k) {
+    Scenario res { base.stations, base.routes, {} };
+    double first = std::numeric_limits<double>::max();
+    double last = std::numeric_limits<double>::lowest();
+    for (const auto& p: base.orders) {
+        first = std::min(first, p.time_created);
+        last = std::max(last, p.time_created);
+    }
+    const double span = last - first + 1;
+    for (int i = 0; i < k; i++) {
+        for (const auto& p: base.orders) {
+            Package pkg = p;
+            pkg.id = i == 0 ? p.id : fmt::format("{}#{}", p.id, i);
+            pkg.time_created = p.time_created + i * span;
+            res.orders.push_back(pkg);
+        }
+    }
+    return res;
+}
+
+struct NopEvent: public event::Event {
+    explicit NopEvent(double t): Event(t) {}
+    void process_event() override {}
+};
+
+void micro_event_queue(const Options& options, vector<Result>& results) {
+    const int n = 200000;
+    measure(options, results, "engine/event-queue", n, [&]() {
+        std::mt19937 rng(42);
+        std::uniform_real_distribution<double> uni(0, 1e4);
+        vector<NopEvent> events;
+        events.reserve(n);
+        for (int i = 0; i < n; i++) {
+            events.emplace_back(uni(rng));
+        }
+        return time_ms([&]() {
+            std::priority_queue<event::Event*, vector<event::Event*>, event::EventComparator> q;
+            for (auto& e: events) {
+                q.push(&e);
+            }
+            while (!q.empty()) {
+                q.top()->process_event();
+                q.pop();
+            }
+        });
+    });
+}
+
+void micro_select(const Options& options, vector<Result>& results, const Scenario& scenario) {
+    // 把 n 个包裹塞进同一个站点的 buffer，反复选包
+    const int n = 2000;
+    const int rounds = 200;
+    const string station = scenario.stations.front().id;
+    auto fill = [&](sim::SimulationBase& sim) {
+        for (const auto& s: scenario.stations) {
+            sim.add_station(s.id, s.throughput, s.process_delay, s.cost);
+        }
+        for (int i = 0; i < n && i < (int)scenario.orders.size(); i++) {
+            Package pkg = scenario.orders[i];
+            sim.packages[pkg.id] = pkg;
+            sim.stations.at(station).buffer.insert(pkg.id);
+        }
+    };
+    measure(options, results, "select/V2", rounds, [&]() {
+        sim::Simulation<strategy::v2::V2Policy> sim;
+        fill(sim);
+        return time_ms([&]() {
+            for (int i = 0; i < rounds; i++) {
+                sim.policy.select(sim, station);
+            }
+        });
+    });
+    measure(options, results, "select/V2B", rounds, [&]() {
+        sim::Simulation<strategy::v2::V2BPolicy> sim;
+        fill(sim);
+        return time_ms([&]() {
+            for (int i = 0; i < rounds; i++) {
+                sim.policy.select(sim, station);
+            }
+        });
+    });
+    measure(options, results, "select/V3-index", n, [&]() {
+        sim::Simulation<strategy::v3::V3Policy> sim;
+        fill(sim);
+        strategy::v3::BufferIndex index;
+        return time_ms([&]() {
+            for (const auto& id: sim.stations.at(station).buffer) {
+                index.add(sim.packages.at(id));
+            }
+            while (!index.groups.empty()) {
+                const auto& group = index.groups.begin()->second;
+                index.remove(sim.packages.at(group.head().second));
+            }
+        });
+    });
+}
+
+void micro_route(const Options& options, vector<Result>& results, const Scenario& scenario) {
+    const auto stations = scenario.station_map();
+    const auto routes = scenario.route_map();
+    // 固定的随机查询对
+    vector<std::pair<string, string>> queries;
+    std::mt19937 rng(2024);
+    for (int i = 0; i < 200; i++) {
+        const auto& src = scenario.stations[rng() % scenario.stations.size()].id;
+        const auto& dst = scenario.stations[rng() % scenario.stations.size()].id;
+        queries.emplace_back(src, dst);
+    }
+    const long long q = queries.size();
+    auto each_query = [&](auto&& route) {
+        return time_ms([&]() {
+            for (const auto& [src, dst]: queries) {
+                route(src, dst);
+            }
+        });
+    };
+    const strategy::ch::ContractionHierarchy hierarchy(stations, routes);
+    const strategy::alt::AltGraph alt_graph(stations, routes);
+    const strategy::v2::V2Cache cache(stations);
+    const strategy::dense::DenseGraph dense_graph(stations, routes);
+    const strategy::delta::CsrGraph csr_graph(stations, routes);
+
+    measure(options, results, "route/dijkstra", q, [&]() {
+        return each_query([&](const string& s, const string& t) {
+            strategy::dijkstra(stations, routes, s, t);
+        });
+    });
+    measure(options, results, "route/dijkstra_enhanced", q, [&]() {
+        return each_query([&](const string& s, const string& t) {
+            strategy::dijkstra_enhanced(stations, routes, s, t);
+        });
+    });
+    measure(options, results, "route/ch", q, [&]() {
+        return each_query([&](const string& s, const string& t) {
+            strategy::dijkstra(hierarchy, s, t);
+        });
+    });
+    // V1B 的满站避让：满站标记由策略维护，这里不含判定的开销
+    vector<bool> full(alt_graph.size(), false);
+    for (int v = 0; v < alt_graph.size(); v++) {
+        const Station& station = stations.at(alt_graph.name_of(v));
+        full[v] = station.buffer.size()
+            > strategy::FULL_STANDARD_COEFFICIENT * station.throughput;
+    }
+    measure(options, results, "route/penalized", q, [&]() {
+        return each_query([&](const string& s, const string& t) {
+            strategy::alt::penalized_dijkstra(alt_graph, s, t, full);
+        });
+    });
+    measure(options, results, "route/ch-penalized", q, [&]() {
+        return each_query([&](const string& s, const string& t) {
+            strategy::dijkstra_enhanced(hierarchy, alt_graph, routes, s, t, full);
+        });
+    });
+    measure(options, results, "route/alt", q, [&]() {
+        return each_query([&](const string& s, const string& t) {
+            strategy::alt::astar(alt_graph, s, t);
+        });
+    });
+    measure(options, results, "route/bidirectional", q, [&]() {
+        return each_query([&](const string& s, const string& t) {
+            strategy::alt::bidirectional_dijkstra(alt_graph, s, t);
+        });
+    });
+    measure(options, results, "route/fake_dijkstra", q, [&]() {
+        return each_query([&](const string& s, const string& t) {
+            strategy::v2::fake_dijkstra(stations, routes, s, t, 0, cache.station_plans);
+        });
+    });
+    measure(options, results, "route/fake_dijkstra-alt", q, [&]() {
+        return each_query([&](const string& s, const string& t) {
+            strategy::v2::fake_dijkstra(stations, routes, s, t, 0, cache.station_plans, &alt_graph);
+        });
+    });
+    measure(options, results, "route/dijkstra_tree", q, [&]() {
+        return each_query([&](const string& s, const string& t) {
+            strategy::v3::dijkstra_tree(stations, routes, s, 0, cache.station_plans);
+        });
+    });
+    measure(options, results, "route/dense_tree", q, [&]() {
+        return each_query([&](const string& s, const string& t) {
+            strategy::v3::dense_tree(dense_graph, s, 0, cache.station_plans);
+        });
+    });
+    measure(options, results, "route/delta_tree", q, [&]() {
+        return each_query([&](const string& s, const string& t) {
+            strategy::v3::delta_tree(csr_graph, s, 0, cache.station_plans, nullptr);
+        });
+    });
+}
+
+// 全国规模的路网：side × side 的网格，相邻站点双向连通，另加随机的长途干线
+void micro_route_large(const Options& options, vector<Result>& results, int side) {
+    std::mt19937 rng(2025);
+    std::uniform_real_distribution<double> uni(0, 1);
+    map<string, Station> stations;
+    auto name = [&](int x, int y) {
+        return fmt::format("g{}_{}", x, y);
+    };
+    for (int x = 0; x < side; x++) {
+        for (int y = 0; y < side; y++) {
+            const string id = name(x, y);
+            stations[id] = Station { id, 1 + uni(rng), 0.1 + uni(rng) / 10, uni(rng) };
+        }
+    }
+    map<string, map<int, Route>> routes;
+    // 只有网格边的路网：随机干线使收缩几乎不可行，CH 只在这上面建
+    map<string, map<int, Route>> grid_routes;
+    int rid = 0;
+    auto add_route = [&](const string& src, const string& dst, double time, bool grid) {
+        rid += 1;
+        routes[src][rid] = Route { rid, src, dst, time, 1 + uni(rng) };
+        if (grid) {
+            grid_routes[src][rid] = routes[src][rid];
+        }
+    };
+    for (int x = 0; x < side; x++) {
+        for (int y = 0; y < side; y++) {
+            if (x + 1 < side) {
+                add_route(name(x, y), name(x + 1, y), 1 + uni(rng), true);
+                add_route(name(x + 1, y), name(x, y), 1 + uni(rng), true);
+            }
+            if (y + 1 < side) {
+                add_route(name(x, y), name(x, y + 1), 1 + uni(rng), true);
+                add_route(name(x, y + 1), name(x, y), 1 + uni(rng), true);
+            }
+            const string far = name(rng() % side, rng() % side);
+            add_route(name(x, y), far, 5 + 10 * uni(rng), false);
+        }
+    }
+    const strategy::v2::V2Cache cache(stations);
+    const strategy::delta::CsrGraph graph(stations, routes);
+    pool::WorkerPool workers(std::max(1, (int)std::thread::hardware_concurrency() - 1));
+    vector<string> sources;
+    for (int i = 0; i < 20; i++) {
+        sources.push_back(name(rng() % side, rng() % side));
+    }
+    vector<std::pair<string, string>> pairs;
+    for (int i = 0; i < 200; i++) {
+        pairs.emplace_back(name(rng() % side, rng() % side), name(rng() % side, rng() % side));
+    }
+    const long long q = sources.size();
+    auto each_source = [&](auto&& route) {
+        return time_ms([&]() {
+            for (const auto& src: sources) {
+                route(src);
+            }
+        });
+    };
+    const string suffix = fmt::format("-{}", stations.size());
+    measure(options, results, "route/dijkstra_tree" + suffix, q, [&]() {
+        return each_source([&](const string& s) {
+            strategy::v3::dijkstra_tree(stations, routes, s, 0, cache.station_plans);
+        });
+    });
+    measure(options, results, "route/delta_tree" + suffix, q, [&]() {
+        return each_source([&](const string& s) {
+            strategy::v3::delta_tree(graph, s, 0, cache.station_plans, nullptr);
+        });
+    });
+    const string parallel = fmt::format("route/delta_tree-x{}", workers.size()) + suffix;
+    measure(options, results, parallel, q, [&]() {
+        return each_source([&](const string& s) {
+            strategy::v3::delta_tree(graph, s, 0, cache.station_plans, &workers);
+        });
+    });
+    // 点对点查询：CH 的查询代价应只与 settle 的点数有关，不随站点数线性增长
+    const strategy::ch::ContractionHierarchy hierarchy(stations, grid_routes);
+    measure(options, results, "route/ch" + suffix, pairs.size(), [&]() {
+        return time_ms([&]() {
+            for (const auto& [s, t]: pairs) {
+                strategy::dijkstra(hierarchy, s, t);
+            }
+        });
+    });
+}
+
+void macro(const Options& options, vector<Result>& results, const Scenario& scenario) {
+    const std::pair<StrategyVersion, string> versions[] = {
+        { StrategyVersion::V1, "V1" },   { StrategyVersion::V1B, "V1B" },
+        { StrategyVersion::V2, "V2" },   { StrategyVersion::V2B, "V2B" },
+        { StrategyVersion::V3, "V3" },
+    };
+    for (int k: options.scales) {
+        const Scenario scaled = scale(scenario, k);
+        for (const auto& [version, vname]: versions) {
+            double cost = 0;
+            Result* result = measure(
+                options,
+                results,
+                fmt::format("sim/{}/x{}", vname, k),
+                scaled.orders.size(),
+                [&]() {
+                    sim::AnySimulation sim { version, EvaluateVersion::V1 };
+                    scaled.feed(sim.base());
+                    const double ms = time_ms([&]() { sim.run(); });
+                    cost = sim.eval();
+                    return ms;
+                }
+            );
+            if (result != nullptr) {
+                result->cost = cost;
+            }
+        }
+    }
+}
+
+void write_json(const Options& options, const vector<Result>& results) {
+    std::ofstream file(options.json, std::ios::trunc);
+    file << fmt::format(
+        "{{\"data\": \"{}\", \"repeat\": {}, \"warmup\": {}, \"results\": [",
+        options.data,
+        options.repeat,
+        options.warmup
+    );
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& r = results[i];
+        const Stats s = summarize(r.trials_ms);
+        file << fmt::format(
+            "{}\n  {{\"name\": \"{}\", \"items\": {}, \"mean_ms\": {}, \"stddev_ms\": {}, "
+            "\"median_ms\": {}, \"min_ms\": {}, \"ci95_ms\": [{}, {}], \"cost\": {}, "
+            "\"trials_ms\": [",
+            i == 0 ? "" : ",",
+            r.name,
+            r.items,
+            s.mean,
+            s.stddev,
+            s.median,
+            s.min,
+            s.ci_low,
+            s.ci_high,
+            r.cost
+        );
+        for (size_t j = 0; j < r.trials_ms.size(); j++) {
+            file << (j == 0 ? "" : ", ") << r.trials_ms[j];
+        }
+        file << "]}";
+    }
+    file << "\n]}\n";
+}
+
+Options parse(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const string key = argv[i];
+        const string value = argv[i + 1];
+        if (key == "--data") {
+            options.data = value;
+        } else if (key == "--scales") {
+            options.scales.clear();
+            std::stringstream ss(value);
+            string item;
+            while (std::getline(ss, item, ',')) {
+                options.scales.push_back(std::stoi(item));
+            }
+        } else if (key == "--repeat") {
+            options.repeat = std::max(1, std::stoi(value));
+        } else if (key == "--warmup") {
+            options.warmup = std::max(0, std::stoi(value));
+        } else if (key == "--filter") {
+            options.filter = value;
+        } else if (key == "--json") {
+            options.json = value;
+        } else {
+            log::ecargo("Error", "unknown option {}", key);
+        }
+    }
+    return options;
+}
+
+} // namespace bench
+
+int main(int argc, char** argv) {
+    const bench::Options options = bench::parse(argc, argv);
+    // 模拟过程中的日志不计入结果输出
+    std::freopen("/dev/null", "w", stdout);
+    const bench::Scenario scenario = bench::load(options.data);
+    if (scenario.stations.empty()) {
+        log::ecargo("Error", "no stations loaded from {}", options.data);
+        return 1;
+    }
+    std::vector<bench::Result> results;
+    bench::micro_event_queue(options, results);
+    bench::micro_select(options, results, scenario);
+    bench::micro_route(options, results, scenario);
+    bench::micro_route_large(options, results, 32);
+    bench::micro_route_large(options, results, 100);
+    bench::macro(options, results, scenario);
+    if (!options.json.empty()) {
+        bench::write_json(options, results);
+    }
+    return 0;
+}
@@ -0,0 +1,320 @@
+#include "capi.h"
+
+#include <exception>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "log.hpp"
+#include "scenario.hpp"
+#include "sim.hpp"
+
+using std::string;
+using std::vector;
+
+using eval::EvaluateVersion;
+using strategy::StrategyVersion;
+
+struct ds_scenario {
+    std::shared_ptr<const scenario::Scenario> scenario;
+};
+
+struct ds_run {
+    std::shared_ptr<const scenario::Scenario> scenario;
+    sim::AnySimulation sim;
+    bool collected = false;
+    // 按场景中订单的顺序，模拟结束后填写
+    vector<double> time_created;
+    vector<double> time_finished;
+    vector<uint8_t> finished;
+
+    ds_run(std::shared_ptr<const scenario::Scenario> scenario, StrategyVersion strategy):
+        scenario(std::move(scenario)),
+        sim(strategy, EvaluateVersion::V0) {}
+};
+
+namespace {
+
+thread_local string last_error;
+
+// C 接口不能抛出异常：失败时记下原因，返回 fallback
+template<typename T, typename F>
+T guarded(T fallback, F&& f) {
+    try {
+        return f();
+    } catch (const std::exception& e) {
+        last_error = e.what();
+    } catch (...) {
+        last_error = "unknown error";
+    }
+    return fallback;
+}
+
+template<typename T>
+T fail(T fallback, const string& error) {
+    last_error = error;
+    return fallback;
+}
+
+bool in_range(int32_t i, int32_t n) {
+    return 0 <= i && i < n;
+}
+
+// 模拟结束后按场景中的订单顺序整理包裹结果，只做一次
+void collect(ds_run* run) {
+    if (!run->sim.done() || run->collected) {
+        return;
+    }
+    run->collected = true;
+    const auto& packages = run->sim.base().packages;
+    for (const auto& order: run->scenario->orders) {
+        // 终点不可达而隔离的订单没有登记，视为未送达
+        auto it = packages.find(order.id);
+        if (it == packages.end()) {
+            run->time_created.push_back(order.time);
+            run->time_finished.push_back(0);
+            run->finished.push_back(0);
+            continue;
+        }
+        run->time_created.push_back(it->second.time_created);
+        run->time_finished.push_back(it->second.time_finished);
+        run->finished.push_back(it->second.finished);
+    }
+}
+
+} // namespace
+
+extern "C" {
+
+const char* ds_last_error(void) {
+    return last_error.c_str();
+}
+
+void ds_set_logging(int enabled) {
+    log::stdout_enabled = enabled != 0;
+}
+
+ds_scenario* ds_scenario_create(
+    int32_t station_cnt,
+    const char* const* station_ids,
+    const double* throughput,
+    const double* process_delay,
+    const double* station_cost,
+    int32_t route_cnt,
+    const int32_t* route_src,
+    const int32_t* route_dst,
+    const double* route_time,
+    const double* route_cost,
+    int32_t order_cnt,
+    const char* const* order_ids,
+    const double* order_time,
+    const int32_t* order_ctg,
+    const int32_t* order_src,
+    const int32_t* order_dst
+) {
+    return guarded<ds_scenario*>(nullptr, [&]() -> ds_scenario* {
+        vector<ingest::StationLine> stations;
+        for (int32_t i = 0; i < station_cnt; i++) {
+            stations.push_back({
+                station_ids[i],
+                throughput[i],
+                process_delay[i],
+                station_cost[i],
+            });
+        }
+        vector<ingest::RouteLine> routes;
+        for (int32_t i = 0; i < route_cnt; i++) {
+            if (!in_range(route_src[i], station_cnt) || !in_range(route_dst[i], station_cnt)) {
+                return fail<ds_scenario*>(nullptr, "route " + std::to_string(i) + ": bad station");
+            }
+            routes.push_back({
+                stations[route_src[i]].id,
+                stations[route_dst[i]].id,
+                route_time[i],
+                route_cost[i],
+            });
+        }
+        vector<ingest::Order> orders;
+        for (int32_t i = 0; i < order_cnt; i++) {
+            if (!in_range(order_src[i], station_cnt) || !in_range(order_dst[i], station_cnt)) {
+                return fail<ds_scenario*>(nullptr, "order " + std::to_string(i) + ": bad station");
+            }
+            if (order_ctg[i] != 0 && order_ctg[i] != 1) {
+                return fail<ds_scenario*>(nullptr, "order " + std::to_string(i) + ": bad category");
+            }
+            orders.push_back({
+                order_ids[i],
+                order_time[i],
+                order_ctg[i] == 0 ? base::PackageCategory::STANDARD
+                                  : base::PackageCategory::EXPRESS,
+                stations[order_src[i]].id,
+                stations[order_dst[i]].id,
+            });
+        }
+        auto shared =
+            scenario::Scenario::build(std::move(stations), std::move(routes), std::move(orders));
+        return new ds_scenario { std::move(shared) };
+    });
+}
+
+ds_scenario* ds_scenario_read(const char* path) {
+    return guarded<ds_scenario*>(nullptr, [&]() -> ds_scenario* {
+        if (!std::ifstream(path).is_open()) {
+            return fail<ds_scenario*>(nullptr, string("file not found: ") + path);
+        }
+        return new ds_scenario { scenario::Scenario::read(path) };
+    });
+}
+
+void ds_scenario_free(ds_scenario* scenario) {
+    delete scenario;
+}
+
+int32_t ds_scenario_station_cnt(const ds_scenario* scenario) {
+    return static_cast<int32_t>(scenario->scenario->station_lines.size());
+}
+
+int32_t ds_scenario_order_cnt(const ds_scenario* scenario) {
+    return static_cast<int32_t>(scenario->scenario->orders.size());
+}
+
+const char* ds_scenario_station_id(const ds_scenario* scenario, int32_t station) {
+    if (!in_range(station, ds_scenario_station_cnt(scenario))) {
+        return fail<const char*>(nullptr, "station out of range");
+    }
+    return scenario->scenario->station_lines[station].id.c_str();
+}
+
+const char* ds_scenario_order_id(const ds_scenario* scenario, int32_t order) {
+    if (!in_range(order, ds_scenario_order_cnt(scenario))) {
+        return fail<const char*>(nullptr, "order out of range");
+    }
+    return scenario->scenario->orders[order].id.c_str();
+}
+
+ds_run* ds_run_create(const ds_scenario* scenario, int32_t strategy) {
+    if (!in_range(strategy, DS_STRATEGY_V3 + 1)) {
+        return fail<ds_run*>(nullptr, "unknown strategy " + std::to_string(strategy));
+    }
+    return guarded<ds_run*>(nullptr, [&] {
+        auto run = std::make_unique<ds_run>(scenario->scenario, StrategyVersion(strategy));
+        vector<string> stations;
+        for (const auto& s: run->scenario->station_lines) {
+            stations.push_back(s.id);
+        }
+        vector<string> packages;
+        for (const auto& o: run->scenario->orders) {
+            packages.push_back(o.id);
+        }
+        run->sim.disable_csv();
+        run->sim.enable_columns(stations, packages);
+        run->sim.load(run->scenario);
+        return run.release();
+    });
+}
+
+void ds_run_free(ds_run* run) {
+    delete run;
+}
+
+int64_t ds_run_execute(ds_run* run) {
+    if (run->sim.done()) {
+        return fail<int64_t>(-1, "run already executed");
+    }
+    return guarded<int64_t>(-1, [&] {
+        run->sim.run();
+        collect(run);
+        return static_cast<int64_t>(run->sim.event_cnt());
+    });
+}
+
+int64_t ds_run_until(ds_run* run, double time) {
+    return guarded<int64_t>(-1, [&] {
+        const int64_t before = run->sim.event_cnt();
+        run->sim.run_until(time);
+        collect(run);
+        return run->sim.event_cnt() - before;
+    });
+}
+
+int64_t ds_run_step(ds_run* run, int64_t n) {
+    if (n < 0 || n > std::numeric_limits<int>::max()) {
+        return fail<int64_t>(-1, "bad event count " + std::to_string(n));
+    }
+    return guarded<int64_t>(-1, [&] {
+        const int processed = run->sim.step(static_cast<int>(n));
+        collect(run);
+        return static_cast<int64_t>(processed);
+    });
+}
+
+int ds_run_done(const ds_run* run) {
+    return run->sim.done() ? 1 : 0;
+}
+
+double ds_run_now(const ds_run* run) {
+    return run->sim.now();
+}
+
+int32_t ds_run_costs(const ds_run* run, const int32_t* evaluators, int32_t n, double* costs) {
+    if (!run->sim.done()) {
+        return fail<int32_t>(-1, "run not finished");
+    }
+    vector<EvaluateVersion> versions;
+    for (int32_t i = 0; i < n; i++) {
+        if (!in_range(evaluators[i], (int32_t)std::size(eval::EVALUATE_FUNC_MAP))) {
+            return fail<int32_t>(-1, "unknown evaluator " + std::to_string(evaluators[i]));
+        }
+        versions.push_back(EvaluateVersion(evaluators[i]));
+    }
+    return guarded<int32_t>(-1, [&] {
+        const vector<double> res = run->sim.eval_all(versions);
+        std::copy(res.begin(), res.end(), costs);
+        return n;
+    });
+}
+
+int64_t ds_run_occupancy(
+    const ds_run* run,
+    const double** time,
+    const int32_t** station,
+    const int32_t** size
+) {
+    const trace::Columns& cols = *run->sim.base().recorded_columns();
+    *time = cols.occ_time.data();
+    *station = cols.occ_station.data();
+    *size = cols.occ_size.data();
+    return static_cast<int64_t>(cols.occ_time.size());
+}
+
+int64_t ds_run_trips(
+    const ds_run* run,
+    const double** time,
+    const int32_t** package,
+    const int32_t** src,
+    const int32_t** dst
+) {
+    const trace::Columns& cols = *run->sim.base().recorded_columns();
+    *time = cols.trip_time.data();
+    *package = cols.trip_package.data();
+    *src = cols.trip_src.data();
+    *dst = cols.trip_dst.data();
+    return static_cast<int64_t>(cols.trip_time.size());
+}
+
+int64_t ds_run_packages(
+    const ds_run* run,
+    const double** time_created,
+    const double** time_finished,
+    const uint8_t** finished
+) {
+    *time_created = run->time_created.data();
+    *time_finished = run->time_finished.data();
+    *finished = run->finished.data();
+    return static_cast<int64_t>(run->finished.size());
+}
+
+} // extern "C"
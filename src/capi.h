@@ -0,0 +1,116 @@
+#ifndef CAPI_H
+#define CAPI_H
+
+/* 进程内调用模拟器的 C 接口，动态库 libdssim 导出，Python 绑定见 UI/dssim.py
+ * 场景可以由内存中的数组建立，结果按列交给调用方：指针指向模拟器持有的内存，
+ * 在对应的 ds_run 释放或再次推进前一直有效，调用方不必复制
+ * 失败时返回 NULL 或负数，原因由 ds_last_error 给出 */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* 与 strategy::StrategyVersion 一致 */
+enum {
+    DS_STRATEGY_V1 = 0,
+    DS_STRATEGY_V1B = 1,
+    DS_STRATEGY_V2 = 2,
+    DS_STRATEGY_V2B = 3,
+    DS_STRATEGY_V3 = 4,
+};
+
+/* 与 eval::EvaluateVersion 一致 */
+enum {
+    DS_EVAL_V0 = 0,
+    DS_EVAL_V1 = 1,
+};
+
+typedef struct ds_scenario ds_scenario;
+typedef struct ds_run ds_run;
+
+/* 当前线程最近一次失败的原因 */
+const char* ds_last_error(void);
+
+/* 关闭后不再向 stdout 输出逐事件日志，进程内所有模拟共用这一开关 */
+void ds_set_logging(int enabled);
+
+/* 站点 i：station_ids[i], (throughput, process_delay, cost)
+ * 路线 i：station 下标 route_src[i] -> route_dst[i]，编号为 i + 1
+ * 订单 i：order_ids[i]，创建时间、类别（0 STANDARD / 1 EXPRESS）、起点与终点的 station 下标
+ * 下标越界或类别不是 0 / 1 时失败 */
+ds_scenario* ds_scenario_create(
+    int32_t station_cnt,
+    const char* const* station_ids,
+    const double* throughput,
+    const double* process_delay,
+    const double* station_cost,
+    int32_t route_cnt,
+    const int32_t* route_src,
+    const int32_t* route_dst,
+    const double* route_time,
+    const double* route_cost,
+    int32_t order_cnt,
+    const char* const* order_ids,
+    const double* order_time,
+    const int32_t* order_ctg,
+    const int32_t* order_src,
+    const int32_t* order_dst
+);
+/* 解析 data.txt 格式的文件 */
+ds_scenario* ds_scenario_read(const char* path);
+void ds_scenario_free(ds_scenario* scenario);
+
+int32_t ds_scenario_station_cnt(const ds_scenario* scenario);
+int32_t ds_scenario_order_cnt(const ds_scenario* scenario);
+const char* ds_scenario_station_id(const ds_scenario* scenario, int32_t station);
+const char* ds_scenario_order_id(const ds_scenario* scenario, int32_t order);
+
+/* 一次模拟，与其他 ds_run 共享 scenario；不写 CSV，结果记在内存中 */
+ds_run* ds_run_create(const ds_scenario* scenario, int32_t strategy);
+void ds_run_free(ds_run* run);
+
+/* 运行到结束，返回整次模拟处理的事件数；之前推进过时从停下的地方继续 */
+int64_t ds_run_execute(ds_run* run);
+/* 处理所有不晚于 time 的事件，返回这次处理的事件数 */
+int64_t ds_run_until(ds_run* run, double time);
+/* 最多处理 n 个事件，返回这次处理的事件数 */
+int64_t ds_run_step(ds_run* run, int64_t n);
+/* 事件是否已全部处理；处理完后 ds_run_packages 才有结果 */
+int ds_run_done(const ds_run* run);
+/* 最近处理的事件的模拟时间 */
+double ds_run_now(const ds_run* run);
+
+/* evaluators 中每个评估方式下的总代价写入 costs，只模拟一次；事件还没处理完时失败 */
+int32_t ds_run_costs(const ds_run* run, const int32_t* evaluators, int32_t n, double* costs);
+
+/* 对应 number_package_in_station.csv：返回行数 */
+int64_t ds_run_occupancy(
+    const ds_run* run,
+    const double** time,
+    const int32_t** station,
+    const int32_t** size
+);
+/* 对应 package_trip.csv：返回行数，package 为订单下标，src == dst 表示到达或在终点处理 */
+int64_t ds_run_trips(
+    const ds_run* run,
+    const double** time,
+    const int32_t** package,
+    const int32_t** src,
+    const int32_t** dst
+);
+/* 每个订单一行，顺序与场景相同：返回订单数；未送达的包裹 finished 为 0 */
+int64_t ds_run_packages(
+    const ds_run* run,
+    const double** time_created,
+    const double** time_finished,
+    const uint8_t** finished
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,9 +1,11 @@
 #ifndef EVAL_HPP
 #define EVAL_HPP
 
+#include <cstdint>
 #include <cwchar>
 #include <map>
 #include <string>
+#include <vector>
 
 #include "base.hpp"
 #include "fmt/core.h"
@@ -14,6 +16,7 @@ using log::logs;
 using log::logs_cargo;
 using std::map;
 using std::string;
+using std::vector;
 using namespace base;
 
 enum struct EvaluateVersion {
@@ -22,22 +25,58 @@ enum struct EvaluateVersion {
     V2,
 };
 
+// 未送达包裹的惩罚
+const double UNFINISHED_PUNISHMENT = 1e6;
+
+// packages 按 id 顺序整理成的列，一次模拟在多个评估函数下求值时只整理一次
+struct PackageColumns {
+    vector<double> time_spent; // 未送达时为 0
+    vector<uint8_t> express;
+    vector<uint8_t> finished;
+
+    explicit PackageColumns(const Packages& pkgs) {
+        this->time_spent.reserve(pkgs.size());
+        this->express.reserve(pkgs.size());
+        this->finished.reserve(pkgs.size());
+        for (const auto& [id, pkg]: pkgs) {
+            this->time_spent.push_back(pkg.finished ? pkg.time_finished - pkg.time_created : 0);
+            this->express.push_back(pkg.category == PackageCategory::EXPRESS);
+            this->finished.push_back(pkg.finished);
+        }
+    }
+};
+
+// 与 operator() 相同的求和顺序，结果逐位一致
+template<typename Cost>
+double sum_columns(double transport_cost, const PackageColumns& cols, Cost cost) {
+    double tot_cost = transport_cost;
+    for (size_t i = 0; i < cols.time_spent.size(); i++) {
+        tot_cost +=
+            cols.finished[i] ? cost(cols.time_spent[i], cols.express[i]) : UNFINISHED_PUNISHMENT;
+    }
+    return tot_cost;
+}
+
 struct EvalFunc {
-    virtual double operator()(double transport_cost, const map<string, Package>& pkg) = 0;
+    virtual double operator()(double transport_cost, const Packages& pkg) = 0;
+    // 单个已送达包裹的代价，包裹退役时累加，不必保留整个 packages
+    virtual double package_cost(const Package& pkg) const = 0;
+    // 同 operator()，但不逐个打印包裹，输入为整理好的列
+    virtual double columns_cost(double transport_cost, const PackageColumns& cols) const = 0;
 };
 
 struct EvalFuncV0: public EvalFunc {
-    double operator()(double transport_cost, const map<string, Package>& pkgs) override {
+    double operator()(double transport_cost, const Packages& pkgs) override {
         double tot_cost = transport_cost;
         logs_cargo("Evaluate", "system transport cost: {}", transport_cost);
         for (const auto& [id, pkg]: pkgs) {
             if (!pkgs.at(id).finished) {
-                tot_cost += 1e6;
+                tot_cost += UNFINISHED_PUNISHMENT;
                 logs_cargo("Evaluate", "package {} not finished", id);
                 continue;
             }
             double time_spent = pkgs.at(id).time_finished - pkg.time_created;
-            double cost = time_spent * (pkg.category == PackageCategory::EXPRESS ? 3 : 1);
+            double cost = this->package_cost(pkg);
             logs_cargo(
                 "Evaluate",
                 "package {} type {} finished at {:.2f}, spent {:.2f} cost {:.2f}",
@@ -51,10 +90,26 @@ struct EvalFuncV0: public EvalFunc {
         }
         return tot_cost;
     }
+
+    double package_cost(const Package& pkg) const override {
+        return cost(pkg.time_finished - pkg.time_created, pkg.category == PackageCategory::EXPRESS);
+    }
+
+    double columns_cost(double transport_cost, const PackageColumns& cols) const override {
+        return sum_columns(transport_cost, cols, cost);
+    }
+
+    static double cost(double time_spent, bool express) {
+        return time_spent * (express ? 3 : 1);
+    }
 };
 
 struct EvalFuncV1: public EvalFunc {
-    double operator()(double transport_cost, const map<string, Package>& pkgs) override;
+    double operator()(double transport_cost, const Packages& pkgs) override;
+    double package_cost(const Package& pkg) const override;
+    double columns_cost(double transport_cost, const PackageColumns& cols) const override;
+
+    static double cost(double time_spent, bool express);
 };
 
 const std::pair<EvaluateVersion, EvalFunc*> EVALUATE_FUNC_MAP[] = {
@@ -70,27 +125,38 @@ const double OVER_DDL_PUNISHMENT = 50;
 const double OVER_DDL_PUNISHMENT_PER_HOUR = 3;
 const double NON_DDL_COST_PER_HOUR = 3;
 
-inline double EvalFuncV1::operator()(double transport_cost, const map<string, Package>& pkgs) {
+inline double EvalFuncV1::operator()(double transport_cost, const Packages& pkgs) {
     double tot_cost = transport_cost;
     logs_cargo("Evaluate", "system transport cost: {}", transport_cost);
     for (const auto& [id, pkg]: pkgs) {
         if (!pkgs.at(id).finished) {
-            tot_cost += 1e6;
+            tot_cost += UNFINISHED_PUNISHMENT;
             logs_cargo("Evaluate", "package {} not finished", id);
             continue;
         }
-        // 运输成本
-        // EXPRESS 包裹运输时间 * 1，若超过 24h，立即增加 50，每小时增加 3
-        // STANDARD 包裹运输时间 * 1，若超过 72h，立即增加 50，每小时增加 3
-        const double time_spent = pkgs.at(id).time_finished - pkg.time_created;
-        const double ddl =
-            pkg.category == PackageCategory::EXPRESS ? V1_EXPRESS_DDL_HOURS : V1_STANDARD_DDL_HOURS;
-        const double cost = time_spent > ddl ? OVER_DDL_PUNISHMENT
-                + (time_spent - ddl) * OVER_DDL_PUNISHMENT_PER_HOUR + ddl * NON_DDL_COST_PER_HOUR
-                                             : time_spent * NON_DDL_COST_PER_HOUR;
-        tot_cost += cost;
+        tot_cost += this->package_cost(pkg);
     }
     return tot_cost;
 }
+
+inline double EvalFuncV1::package_cost(const Package& pkg) const {
+    return cost(pkg.time_finished - pkg.time_created, pkg.category == PackageCategory::EXPRESS);
+}
+
+inline double EvalFuncV1::columns_cost(double transport_cost, const PackageColumns& cols) const {
+    return sum_columns(transport_cost, cols, cost);
+}
+
+inline double EvalFuncV1::cost(double time_spent, bool express) {
+    // 运输成本
+    // EXPRESS 包裹运输时间 * 1，若超过 24h，立即增加 50，每小时增加 3
+    // STANDARD 包裹运输时间 * 1，若超过 72h，立即增加 50，每小时增加 3
+    const double ddl = express ? V1_EXPRESS_DDL_HOURS : V1_STANDARD_DDL_HOURS;
+    if (time_spent > ddl) {
+        return OVER_DDL_PUNISHMENT + (time_spent - ddl) * OVER_DDL_PUNISHMENT_PER_HOUR
+            + ddl * NON_DDL_COST_PER_HOUR;
+    }
+    return time_spent * NON_DDL_COST_PER_HOUR;
+}
 } // namespace eval
 #endif
@@ -1,26 +1,54 @@
 #ifndef EVENT_HPP
 #define EVENT_HPP
 
-namespace sim {
-struct Simulation;
-}
+#include <cmath>
+#include <cstdint>
 
 namespace event {
-using sim::Simulation;
+// 定点时间：1 tick = 1e-9 小时，与 rust::EPS 一致；相差不到 1 tick 的事件视为同一时刻
+constexpr double TICKS_PER_HOUR = 1e9;
+
+inline int64_t to_tick(double time) {
+    return std::llround(time * TICKS_PER_HOUR);
+}
+
 struct Event {
 public:
     const double time;
+    // 由 SimulationBase::schedule_event 填写：定点时间与入队序号
+    int64_t tick = 0;
+    uint64_t seq = 0;
 
-    Event(double t, Simulation& sim): time(t), sim(sim) {}
+    explicit Event(double t): time(t) {}
     virtual void process_event() = 0;
+    // 推测执行：同一 tick 的一批事件处理前，对 speculative() 为真的事件在多个线程中并发调用
+    // 只能读模拟状态，预先算好 process_event 要用的结果；process_event 须先验证再使用
+    virtual bool speculative() const {
+        return false;
+    }
+    virtual void speculate() {}
     virtual ~Event() = default;
+};
+
+// 持有具体 Simulation<Policy> 的事件，事件处理时不需要再按策略分支
+template<typename Sim>
+struct SimEvent: public Event {
+public:
+    SimEvent(double t, Sim& sim): Event(t), sim(sim) {}
 
 protected:
-    Simulation& sim;
+    Sim& sim;
 };
 
+// 默认只比较 time，同一时刻的事件按堆内部顺序出队
+// by_tick 时按 (tick, seq) 比较：同一时刻先入队者先出队，结果与平台和队列实现无关
 struct EventComparator {
-    bool operator()(Event* e1, Event* e2) {
+    bool by_tick = false;
+
+    bool operator()(Event* e1, Event* e2) const {
+        if (this->by_tick) {
+            return e1->tick != e2->tick ? e1->tick > e2->tick : e1->seq > e2->seq;
+        }
         return e1->time > e2->time;
     }
 };
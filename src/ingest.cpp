@@ -0,0 +1,143 @@
+#include "ingest.hpp"
+
+#include <iostream>
+#include <sstream>
+
+namespace ingest {
+
+optional<Order> parse_order(const string& line) {
+    std::stringstream ss(line);
+    Order order;
+    int ctg;
+    char c;
+
+    ss >> order.id >> c >> order.time >> c >> ctg >> c >> order.src >> c >> order.dst;
+    if (ss.fail()) {
+        return std::nullopt;
+    }
+    order.ctg = ctg == 0 ? PackageCategory::STANDARD : PackageCategory::EXPRESS;
+    return order;
+}
+
+StationLine parse_station(const string& line) {
+    std::stringstream ss(line);
+    StationLine station;
+    char p_l; // parenthesis left
+    char c; // comma
+    char p_r; // parenthesis right
+
+    ss >> station.id >> c >> p_l >> station.throughput >> c >> station.process_delay >> c
+        >> station.cost >> p_r;
+    return station;
+}
+
+RouteLine parse_route(const string& line) {
+    std::stringstream ss(line);
+    RouteLine route;
+    char c;
+
+    ss >> route.src >> c >> route.dst >> c >> route.time >> c >> route.cost;
+    return route;
+}
+
+bool read_sections(
+    const string& path,
+    const std::function<void(StationLine&&)>& on_station,
+    const std::function<void(RouteLine&&)>& on_route,
+    const std::function<bool(std::ifstream&)>& on_packets,
+    const std::function<void(Order&&)>& on_order
+) {
+    std::ifstream file(path, std::ios::in);
+    if (!file.is_open()) {
+        std::cout << "File not found" << std::endl;
+        return false;
+    }
+    string line;
+    bool is_stations_section = false;
+    bool is_routes_section = false;
+    bool is_orders_section = false;
+    while (std::getline(file, line)) {
+        if (line == "stations:") {
+            is_stations_section = true;
+            is_routes_section = false;
+            is_orders_section = false;
+        } else if (line == "edges:") {
+            is_stations_section = false;
+            is_routes_section = true;
+            is_orders_section = false;
+        } else if (line == "packets:") {
+            is_stations_section = false;
+            is_routes_section = false;
+            is_orders_section = true;
+            if (!on_packets(file)) {
+                return true;
+            }
+        } else if (is_stations_section) {
+            on_station(parse_station(line));
+        } else if (is_routes_section) {
+            on_route(parse_route(line));
+        } else if (is_orders_section) {
+            if (auto order = parse_order(line)) {
+                on_order(std::move(*order));
+            }
+        }
+    }
+    return true;
+}
+
+OrderStream::OrderStream(std::ifstream file): loader(&OrderStream::load, this, std::move(file)) {}
+
+OrderStream::~OrderStream() {
+    this->stopping.store(true, std::memory_order_relaxed);
+    this->loader.join();
+}
+
+void OrderStream::load(std::ifstream file) {
+    string line;
+    while (!this->stopping.load(std::memory_order_relaxed) && std::getline(file, line)) {
+        optional<Order> order = parse_order(line);
+        if (!order.has_value()) {
+            continue;
+        }
+        while (!this->ring.try_push(std::move(*order))) {
+            if (this->stopping.load(std::memory_order_relaxed)) {
+                return;
+            }
+            std::this_thread::yield();
+        }
+    }
+    this->finished.store(true, std::memory_order_release);
+}
+
+const Order* OrderStream::peek() {
+    if (this->front.has_value()) {
+        return &*this->front;
+    }
+    Order order;
+    bool waited = false;
+    while (!this->ring.try_pop(order)) {
+        if (this->finished.load(std::memory_order_acquire)) {
+            // finished 在最后一次 push 之后才置位，置位后再取一次即可判断是否读完
+            if (!this->ring.try_pop(order)) {
+                return nullptr;
+            }
+            break;
+        }
+        waited = true;
+        std::this_thread::yield();
+    }
+    this->stalls += waited;
+    if (this->consumed > 0 && order.time < this->last_time) {
+        this->out_of_order += 1;
+    }
+    this->last_time = order.time;
+    this->front = std::move(order);
+    return &*this->front;
+}
+
+void OrderStream::pop() {
+    this->front.reset();
+    this->consumed += 1;
+}
+
+} // namespace ingest
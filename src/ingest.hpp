@@ -0,0 +1,128 @@
+#ifndef INGEST_HPP
+#define INGEST_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <optional>
+#include <string>
+#include <thread>
+
+#include "base.hpp"
+
+namespace ingest {
+using base::PackageCategory;
+using std::optional;
+using std::string;
+
+// 流水线读入：另一个线程解析 packets 段，经无锁环形队列交给模拟线程
+// 模拟线程在模拟时间走到订单的创建时间时才登记它，只有追上解析线程时才等待
+// 要求 packets 段按创建时间排序，否则晚读到的早订单会被推迟处理（run 结束时报告）
+
+struct Order {
+    string id;
+    double time;
+    PackageCategory ctg;
+    string src;
+    string dst;
+};
+
+// packets 段的一行：id , time , ctg , src , dst
+optional<Order> parse_order(const string& line);
+
+// stations 段的一行：id , ( throughput , process_delay , cost )
+struct StationLine {
+    string id;
+    double throughput;
+    double process_delay;
+    double cost;
+};
+StationLine parse_station(const string& line);
+
+// edges 段的一行：src , dst , time , cost
+struct RouteLine {
+    string src;
+    string dst;
+    double time;
+    double cost;
+};
+RouteLine parse_route(const string& line);
+
+// 逐行读数据文件的 stations / edges / packets 三段，每行交给对应的回调
+// 读到 "packets:" 时先调用 on_packets；它返回 false 时立即停止，文件停在 packets 段开头，
+// 可以被移走（流水线读入交给 OrderStream）
+// 文件打不开时输出 File not found 并返回 false
+bool read_sections(
+    const string& path,
+    const std::function<void(StationLine&&)>& on_station,
+    const std::function<void(RouteLine&&)>& on_route,
+    const std::function<bool(std::ifstream&)>& on_packets,
+    const std::function<void(Order&&)>& on_order
+);
+
+// 单生产者单消费者环形队列，head 只由消费者写，tail 只由生产者写
+template<typename T, size_t CAPACITY>
+struct SpscRing {
+public:
+    bool try_push(T&& value) {
+        const size_t tail = this->tail.load(std::memory_order_relaxed);
+        if (tail - this->head.load(std::memory_order_acquire) == CAPACITY) {
+            return false;
+        }
+        this->slots[tail % CAPACITY] = std::move(value);
+        this->tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_pop(T& value) {
+        const size_t head = this->head.load(std::memory_order_relaxed);
+        if (head == this->tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        value = std::move(this->slots[head % CAPACITY]);
+        this->head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::array<T, CAPACITY> slots;
+    alignas(64) std::atomic<size_t> head { 0 };
+    alignas(64) std::atomic<size_t> tail { 0 };
+};
+
+// 从 file 当前位置起解析订单，直到文件尾
+struct OrderStream {
+public:
+    explicit OrderStream(std::ifstream file);
+    ~OrderStream();
+    OrderStream(const OrderStream&) = delete;
+    OrderStream& operator=(const OrderStream&) = delete;
+
+    // 下一个订单，必要时等待解析线程；全部读完后返回 nullptr
+    const Order* peek();
+    void pop();
+
+    // 已交给模拟线程的订单数
+    int64_t consumed = 0;
+    // 模拟线程因队列为空而等待的次数
+    int64_t stalls = 0;
+    // 创建时间早于前一个订单的订单数
+    int64_t out_of_order = 0;
+
+private:
+    static constexpr size_t CAPACITY = 4096;
+
+    SpscRing<Order, CAPACITY> ring;
+    std::atomic<bool> finished { false };
+    std::atomic<bool> stopping { false };
+    optional<Order> front;
+    double last_time = 0;
+    std::thread loader;
+
+    void load(std::ifstream file);
+};
+
+} // namespace ingest
+#endif
@@ -0,0 +1,90 @@
+#include "journal.hpp"
+
+namespace journal {
+
+template<typename T>
+void put(std::ofstream& file, const T& value) {
+    file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<typename T>
+bool get(std::ifstream& file, T& value) {
+    return bool(file.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+Writer::Writer(const string& path): file(path, std::ios::binary | std::ios::trunc) {}
+
+uint32_t Writer::intern(const string& name) {
+    auto it = this->ids.find(name);
+    if (it != this->ids.end()) {
+        return it->second;
+    }
+    const uint32_t id = this->ids.size();
+    this->ids.emplace(name, id);
+    put(this->file, 'N');
+    put(this->file, uint32_t(name.size()));
+    this->file.write(name.data(), name.size());
+    return id;
+}
+
+void Writer::decision(
+    double time,
+    double start,
+    const string& station,
+    const string& package,
+    int route
+) {
+    const uint32_t station_id = this->intern(station);
+    const uint32_t package_id = this->intern(package);
+    put(this->file, 'D');
+    put(this->file, time);
+    put(this->file, start);
+    put(this->file, station_id);
+    put(this->file, package_id);
+    put(this->file, int32_t(route));
+    this->decisions += 1;
+}
+
+void Writer::finish(double transport_cost) {
+    put(this->file, 'E');
+    put(this->file, transport_cost);
+    this->file.flush();
+}
+
+Reader::Reader(const string& path): file(path, std::ios::binary) {}
+
+optional<Decision> Reader::next() {
+    char tag;
+    while (get(this->file, tag)) {
+        if (tag == 'N') {
+            uint32_t len;
+            get(this->file, len);
+            string name(len, '\0');
+            this->file.read(name.data(), len);
+            this->names.push_back(std::move(name));
+        } else if (tag == 'D') {
+            Decision d;
+            uint32_t station_id, package_id;
+            int32_t route;
+            get(this->file, d.time);
+            get(this->file, d.start);
+            get(this->file, station_id);
+            get(this->file, package_id);
+            get(this->file, route);
+            d.station = this->names.at(station_id);
+            d.package = this->names.at(package_id);
+            d.route = route;
+            return d;
+        } else if (tag == 'E') {
+            double transport_cost;
+            get(this->file, transport_cost);
+            this->final_transport_cost = transport_cost;
+            return std::nullopt;
+        } else {
+            break;
+        }
+    }
+    return std::nullopt;
+}
+
+} // namespace journal
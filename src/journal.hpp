@@ -0,0 +1,76 @@
+#ifndef JOURNAL_HPP
+#define JOURNAL_HPP
+
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace journal {
+using std::optional;
+using std::string;
+using std::vector;
+
+// 决策日志：二进制、本机字节序，按事件处理顺序写入
+// 'N' u32 len, bytes: 登记一个名字，编号从 0 依次递增（站点与包裹共用）
+// 'D' f64 time, f64 start, u32 station, u32 package, i32 route: 一次决策，route -1 表示在终点处理
+// 'E' f64 transport_cost: 模拟结束
+
+// time 为做出决策（包裹离开 buffer）的事件时间，start 为开始处理的时间（批处理时晚于 time）
+struct Decision {
+    double time;
+    double start;
+    string station;
+    string package;
+    int route;
+};
+
+struct Writer {
+public:
+    explicit Writer(const string& path);
+
+    void decision(
+        double time,
+        double start,
+        const string& station,
+        const string& package,
+        int route
+    );
+    void finish(double transport_cost);
+
+    int64_t decision_cnt() const {
+        return this->decisions;
+    }
+
+private:
+    std::ofstream file;
+    std::unordered_map<string, uint32_t> ids;
+    int64_t decisions = 0;
+
+    uint32_t intern(const string& name);
+};
+
+struct Reader {
+public:
+    explicit Reader(const string& path);
+
+    bool is_open() const {
+        return this->file.is_open();
+    }
+    // 下一条决策；读到结束标记或文件尾时返回 nullopt
+    optional<Decision> next();
+    // 读到结束标记后才有值
+    optional<double> transport_cost() const {
+        return this->final_transport_cost;
+    }
+
+private:
+    std::ifstream file;
+    vector<string> names;
+    optional<double> final_transport_cost;
+};
+
+} // namespace journal
+#endif
@@ -12,8 +12,14 @@ using fmt::println;
 using std::string;
 using std::filesystem::path;
 
+// 为 false 时 logs / logs_info / logs_cargo 不输出；作为库调用时关掉逐事件的 stdout 日志
+inline bool stdout_enabled = true;
+
 template<typename... T>
 void logs(const std::string_view& str, T&&... args) {
+    if (!stdout_enabled) {
+        return;
+    }
     // std::filesystem::path file_path("log.txt");
     // auto* file = fopen(file_path.string().c_str(), "w");
     auto* file = stdout;
@@ -24,6 +30,9 @@ void logs(const std::string_view& str, T&&... args) {
 
 template<typename... T>
 void logs_info(const std::string_view& str, T&&... args) {
+    if (!stdout_enabled) {
+        return;
+    }
     // std::filesystem::path file_path("log.txt");
     // auto* file = fopen(file_path.string().c_str(), "w");
     auto* file = stdout;
@@ -36,6 +45,9 @@ void logs_info(const std::string_view& str, T&&... args) {
 
 template<typename... T>
 void logs_cargo(const std::string_view& cargo, const std::string_view& msg, T&&... args) {
+    if (!stdout_enabled) {
+        return;
+    }
     // std::filesystem::path file_path("log.txt");
     // auto* file = fopen(file_path.string().c_str(), "w");
     auto* file = stdout;
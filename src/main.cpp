@@ -1,17 +1,24 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include "doctest/doctest.h"
 
+#include <algorithm>
 #include <cassert>
 #include <chrono>
+#include <fstream>
 #include <iostream>
 #include <map>
 #include <queue>
 #include <set>
+#include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include "arena.hpp"
 #include "base.hpp"
+#include "capi.h"
 #include "eval.hpp"
+#include "event.hpp"
 #include "fmt/core.h"
 #include "log.hpp"
 #include "rust.hpp"
@@ -46,10 +53,10 @@ using strategy::dijkstra;
 using strategy::dijkstra_enhanced;
 using strategy::StrategyVersion;
 
-using sim::Simulation;
+using sim::AnySimulation;
 
 TEST_CASE("simple") {
-    Simulation sim { StrategyVersion::V1, EvaluateVersion::V0 };
+    AnySimulation sim { StrategyVersion::V1, EvaluateVersion::V0 };
     sim.add_station("A", 5, 2, 100);
     sim.add_station("B", 20, 2, 100);
     sim.add_route("A", "B", 100, 50);
@@ -63,7 +70,7 @@ TEST_CASE("simple") {
 }
 
 TEST_CASE("simple-v1b") {
-    Simulation sim { StrategyVersion::V1B, EvaluateVersion::V0 };
+    AnySimulation sim { StrategyVersion::V1B, EvaluateVersion::V0 };
     sim.add_station("A", 5, 2, 100);
     sim.add_station("B", 20, 2, 100);
     sim.add_route("A", "B", 100, 50);
@@ -76,6 +83,108 @@ TEST_CASE("simple-v1b") {
     logs("cost: {}", sim.eval());
 }
 
+TEST_CASE("topology") {
+    // A <-> B -> C，D -> A；D 从其他站点不可达，C 到不了任何站点
+    for (int version = 0; version <= (int)StrategyVersion::V3; version++) {
+        AnySimulation sim { StrategyVersion(version), EvaluateVersion::V1 };
+        sim.add_station("A", 5, 2, 100);
+        sim.add_station("B", 20, 2, 100);
+        sim.add_station("C", 20, 2, 100);
+        sim.add_station("D", 20, 2, 100);
+        sim.add_route("A", "B", 100, 50); // 被 2 支配
+        sim.add_route("A", "B", 50, 10);
+        sim.add_route("A", "B", 30, 66);
+        sim.add_route("A", "B", 200, 10); // 被 2 支配
+        sim.add_route("A", "B", 30, 66); // 与 3 相同
+        sim.add_route("B", "A", 10, 10);
+        sim.add_route("B", "C", 10, 10);
+        sim.add_route("D", "A", 10, 10);
+        sim.verify_graph();
+        const topology::Topology& graph = *sim.base().graph_topology();
+        CHECK((graph.dominated == vector<int> { 1, 4, 5 }));
+        CHECK(sim.base().routes().at("A").size() == 2);
+        CHECK(graph.component_cnt == 3);
+        CHECK(graph.largest_component == 2);
+        CHECK(graph.reachable("D", "C"));
+        CHECK(!graph.reachable("C", "A"));
+
+        sim.add_order("p1", 1, PackageCategory::STANDARD, "A", "C");
+        sim.add_order("p2", 1, PackageCategory::EXPRESS, "C", "A");
+        sim.add_order("p3", 2, PackageCategory::STANDARD, "A", "D");
+        sim.add_order("p4", 2, PackageCategory::EXPRESS, "D", "C");
+        sim.run();
+        CHECK(sim.base().quarantined.size() == 2);
+        CHECK(sim.base().packages.size() == 2);
+        CHECK(sim.base().packages.at("p1").finished);
+        CHECK(sim.base().packages.at("p4").finished);
+    }
+
+    // 长链：递归的 tarjan 会耗尽调用栈；回边把 s1 之后连成一个分量
+    const int n = 200000;
+    map<string, Station> stations;
+    map<string, map<int, Route>> routes;
+    for (int i = 0; i < n; i++) {
+        const string id = fmt::format("s{:06}", i);
+        stations[id] = Station { id, 1, 1, 1 };
+        if (i + 1 < n) {
+            routes[id][i] = Route { i, id, fmt::format("s{:06}", i + 1), 1, 1 };
+        }
+    }
+    routes["s199999"][n] = Route { n, "s199999", "s000001", 1, 1 };
+    const topology::Topology chain(stations, routes);
+    CHECK(chain.component_cnt == 2);
+    CHECK(chain.largest_component == n - 1);
+    CHECK(chain.reachable("s000000", "s199999"));
+    CHECK(chain.reachable("s150000", "s100000"));
+    CHECK(!chain.reachable("s000001", "s000000"));
+
+    // 没有回边时每个站点是一个分量，可达集合跨过多个字
+    const int m = 500;
+    stations.clear();
+    routes.clear();
+    for (int i = 0; i < m; i++) {
+        const string id = fmt::format("s{:06}", i);
+        stations[id] = Station { id, 1, 1, 1 };
+        if (i + 1 < m) {
+            routes[id][i] = Route { i, id, fmt::format("s{:06}", i + 1), 1, 1 };
+        }
+    }
+    const topology::Topology dag(stations, routes);
+    CHECK(dag.component_cnt == m);
+    bool same = true;
+    for (int i = 0; i < m; i += 7) {
+        for (int j = 0; j < m; j += 5) {
+            same &= dag.reachable(fmt::format("s{:06}", i), fmt::format("s{:06}", j)) == (i <= j);
+        }
+    }
+    CHECK(same);
+}
+
+TEST_CASE("arena") {
+    // 最外层 Scope 结束后 scratch 从头复用，内层结束不归还
+    void* first = nullptr;
+    {
+        arena::Scope outer;
+        first = arena::scratch()->allocate(64);
+        {
+            arena::Scope inner;
+            CHECK(arena::scratch()->allocate(64) != first);
+        }
+        CHECK(arena::scratch()->allocate(64) != first);
+    }
+    {
+        arena::Scope again;
+        CHECK(arena::scratch()->allocate(64) == first);
+    }
+
+    // 站点 buffer 与包裹的节点从本次模拟的 arena 分配
+    AnySimulation sim { StrategyVersion::V3, EvaluateVersion::V0 };
+    sim.add_station("A", 5, 2, 100);
+    std::pmr::memory_resource* resource = sim.base().resource();
+    CHECK(sim.base().packages.get_allocator().resource() == resource);
+    CHECK(sim.base().stations.at("A").buffer.get_allocator().resource() == resource);
+}
+
 TEST_CASE("smart-pk") {
     // for (int i = 1; i <= 5; i++) {
     //     Simulation sim { [&i]() {
@@ -95,49 +204,43 @@ TEST_CASE("smart-pk") {
     // }
     const string snames[] = { "V1", "V1B", "V2", "V2B", "V3" };
     const string enames[] = { "V0", "V1" };
+    const StrategyVersion versions[] = {
+        StrategyVersion::V1, StrategyVersion::V1B, StrategyVersion::V2,
+        StrategyVersion::V2B, StrategyVersion::V3,
+    };
+    // 模拟与评估函数无关：每个策略只跑一次，两种评估函数一起求值
+    double costs[5][2];
+    int events[5];
+    for (int stg = 0; stg < 5; stg++) {
+        AnySimulation sim { versions[stg], EvaluateVersion::V1 };
+        sim.add_station("A", 1e3, 0, 0);
+        sim.add_station("B", 1, 0, 0);
+        sim.add_station("C", 1, 0, 0);
+        sim.add_station("D", 1e3, 0, 0);
+        sim.add_route("A", "B", 1, 1);
+        sim.add_route("A", "C", 1, 1);
+        sim.add_route("B", "D", 1, 1);
+        sim.add_route("C", "D", 1.01, 1);
+        for (int i = 1; i <= 100; i++) {
+            sim.add_order(
+                "p" + std::to_string(i),
+                0.001 * i,
+                i <= 50 ? PackageCategory::STANDARD : PackageCategory::EXPRESS,
+                "A",
+                "D"
+            );
+        }
+        sim.run();
+        const vector<double> res = sim.eval_all({ EvaluateVersion::V0, EvaluateVersion::V1 });
+        CHECK(res[1] == sim.eval());
+        costs[stg][0] = res[0];
+        costs[stg][1] = res[1];
+        events[stg] = sim.event_cnt();
+    }
     for (int eva = 0; eva < 2; eva++) {
         log::ecargo("Eval " + enames[eva], "====================");
         for (int stg = 0; stg < 5; stg++) {
-            auto stg_ver = [&stg]() {
-                if (stg == 0) {
-                    return StrategyVersion::V1;
-                } else if (stg == 1) {
-                    return StrategyVersion::V1B;
-                } else if (stg == 2) {
-                    return StrategyVersion::V2;
-                } else if (stg == 3) {
-                    return StrategyVersion::V2B;
-                } else {
-                    return StrategyVersion::V3;
-                }
-            }();
-            auto eva_ver = [&eva]() {
-                if (eva == 0) {
-                    return EvaluateVersion::V0;
-                } else {
-                    return EvaluateVersion::V1;
-                }
-            }();
-            Simulation sim { stg_ver, eva_ver };
-            sim.add_station("A", 1e3, 0, 0);
-            sim.add_station("B", 1, 0, 0);
-            sim.add_station("C", 1, 0, 0);
-            sim.add_station("D", 1e3, 0, 0);
-            sim.add_route("A", "B", 1, 1);
-            sim.add_route("A", "C", 1, 1);
-            sim.add_route("B", "D", 1, 1);
-            sim.add_route("C", "D", 1.01, 1);
-            for (int i = 1; i <= 100; i++) {
-                sim.add_order(
-                    "p" + std::to_string(i),
-                    0.001 * i,
-                    i <= 50 ? PackageCategory::STANDARD : PackageCategory::EXPRESS,
-                    "A",
-                    "D"
-                );
-            }
-            sim.run();
-            log::ecargo(snames[stg], "cost: {} events: {}", sim.eval(), sim.event_cnt);
+            log::ecargo(snames[stg], "cost: {} events: {}", costs[stg][eva], events[stg]);
         }
     }
 }
@@ -145,40 +248,33 @@ TEST_CASE("smart-pk") {
 TEST_CASE("main-pk") {
     const string snames[] = { "V1", "V1B", "V2", "V2B", "V3" };
     const string enames[] = { "V0", "V1" };
+    const StrategyVersion versions[] = {
+        StrategyVersion::V1, StrategyVersion::V1B, StrategyVersion::V2,
+        StrategyVersion::V2B, StrategyVersion::V3,
+    };
+    // 模拟与评估函数无关：每个策略只跑一次，两种评估函数一起求值
+    double costs[5][2];
+    int events[5];
+    for (int stg = 0; stg < 5; stg++) {
+        AnySimulation sim { versions[stg], EvaluateVersion::V1 };
+        sim.read_data("../data/data.txt");
+        sim.run();
+        const vector<double> res = sim.eval_all({ EvaluateVersion::V0, EvaluateVersion::V1 });
+        CHECK(res[1] == sim.eval());
+        costs[stg][0] = res[0];
+        costs[stg][1] = res[1];
+        events[stg] = sim.event_cnt();
+    }
     for (int eva = 0; eva < 2; eva++) {
         log::ecargo("Eval " + enames[eva], "====================");
         for (int stg = 0; stg < 5; stg++) {
-            auto stg_ver = [&stg]() {
-                if (stg == 0) {
-                    return StrategyVersion::V1;
-                } else if (stg == 1) {
-                    return StrategyVersion::V1B;
-                } else if (stg == 2) {
-                    return StrategyVersion::V2;
-                } else if (stg == 3) {
-                    return StrategyVersion::V2B;
-                } else {
-                    return StrategyVersion::V3;
-                }
-            }();
-            auto eva_ver = [&eva]() {
-                if (eva == 0) {
-                    return EvaluateVersion::V0;
-                } else {
-                    return EvaluateVersion::V1;
-                }
-            }();
-            Simulation sim { stg_ver, eva_ver };
-            sim.read_data("../data/data.txt");
-            // sim.schedule_event(new TryProcessOneV1(102, sim, "a"));
-            sim.run();
-            log::ecargo(snames[stg], "cost: {} events: {}", sim.eval(), sim.event_cnt);
+            log::ecargo(snames[stg], "cost: {} events: {}", costs[stg][eva], events[stg]);
         }
     }
 }
 
 TEST_CASE("buffer") {
-    Simulation sim;
+    AnySimulation sim;
     sim.add_station("a", 10, 4.5, 0);
     sim.add_station("b", 20, 2, 0);
     sim.add_route("a", "b", 100, 1200);
@@ -192,21 +288,21 @@ TEST_CASE("buffer") {
 }
 
 TEST_CASE("main-v1") {
-    Simulation sim { StrategyVersion::V1B, EvaluateVersion::V0 };
+    AnySimulation sim { StrategyVersion::V1B, EvaluateVersion::V0 };
     sim.read_data("../data.txt");
     // sim.schedule_event(new TryProcessOneV1(102, sim, "a"));
     sim.run();
     log::ecargo("v1-main", "cost: {}", sim.eval());
-    log::ecargo("Tag", "events: {}", sim.event_cnt);
+    log::ecargo("Tag", "events: {}", sim.event_cnt());
 }
 
 TEST_CASE("main-v2") {
-    Simulation sim { StrategyVersion::V2B, EvaluateVersion::V0 };
+    AnySimulation sim { StrategyVersion::V2B, EvaluateVersion::V0 };
     sim.read_data("../data.txt");
     // sim.schedule_event(new TryProcessOneV1(102, sim, "a"));
     sim.run();
     log::ecargo("v2-main", "cost: {}", sim.eval());
-    log::ecargo("Tag", "events: {}", sim.event_cnt);
+    log::ecargo("Tag", "events: {}", sim.event_cnt());
     // print all plans' size' in v2_cache
     // for (auto& [key, value]: sim.v2_cache.station_plans) {
     //     CHECK(value.arrival_time_of_due_pkgs.size() == 0);
@@ -214,12 +310,12 @@ TEST_CASE("main-v2") {
 }
 
 TEST_CASE("main-v3") {
-    Simulation sim { StrategyVersion::V3, EvaluateVersion::V1 };
+    AnySimulation sim { StrategyVersion::V3, EvaluateVersion::V1 };
     sim.read_data("../data/data.txt");
     // sim.schedule_event(new TryProcessOneV1(102, sim, "a"));
     sim.run();
     log::ecargo("v3-main", "cost: {}", sim.eval());
-    log::ecargo("Tag", "events: {}", sim.event_cnt);
+    log::ecargo("Tag", "events: {}", sim.event_cnt());
     // print all plans' size' in v2_cache
     // for (auto& [key, value]: sim.v2_cache.station_plans) {
     //     CHECK(value.arrival_time_of_due_pkgs.size() == 0);
@@ -227,7 +323,7 @@ TEST_CASE("main-v3") {
 }
 
 TEST_CASE("simple-v2") {
-    Simulation sim { StrategyVersion::V2, EvaluateVersion::V0 };
+    AnySimulation sim { StrategyVersion::V2, EvaluateVersion::V0 };
     sim.add_station("A", 5, 2, 100);
     sim.add_station("B", 20, 2, 100);
     sim.add_route("A", "B", 100, 50);
@@ -241,7 +337,7 @@ TEST_CASE("simple-v2") {
 }
 
 TEST_CASE("simple-v3") {
-    Simulation sim { StrategyVersion::V3, EvaluateVersion::V0 };
+    AnySimulation sim { StrategyVersion::V3, EvaluateVersion::V0 };
     sim.add_station("A", 5, 2, 100);
     sim.add_station("B", 20, 2, 100);
     sim.add_route("A", "B", 100, 50);
@@ -253,3 +349,624 @@ TEST_CASE("simple-v3") {
     sim.run();
     logs("cost: {}", sim.eval());
 }
+
+TEST_CASE("smart-batch") {
+    // 枢纽 A 处理能力远低于到达速率，buffer 会堆积
+    // 窗口小于 1 / throughput 时每批只有一个包裹，决策应与逐个处理完全一致
+    // 批中的包裹到各自的开始处理时间才离开 buffer，A 在每个时刻的占用应与逐个处理相同
+    // （同一时刻多个事件各写一行，行间先后随事件顺序不同，只比较每个时刻的最后一行）
+    const double windows[] = { 0, 1e-6, 1 };
+    double costs[3];
+    int events[3];
+    vector<string> occupancy[3];
+    for (int i = 0; i < 3; i++) {
+        sim::Simulation<strategy::v3::V3Policy> sim { EvaluateVersion::V1 };
+        sim.policy.batch_window = windows[i];
+        sim.add_station("A", 12, 0, 0);
+        sim.add_station("B", 1e3, 0, 0);
+        sim.add_station("C", 1e3, 0, 0);
+        sim.add_station("D", 1e3, 0, 0);
+        sim.add_route("A", "B", 1, 1);
+        sim.add_route("A", "C", 1, 1);
+        sim.add_route("B", "D", 1, 1);
+        sim.add_route("C", "D", 1.01, 1);
+        for (int j = 1; j <= 100; j++) {
+            sim.add_order(
+                "p" + std::to_string(j),
+                0.001 * j,
+                j <= 50 ? PackageCategory::STANDARD : PackageCategory::EXPRESS,
+                "A",
+                "D"
+            );
+        }
+        sim.run();
+        costs[i] = sim.eval();
+        events[i] = sim.event_cnt;
+        log::ecargo("Batch", "window: {} cost: {} events: {}", windows[i], costs[i], events[i]);
+        std::ifstream file("number_package_in_station.csv");
+        for (string line; std::getline(file, line);) {
+            if (line.find(",A,") == string::npos) {
+                continue;
+            }
+            const string time = line.substr(0, line.find(','));
+            if (!occupancy[i].empty()
+                && occupancy[i].back().substr(0, occupancy[i].back().find(',')) == time)
+            {
+                occupancy[i].pop_back();
+            }
+            occupancy[i].push_back(line);
+        }
+    }
+    CHECK(rust::eq(costs[0], costs[1]));
+    CHECK(rust::eq(costs[0], costs[2]));
+    CHECK(occupancy[1] == occupancy[0]);
+    CHECK(occupancy[2] == occupancy[0]);
+    // 省下的是转发包裹的 StartSend、站点忙时到达引起的失败唤醒，以及窗口内的逐个唤醒
+    // 每个包裹的 Arrival 时间各不相同，仍逐个处理
+    CHECK(events[0] == 1299);
+    CHECK(events[1] == 901);
+    CHECK(events[2] == 811);
+}
+
+TEST_CASE("retire") {
+    // 退役只改变求和顺序，代价应几乎一致；跑完后 packages 为空
+    for (const auto stg: { StrategyVersion::V1, StrategyVersion::V2, StrategyVersion::V3 }) {
+        double costs[2];
+        for (int retire = 0; retire < 2; retire++) {
+            AnySimulation sim { stg, EvaluateVersion::V1 };
+            if (retire) {
+                sim.enable_retirement();
+            }
+            sim.add_station("A", 12, 0, 0);
+            sim.add_station("B", 1e3, 0, 0);
+            sim.add_station("C", 1e3, 0, 0);
+            sim.add_route("A", "B", 1, 1);
+            sim.add_route("B", "C", 1, 1);
+            sim.add_route("A", "C", 2.5, 1);
+            for (int j = 1; j <= 100; j++) {
+                sim.add_order(
+                    "p" + std::to_string(j),
+                    0.01 * j,
+                    j % 2 ? PackageCategory::STANDARD : PackageCategory::EXPRESS,
+                    "A",
+                    "C"
+                );
+            }
+            sim.run();
+            costs[retire] = sim.eval();
+            CHECK(sim.eval_all({ EvaluateVersion::V1 })[0] == costs[retire]);
+            if (retire) {
+                CHECK(sim.base().packages.empty());
+            }
+        }
+        CHECK(std::abs(costs[0] - costs[1]) < 1e-6 * costs[0]);
+    }
+}
+
+TEST_CASE("replay") {
+    const string snames[] = { "V1", "V1B", "V2", "V2B", "V3" };
+    const StrategyVersion versions[] = {
+        StrategyVersion::V1, StrategyVersion::V1B, StrategyVersion::V2,
+        StrategyVersion::V2B, StrategyVersion::V3,
+    };
+    for (int stg = 0; stg < 5; stg++) {
+        AnySimulation sim { versions[stg], EvaluateVersion::V1 };
+        sim.read_data("../data/data.txt");
+        sim.enable_journal("journal.bin");
+        sim.run();
+
+        sim::Simulation<strategy::replay::ReplayPolicy> replay { EvaluateVersion::V1 };
+        replay.read_data("../data/data.txt");
+        REQUIRE(replay.policy.start(replay, "journal.bin"));
+        replay.run();
+        CHECK(!replay.policy.divergence.has_value());
+        CHECK(replay.eval() == sim.eval());
+        log::ecargo(snames[stg], "replayed {} decisions", replay.policy.replayed);
+    }
+
+    // 处理能力变化后，第一处 cd 冲突应被报告
+    sim::Simulation<strategy::replay::ReplayPolicy> replay { EvaluateVersion::V1 };
+    replay.read_data("../data/data.txt");
+    for (auto& [id, station]: replay.stations) {
+        station.throughput /= 2;
+    }
+    REQUIRE(replay.policy.start(replay, "journal.bin"));
+    replay.run();
+    REQUIRE(replay.policy.divergence.has_value());
+    CHECK(replay.policy.divergence->reason == "start-process is in cd");
+}
+
+TEST_CASE("trace") {
+    AnySimulation sim { StrategyVersion::V3, EvaluateVersion::V1 };
+    sim.read_data("../data/data.txt");
+    sim.enable_trace("trace.bin", 8);
+    sim.run();
+
+    // 与 csv 逐行对应
+    vector<vector<string>> csv[2];
+    const char* paths[2] = { "number_package_in_station.csv", "package_trip.csv" };
+    for (int i = 0; i < 2; i++) {
+        std::ifstream file(paths[i]);
+        for (string line; std::getline(file, line);) {
+            std::stringstream ss(line);
+            vector<string> row;
+            for (string cell; std::getline(ss, cell, ',');) {
+                row.push_back(cell);
+            }
+            csv[i].push_back(row);
+        }
+    }
+    trace::Reader reader("trace.bin");
+    REQUIRE(reader.is_open());
+    CHECK(reader.chunk_cnt() > 1);
+    const trace::Window all = reader.window(reader.begin_time(), reader.end_time());
+    REQUIRE(all.occupancy.size() == csv[0].size());
+    REQUIRE(all.trips.size() == csv[1].size());
+    CHECK(all.events.size() == size_t(sim.event_cnt()));
+    for (size_t i = 0; i < csv[0].size(); i++) {
+        CHECK(std::abs(all.occupancy[i].time - std::stod(csv[0][i][0])) < 1e-3);
+        CHECK(all.occupancy[i].station == csv[0][i][1]);
+        CHECK(all.occupancy[i].size == std::stoll(csv[0][i][2]));
+    }
+    for (size_t i = 0; i < csv[1].size(); i++) {
+        CHECK(all.trips[i].package == csv[1][i][1]);
+        CHECK(all.trips[i].src == csv[1][i][2]);
+        CHECK(all.trips[i].dst == csv[1][i][3]);
+    }
+
+    // 时间窗口只返回窗口内的行
+    const double t0 = reader.begin_time() + 10, t1 = t0 + 5;
+    const trace::Window part = reader.window(t0, t1);
+    size_t expected = 0;
+    for (const auto& row: all.trips) {
+        expected += t0 <= row.time && row.time <= t1;
+    }
+    CHECK(part.trips.size() == expected);
+    for (const auto& row: part.occupancy) {
+        CHECK((t0 <= row.time && row.time <= t1));
+    }
+
+    // 单个包裹的行程
+    const string package = csv[1].back()[1];
+    vector<trace::TripRow> expected_trip;
+    for (const auto& row: all.trips) {
+        if (row.package == package) {
+            expected_trip.push_back(row);
+        }
+    }
+    const vector<trace::TripRow> trip = reader.trip(package);
+    REQUIRE(trip.size() == expected_trip.size());
+    for (size_t i = 0; i < trip.size(); i++) {
+        CHECK(trip[i].time == expected_trip[i].time);
+        CHECK(trip[i].dst == expected_trip[i].dst);
+    }
+    CHECK(reader.trip("no-such-package").empty());
+}
+
+TEST_CASE("pipelined") {
+    // 解析线程与模拟线程之间的环形队列不丢不乱
+    {
+        ingest::SpscRing<int, 64> ring;
+        const int n = 100000;
+        std::thread producer([&]() {
+            for (int i = 0; i < n; i++) {
+                while (!ring.try_push(int(i))) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+        int expected = 0;
+        for (int value; expected < n;) {
+            if (ring.try_pop(value)) {
+                CHECK(value == expected);
+                expected += 1;
+            }
+        }
+        producer.join();
+    }
+
+    // 流水线读入要求 packets 按创建时间排序，先生成排好序的数据
+    {
+        std::ifstream in("../data/data.txt");
+        REQUIRE(in.is_open());
+        std::ofstream out("data_sorted.txt", std::ios::trunc);
+        vector<pair<double, string>> packets;
+        bool is_orders_section = false;
+        for (string line; std::getline(in, line);) {
+            if (is_orders_section) {
+                packets.emplace_back(ingest::parse_order(line)->time, line);
+                continue;
+            }
+            is_orders_section = line == "packets:";
+            out << line << "\n";
+        }
+        std::stable_sort(packets.begin(), packets.end(), [](const auto& a, const auto& b) {
+            return a.first < b.first;
+        });
+        for (const auto& [time, line]: packets) {
+            out << line << "\n";
+        }
+    }
+    // 默认模式下同一时刻事件的出堆顺序与插入历史有关，边读边模拟时会有细微差别
+    // tick 模式按 (tick, seq) 出堆，两种读入方式结果完全一致
+    for (const auto stg: { StrategyVersion::V1, StrategyVersion::V2, StrategyVersion::V3 }) {
+        for (int ticks = 0; ticks < 2; ticks++) {
+            double costs[2];
+            int events[2];
+            for (int pipelined = 0; pipelined < 2; pipelined++) {
+                AnySimulation sim { stg, EvaluateVersion::V1 };
+                REQUIRE(sim.read_data("data_sorted.txt", pipelined));
+                if (ticks) {
+                    sim.enable_ticks();
+                }
+                sim.run();
+                costs[pipelined] = sim.eval();
+                events[pipelined] = sim.event_cnt();
+                CHECK(sim.base().packages.size() == 1000);
+                if (ticks) {
+                    CHECK(sim.base().batch_cnt <= sim.event_cnt());
+                }
+            }
+            if (ticks) {
+                CHECK(costs[0] == costs[1]);
+                CHECK(events[0] == events[1]);
+            } else {
+                CHECK(std::abs(costs[0] - costs[1]) < 1e-3 * costs[0]);
+            }
+        }
+    }
+
+    // 退役只删去已送达的包裹：一次读入时 packages 从全部订单开始，
+    // 流水线读入时只有已读入、未送达的包裹。订单每 0.25 小时一个，每个约 1 小时送达
+    {
+        std::ofstream out("data_spread.txt", std::ios::trunc);
+        out << "stations:\nA , (10, 0.1, 1)\nB , (10, 0.1, 1)\nedges:\nA , B , 1 , 1\npackets:\n";
+        for (int i = 0; i < 2000; i++) {
+            out << fmt::format("p{} , {} , {} , A , B\n", i, 0.25 * i, i % 2);
+        }
+    }
+    for (const auto stg: { StrategyVersion::V1, StrategyVersion::V2, StrategyVersion::V3 }) {
+        size_t peaks[2];
+        for (int pipelined = 0; pipelined < 2; pipelined++) {
+            AnySimulation sim { stg, EvaluateVersion::V1 };
+            sim.enable_retirement();
+            REQUIRE(sim.read_data("data_spread.txt", pipelined));
+            peaks[pipelined] = sim.base().packages.size();
+            while (sim.step(1) == 1) {
+                peaks[pipelined] = std::max(peaks[pipelined], sim.base().packages.size());
+            }
+            CHECK(sim.base().packages.empty());
+        }
+        CHECK(peaks[0] == 2000);
+        CHECK(peaks[1] <= 8);
+    }
+}
+
+TEST_CASE("scenario") {
+    const auto shared = scenario::Scenario::read("../data/data.txt");
+    CHECK(shared->orders.size() == 1000);
+
+    // 载入共享场景与各自读文件的结果一致
+    const StrategyVersion stgs[] = { StrategyVersion::V1, StrategyVersion::V1B, StrategyVersion::V2,
+                                     StrategyVersion::V2B, StrategyVersion::V3 };
+    map<StrategyVersion, double> expected;
+    for (const auto stg: stgs) {
+        AnySimulation read { stg, EvaluateVersion::V1 };
+        read.read_data("../data/data.txt");
+        read.run();
+        AnySimulation loaded { stg, EvaluateVersion::V1 };
+        loaded.load(shared);
+        loaded.run();
+        CHECK(read.eval() == loaded.eval());
+        CHECK(read.event_cnt() == loaded.event_cnt());
+        CHECK(&loaded.base().routes() == &shared->routes);
+        expected[stg] = loaded.eval();
+    }
+
+    // 共享者用同一份 CH
+    sim::Simulation<strategy::v1::V1Policy> a { EvaluateVersion::V1 };
+    sim::Simulation<strategy::v1::V1Policy> b { EvaluateVersion::V1 };
+    a.load(shared);
+    b.load(shared);
+    a.run();
+    b.run();
+    CHECK(a.policy.hierarchy == shared->hierarchy());
+    CHECK(b.policy.hierarchy == shared->hierarchy());
+    CHECK(a.eval() == b.eval());
+
+    // 每种策略两个线程，同时在一份新场景上载入、第一次建立 CH / ALT 等预处理并查询
+    const auto fresh = scenario::Scenario::read("../data/data.txt");
+    double costs[std::size(stgs)][2];
+    vector<std::thread> threads;
+    for (size_t i = 0; i < std::size(stgs); i++) {
+        for (int j = 0; j < 2; j++) {
+            threads.emplace_back([&, i, j] {
+                AnySimulation sim { stgs[i], EvaluateVersion::V1 };
+                sim.disable_csv();
+                sim.load(fresh);
+                sim.run();
+                costs[i][j] = sim.eval();
+            });
+        }
+    }
+    for (auto& t: threads) {
+        t.join();
+    }
+    for (size_t i = 0; i < std::size(stgs); i++) {
+        for (int j = 0; j < 2; j++) {
+            CHECK(costs[i][j] == expected[stgs[i]]);
+        }
+    }
+}
+
+TEST_CASE("speculate") {
+    auto read_file = [](const string& path) {
+        std::ifstream file(path);
+        std::stringstream ss;
+        ss << file.rdbuf();
+        return ss.str();
+    };
+    // 推测执行与逐个处理的结果完全一致，包括每个包裹的行程
+    for (const double batch_window: { 0.0, 0.5 }) {
+        double costs[2];
+        int events[2];
+        string trips[2];
+        for (int speculative = 0; speculative < 2; speculative++) {
+            sim::Simulation<strategy::v3::V3Policy> sim { EvaluateVersion::V1 };
+            sim.policy.batch_window = batch_window;
+            sim.read_data("../data/data.txt");
+            if (speculative) {
+                // 批处理时站点只在 ready_time 唤醒，同一 tick 很少凑满默认的 4 个，逐个也推测
+                sim.enable_speculation(3, 1);
+            } else {
+                sim.enable_ticks();
+            }
+            sim.run();
+            costs[speculative] = sim.eval();
+            events[speculative] = sim.event_cnt;
+            trips[speculative] = read_file("package_trip.csv");
+            if (speculative) {
+                CHECK(sim.speculated > 0);
+                CHECK(sim.speculation_hits <= sim.speculated);
+            }
+        }
+        CHECK(costs[0] == costs[1]);
+        CHECK(events[0] == events[1]);
+        CHECK(trips[0] == trips[1]);
+    }
+}
+
+TEST_CASE("replan") {
+    auto run = [](double tolerance, bool audit) {
+        sim::Simulation<strategy::v3::V3Policy> sim { EvaluateVersion::V1 };
+        sim.policy.replan_tolerance = tolerance;
+        sim.policy.replan_audit = audit;
+        sim.read_data("../data/data.txt");
+        sim.run();
+        return std::make_pair(sim.eval(), sim.policy.replan_stats);
+    };
+    // 容差为 0 时每次都重新建树，即精确模式
+    const auto [exact, exact_stats] = run(0, false);
+    CHECK(exact_stats.reused == 0);
+    log::ecargo("Replan", "tolerance: 0 cost: {} trees: {}", exact, exact_stats.built);
+    // 各容差下复用的比例、与精确模式决策一致的比例、EvalFuncV1 代价的差异，用来挑选容差
+    for (const double tolerance: { 1.0, 4.0, 16.0, 64.0 }) {
+        const auto [cost, stats] = run(tolerance, true);
+        CHECK(stats.audited == stats.reused);
+        CHECK(stats.agreed <= stats.audited);
+        log::ecargo(
+            "Replan",
+            "tolerance: {} cost: {} ({:+.2f}%) trees: {} reused: {} agree: {:.1f}%",
+            tolerance,
+            cost,
+            100 * (cost - exact) / exact,
+            stats.built,
+            stats.reused,
+            stats.audited == 0 ? 100.0 : 100.0 * stats.agreed / stats.audited
+        );
+    }
+}
+
+TEST_CASE("tree-kernel") {
+    using strategy::v3::TreeKernel;
+    auto run = [](TreeKernel kernel, double tolerance) {
+        sim::Simulation<strategy::v3::V3Policy> sim { EvaluateVersion::V1 };
+        sim.policy.tree_kernel = kernel;
+        sim.policy.replan_tolerance = tolerance;
+        sim.read_data("../data/data.txt");
+        sim.run();
+        return std::make_tuple(sim.eval(), sim.event_cnt, sim.policy.replan_stats.reused);
+    };
+    // 各核建出的树逐位相同；近似重规划用到搜索读过的站点，决策也应相同
+    for (const double tolerance: { 0.0, 16.0 }) {
+        const auto sparse = run(TreeKernel::SPARSE, tolerance);
+        CHECK(sparse == run(TreeKernel::DENSE, tolerance));
+        CHECK(sparse == run(TreeKernel::DELTA, tolerance));
+    }
+    using strategy::dense::Isa;
+    log::ecargo("Dense", "row relaxation: {}", strategy::dense::isa_name(Isa::AUTO));
+}
+
+TEST_CASE("run-until") {
+    auto read_file = [](const string& path) {
+        std::ifstream file(path);
+        std::stringstream ss;
+        ss << file.rdbuf();
+        return ss.str();
+    };
+    // 分段推进与一次跑完结果完全一致；tick 模式下 step 会停在一批事件中间
+    for (const bool ticks: { false, true }) {
+        AnySimulation whole { StrategyVersion::V3, EvaluateVersion::V1 };
+        whole.read_data("../data/data.txt");
+        if (ticks) {
+            whole.enable_ticks();
+        }
+        whole.run();
+        const string trips = read_file("package_trip.csv");
+
+        AnySimulation sim { StrategyVersion::V3, EvaluateVersion::V1 };
+        sim.read_data("../data/data.txt");
+        if (ticks) {
+            sim.enable_ticks();
+        }
+        vector<double> reports;
+        int last_events = 0;
+        sim.on_interval(24, [&](const sim::Progress& progress) {
+            reports.push_back(progress.time);
+            CHECK(progress.event_cnt >= last_events);
+            CHECK(sim.now() < progress.time);
+            last_events = progress.event_cnt;
+        });
+        CHECK(sim.step(7) == 7);
+        for (double t = 10; sim.run_until(t); t += 10) {
+            CHECK(sim.now() <= t);
+            CHECK(sim.step(3) <= 3);
+        }
+        CHECK(sim.done());
+        CHECK(sim.step(1) == 0);
+        CHECK(sim.eval() == whole.eval());
+        CHECK(sim.event_cnt() == whole.event_cnt());
+        CHECK(read_file("package_trip.csv") == trips);
+        REQUIRE(!reports.empty());
+        CHECK(reports.size() == (size_t)(sim.now() / 24));
+        for (size_t i = 0; i < reports.size(); i++) {
+            CHECK(reports[i] == 24.0 * (i + 1));
+        }
+    }
+
+    // 停在中途销毁：队列与当前一批中剩下的事件随模拟一起释放，泄漏由 -fsanitize=address 检查
+    for (const bool ticks: { false, true }) {
+        AnySimulation sim { StrategyVersion::V3, EvaluateVersion::V1 };
+        sim.read_data("../data/data.txt");
+        if (ticks) {
+            sim.enable_ticks();
+        }
+        CHECK(sim.run_until(50));
+        sim.step(1);
+        CHECK(!sim.done());
+    }
+
+    // 一个线程读入、另一个线程运行，结果与在同一个线程上相同
+    AnySimulation whole { StrategyVersion::V3, EvaluateVersion::V1 };
+    whole.read_data("../data/data.txt");
+    whole.run();
+    AnySimulation moved { StrategyVersion::V3, EvaluateVersion::V1 };
+    std::thread([&]() { moved.read_data("../data/data.txt"); }).join();
+    std::thread([&]() { moved.run(); }).join();
+    CHECK(moved.eval() == whole.eval());
+    CHECK(moved.event_cnt() == whole.event_cnt());
+}
+
+TEST_CASE("capi") {
+    // 由数组建立场景：a -> b -> c，一个包裹从 a 送到 c
+    const char* station_ids[] = { "a", "b", "c" };
+    const double throughput[] = { 1, 1, 1 };
+    const double process_delay[] = { 0.1, 0.1, 0.1 };
+    const double station_cost[] = { 1, 2, 3 };
+    const int32_t route_src[] = { 0, 1 };
+    const int32_t route_dst[] = { 1, 2 };
+    const double route_time[] = { 1, 2 };
+    const double route_cost[] = { 10, 20 };
+    const char* order_ids[] = { "p" };
+    const double order_time[] = { 0.5 };
+    const int32_t order_ctg[] = { 1 };
+    const int32_t order_src[] = { 0 };
+    const int32_t order_dst[] = { 2 };
+    ds_scenario* scenario = ds_scenario_create(
+        3,
+        station_ids,
+        throughput,
+        process_delay,
+        station_cost,
+        2,
+        route_src,
+        route_dst,
+        route_time,
+        route_cost,
+        1,
+        order_ids,
+        order_time,
+        order_ctg,
+        order_src,
+        order_dst
+    );
+    REQUIRE(scenario != nullptr);
+    CHECK(string(ds_scenario_station_id(scenario, 2)) == "c");
+
+    ds_run* run = ds_run_create(scenario, DS_STRATEGY_V1);
+    REQUIRE(run != nullptr);
+    CHECK(ds_run_execute(run) > 0);
+    CHECK(ds_run_execute(run) == -1);
+
+    const double *time, *time_created, *time_finished;
+    const int32_t *package, *src, *dst, *station, *size;
+    const uint8_t* finished;
+    // 到达 a，a -> b，到达 b，b -> c，到达 c，在 c 处理
+    REQUIRE(ds_run_trips(run, &time, &package, &src, &dst) == 6);
+    CHECK(src[1] == 0);
+    CHECK(dst[1] == 1);
+    CHECK(src[5] == 2);
+    CHECK(dst[5] == 2);
+    const int64_t rows = ds_run_occupancy(run, &time, &station, &size);
+    CHECK(rows > 0);
+    CHECK(rows % 3 == 0);
+    REQUIRE(ds_run_packages(run, &time_created, &time_finished, &finished) == 1);
+    CHECK(finished[0] == 1);
+    CHECK(rust::eq(time_finished[0], 0.5 + 0.1 + 1 + 0.1 + 2 + 0.1));
+
+    AnySimulation sim { StrategyVersion::V1, EvaluateVersion::V0 };
+    for (int i = 0; i < 3; i++) {
+        sim.add_station(station_ids[i], throughput[i], process_delay[i], station_cost[i]);
+    }
+    sim.add_route("a", "b", 1, 10);
+    sim.add_route("b", "c", 2, 20);
+    sim.add_order("p", 0.5, PackageCategory::EXPRESS, "a", "c");
+    sim.run();
+    const int32_t evaluators[] = { DS_EVAL_V0, DS_EVAL_V1 };
+    double costs[2];
+    CHECK(ds_run_costs(run, evaluators, 2, costs) == 2);
+    CHECK(costs[0] == sim.eval());
+    CHECK(costs[1] == sim.eval_all({ EvaluateVersion::V1 })[0]);
+
+    const int32_t bad[] = { 7 };
+    CHECK(ds_run_costs(run, bad, 1, costs) == -1);
+    CHECK(string(ds_last_error()) == "unknown evaluator 7");
+    CHECK(ds_run_create(scenario, 9) == nullptr);
+    ds_run_free(run);
+
+    // 没跑完时不给出部分代价
+    run = ds_run_create(scenario, DS_STRATEGY_V1);
+    REQUIRE(run != nullptr);
+    CHECK(ds_run_until(run, 1) > 0);
+    CHECK(ds_run_costs(run, evaluators, 2, costs) == -1);
+    CHECK(string(ds_last_error()) == "run not finished");
+    CHECK(ds_run_execute(run) > 0);
+    CHECK(ds_run_costs(run, evaluators, 2, costs) == 2);
+    ds_run_free(run);
+    ds_scenario_free(scenario);
+    CHECK(ds_scenario_read("no-such-file.txt") == nullptr);
+
+    const int32_t bad_ctg[] = { 2 };
+    CHECK(
+        ds_scenario_create(
+            3,
+            station_ids,
+            throughput,
+            process_delay,
+            station_cost,
+            2,
+            route_src,
+            route_dst,
+            route_time,
+            route_cost,
+            1,
+            order_ids,
+            order_time,
+            bad_ctg,
+            order_src,
+            order_dst
+        )
+        == nullptr
+    );
+    CHECK(string(ds_last_error()) == "order 0: bad category");
+}
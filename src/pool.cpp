@@ -0,0 +1,80 @@
+#include "pool.hpp"
+
+namespace pool {
+
+WorkerPool::WorkerPool(int threads) {
+    for (int i = 0; i < threads; i++) {
+        this->workers.emplace_back(&WorkerPool::work, this);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+    this->wake.notify_all();
+    for (auto& worker: this->workers) {
+        worker.join();
+    }
+}
+
+void WorkerPool::drain(const std::function<void(size_t)>& fn, size_t n) {
+    for (size_t i = this->next.fetch_add(1, std::memory_order_relaxed); i < n;
+         i = this->next.fetch_add(1, std::memory_order_relaxed))
+    {
+        fn(i);
+    }
+}
+
+void WorkerPool::parallel_for(size_t n, const std::function<void(size_t)>& fn) {
+    if (n == 0) {
+        return;
+    }
+    if (this->workers.empty() || n == 1) {
+        for (size_t i = 0; i < n; i++) {
+            fn(i);
+        }
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->job = &fn;
+        this->job_size = n;
+        this->next.store(0, std::memory_order_relaxed);
+        this->busy = static_cast<int>(this->workers.size());
+        this->generation += 1;
+    }
+    this->wake.notify_all();
+    this->drain(fn, n);
+    // 工作线程都退出 drain 后 fn 才能失效
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->done.wait(lock, [this] { return this->busy == 0; });
+    this->job = nullptr;
+}
+
+void WorkerPool::work() {
+    uint64_t seen = 0;
+    while (true) {
+        const std::function<void(size_t)>* fn;
+        size_t n;
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->wake.wait(lock, [&] { return this->stopping || this->generation != seen; });
+            if (this->stopping) {
+                return;
+            }
+            seen = this->generation;
+            fn = this->job;
+            n = this->job_size;
+        }
+        this->drain(*fn, n);
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->busy -= 1;
+        }
+        this->done.notify_one();
+    }
+}
+
+} // namespace pool
@@ -0,0 +1,50 @@
+#ifndef POOL_HPP
+#define POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace pool {
+
+// 常驻工作线程；parallel_for 把 [0, n) 分给工作线程和调用线程
+// 各线程从公共计数器逐项领取，先做完的线程自动多做，单项耗时不均时也不会空等
+struct WorkerPool {
+public:
+    // threads 为额外的工作线程数，调用线程也参与计算
+    explicit WorkerPool(int threads);
+    ~WorkerPool();
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // 对每个 i 调用一次 fn(i)，全部完成后返回；fn 必须可以并发调用
+    void parallel_for(size_t n, const std::function<void(size_t)>& fn);
+
+    int size() const {
+        return static_cast<int>(this->workers.size()) + 1;
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::vector<std::thread> workers;
+
+    const std::function<void(size_t)>* job = nullptr;
+    size_t job_size = 0;
+    std::atomic<size_t> next { 0 };
+    // 每次 parallel_for 加一，工作线程据此判断是否有新任务
+    uint64_t generation = 0;
+    int busy = 0;
+    bool stopping = false;
+
+    void work();
+    void drain(const std::function<void(size_t)>& fn, size_t n);
+};
+
+} // namespace pool
+#endif
@@ -0,0 +1,186 @@
+#include "profile.hpp"
+
+#ifdef DS_PROFILE
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "fmt/core.h"
+
+#include "rust.hpp"
+
+namespace profile {
+using std::string;
+using std::vector;
+
+namespace {
+
+struct TraceEvent {
+    const Site* site;
+    int tid;
+    double start_us;
+    double dur_us;
+};
+
+// trace 最多保留的事件数，超出后只更新汇总
+constexpr size_t TRACE_CAPACITY = 1 << 21;
+
+uint64_t read_sample_period() {
+    const char* env = std::getenv("DS_PROFILE_SAMPLE");
+    const long long period = env == nullptr ? 8 : std::atoll(env);
+    return period > 0 ? period : 1;
+}
+
+string escape(const string& s) {
+    string res;
+    for (char c: s) {
+        if (c == '"' || c == '\\') {
+            res += '\\';
+        }
+        res += c;
+    }
+    return res;
+}
+
+// 各线程按第一次计时的先后编号，主线程通常为 0
+int thread_id() {
+    static std::atomic<int> next = 0;
+    thread_local const int id = next.fetch_add(1, std::memory_order_relaxed);
+    return id;
+}
+
+// sites、type_sites 与 trace 由 mutex 保护；导出在所有线程结束之后
+struct Registry {
+    std::mutex mutex;
+    vector<Site*> sites;
+    std::unordered_map<std::type_index, Site*> type_sites;
+    vector<TraceEvent> trace;
+    std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+
+    ~Registry() {
+        if (!this->sites.empty()) {
+            this->write_trace("profile.json");
+            this->write_flat("profile.txt");
+        }
+    }
+
+    void write_trace(const string& path) const {
+        std::ofstream file(path, std::ios::trunc);
+        file << "{\"traceEvents\": [";
+        for (size_t i = 0; i < this->trace.size(); i++) {
+            const TraceEvent& e = this->trace[i];
+            file << fmt::format(
+                "{}\n{{\"name\": \"{}\", \"ph\": \"X\", \"ts\": {:.3f}, \"dur\": {:.3f}, "
+                "\"pid\": 0, \"tid\": {}}}",
+                i == 0 ? "" : ",",
+                escape(e.site->name),
+                e.start_us,
+                e.dur_us,
+                e.tid
+            );
+        }
+        file << "\n], \"displayTimeUnit\": \"ms\"}\n";
+    }
+
+    // 按外推总耗时降序；嵌套的计时点会重复计入外层
+    void write_flat(const string& path) const {
+        vector<const Site*> sorted(this->sites.begin(), this->sites.end());
+        auto mean_us = [](const Site* s) {
+            return s->sampled == 0 ? 0.0 : s->sampled_ns / 1e3 / s->sampled;
+        };
+        auto estimated_us = [&](const Site* s) {
+            return mean_us(s) * s->calls;
+        };
+        std::sort(sorted.begin(), sorted.end(), [&](const Site* a, const Site* b) {
+            return estimated_us(a) > estimated_us(b);
+        });
+        std::ofstream file(path, std::ios::trunc);
+        file << fmt::format("sample period: {}\n", sample_period);
+        file << fmt::format(
+            "{:>12} {:>12} {:>12} {:>12}  {}\n",
+            "total ms",
+            "calls",
+            "sampled",
+            "mean us",
+            "name"
+        );
+        for (const Site* s: sorted) {
+            file << fmt::format(
+                "{:>12.3f} {:>12} {:>12} {:>12.3f}  {}\n",
+                estimated_us(s) / 1e3,
+                s->calls.load(),
+                s->sampled.load(),
+                mean_us(s),
+                s->name
+            );
+        }
+    }
+};
+
+Registry registry;
+
+} // namespace
+
+uint64_t sample_period = read_sample_period();
+
+Site& site(const char* name) {
+    Site* s = new Site { name };
+    std::lock_guard lock(registry.mutex);
+    registry.sites.push_back(s);
+    return *s;
+}
+
+Site& site_of(std::type_index type) {
+    // 每个事件都会查一次，先查本线程的缓存，不必每次加锁
+    thread_local std::unordered_map<std::type_index, Site*> cached;
+    auto local = cached.find(type);
+    if (local != cached.end()) {
+        return *local->second;
+    }
+    Site* s = nullptr;
+    {
+        std::lock_guard lock(registry.mutex);
+        auto it = registry.type_sites.find(type);
+        if (it != registry.type_sites.end()) {
+            s = it->second;
+        }
+    }
+    if (s == nullptr) {
+        Site& created = site(rust::demangle(type.name()).c_str());
+        std::lock_guard lock(registry.mutex);
+        // 其他线程可能同时建立了同一类型的计时点，以先登记的为准
+        s = registry.type_sites.emplace(type, &created).first->second;
+    }
+    cached.emplace(type, s);
+    return *s;
+}
+
+Scope::~Scope() {
+    if (!this->sampling) {
+        return;
+    }
+    const auto end = std::chrono::steady_clock::now();
+    const auto dur = end - this->start;
+    this->site.sampled.fetch_add(1, std::memory_order_relaxed);
+    this->site.sampled_ns.fetch_add(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(dur).count(),
+        std::memory_order_relaxed
+    );
+    const double dur_us = std::chrono::duration<double, std::micro>(dur).count();
+    const double start_us =
+        std::chrono::duration<double, std::micro>(this->start - registry.origin).count();
+    const int tid = thread_id();
+    std::lock_guard lock(registry.mutex);
+    if (registry.trace.size() < TRACE_CAPACITY) {
+        registry.trace.push_back(TraceEvent { &this->site, tid, start_us, dur_us });
+    }
+}
+
+} // namespace profile
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef PROFILE_HPP
+#define PROFILE_HPP
+
+// 分阶段计时：PROFILE_SCOPE("name") 统计所在作用域的耗时
+// 只在定义 DS_PROFILE 时生效（cmake -DPROFILE=ON），否则宏展开为空，没有任何开销
+// 程序退出时写出 profile.json（Chrome trace / Perfetto 可直接打开）与 profile.txt（汇总）
+// 每个作用域每 DS_PROFILE_SAMPLE 次（环境变量，默认 8）计时一次，汇总按采样比例外推
+// 可以在多个线程上同时计时：计数为原子量，trace 中每个事件带所在线程的编号
+
+#ifdef DS_PROFILE
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <typeindex>
+
+namespace profile {
+
+// 一个计时点，调用次数精确，耗时只累计被采样的那些
+struct Site {
+    std::string name;
+    std::atomic<uint64_t> calls = 0;
+    std::atomic<uint64_t> sampled = 0;
+    std::atomic<uint64_t> sampled_ns = 0;
+};
+
+// 计时点在程序退出导出之后才释放，所以统一由这里分配
+Site& site(const char* name);
+// 按类型区分的计时点（如每种事件），名字取 demangle 后的类型名
+Site& site_of(std::type_index type);
+
+extern uint64_t sample_period;
+
+struct Scope {
+public:
+    explicit Scope(Site& site): site(site) {
+        // 第 1, 1 + period, 1 + 2 * period ... 次计时，只调用一次的阶段也有数据
+        if (site.calls.fetch_add(1, std::memory_order_relaxed) % sample_period == 0) {
+            this->start = std::chrono::steady_clock::now();
+            this->sampling = true;
+        }
+    }
+    ~Scope();
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+private:
+    Site& site;
+    bool sampling = false;
+    std::chrono::steady_clock::time_point start;
+};
+
+} // namespace profile
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name) \
+    static profile::Site& PROFILE_CONCAT(profile_site_, __LINE__) = profile::site(name); \
+    profile::Scope PROFILE_CONCAT(profile_scope_, __LINE__) { \
+        PROFILE_CONCAT(profile_site_, __LINE__) \
+    }
+#define PROFILE_TYPE_SCOPE(type) \
+    profile::Scope PROFILE_CONCAT(profile_scope_, __LINE__) { profile::site_of(type) }
+
+#else
+
+#define PROFILE_SCOPE(name)
+#define PROFILE_TYPE_SCOPE(type)
+
+#endif
+#endif
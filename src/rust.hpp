@@ -2,6 +2,13 @@
 #define RUST_HPP
 
 #include <cmath>
+#include <cstdlib>
+#include <memory>
+#include <string>
+
+#ifdef __GNUG__
+#include <cxxabi.h>
+#endif
 
 namespace rust {
 constexpr double EPS = 1e-9;
@@ -14,6 +21,21 @@ inline bool eq(double a, double b) {
     return std::abs(a - b) < EPS;
 }
 
+// typeid(...).name() 转成可读的类型名，不支持时原样返回
+inline std::string demangle(const char* name) {
+#ifdef __GNUG__
+    int status = 0;
+    std::unique_ptr<char, void (*)(void*)> res {
+        abi::__cxa_demangle(name, nullptr, nullptr, &status),
+        std::free,
+    };
+    if (status == 0) {
+        return res.get();
+    }
+#endif
+    return name;
+}
+
 } // namespace rust
 
 #endif
@@ -0,0 +1,76 @@
+#include "scenario.hpp"
+
+#include <fstream>
+
+namespace scenario {
+
+shared_ptr<const Scenario> Scenario::read(const string& path) {
+    vector<ingest::StationLine> station_lines;
+    vector<ingest::RouteLine> route_lines;
+    vector<ingest::Order> orders;
+    ingest::read_sections(
+        path,
+        [&](ingest::StationLine&& station) { station_lines.push_back(std::move(station)); },
+        [&](ingest::RouteLine&& route) { route_lines.push_back(std::move(route)); },
+        [](std::ifstream&) { return true; },
+        [&](ingest::Order&& order) { orders.push_back(std::move(order)); }
+    );
+    return build(std::move(station_lines), std::move(route_lines), std::move(orders));
+}
+
+shared_ptr<const Scenario> Scenario::build(
+    vector<ingest::StationLine> station_lines,
+    vector<ingest::RouteLine> route_lines,
+    vector<ingest::Order> orders
+) {
+    auto res = std::make_shared<Scenario>();
+    for (const auto& s: station_lines) {
+        res->stations[s.id] = Station { s.id, s.throughput, s.process_delay, s.cost };
+        res->routes.emplace(s.id, map<int, Route>());
+    }
+    int route_cnt = 0;
+    for (const auto& r: route_lines) {
+        route_cnt += 1;
+        res->routes.at(r.src).emplace(route_cnt, Route { route_cnt, r.src, r.dst, r.time, r.cost });
+    }
+    res->topology = std::make_shared<const topology::Topology>(res->stations, res->routes);
+    res->topology->prune(res->routes);
+    res->station_lines = std::move(station_lines);
+    res->route_lines = std::move(route_lines);
+    res->orders = std::move(orders);
+    return res;
+}
+
+shared_ptr<const strategy::ch::ContractionHierarchy> Scenario::hierarchy() const {
+    std::call_once(this->hierarchy_once, [this] {
+        this->built_hierarchy =
+            std::make_shared<const strategy::ch::ContractionHierarchy>(this->stations, this->routes);
+    });
+    return this->built_hierarchy;
+}
+
+shared_ptr<const strategy::alt::AltGraph> Scenario::alt_graph() const {
+    std::call_once(this->alt_graph_once, [this] {
+        this->built_alt_graph =
+            std::make_shared<const strategy::alt::AltGraph>(this->stations, this->routes);
+    });
+    return this->built_alt_graph;
+}
+
+shared_ptr<const strategy::dense::DenseGraph> Scenario::dense_graph() const {
+    std::call_once(this->dense_graph_once, [this] {
+        this->built_dense_graph =
+            std::make_shared<const strategy::dense::DenseGraph>(this->stations, this->routes);
+    });
+    return this->built_dense_graph;
+}
+
+shared_ptr<const strategy::delta::CsrGraph> Scenario::csr_graph() const {
+    std::call_once(this->csr_graph_once, [this] {
+        this->built_csr_graph =
+            std::make_shared<const strategy::delta::CsrGraph>(this->stations, this->routes);
+    });
+    return this->built_csr_graph;
+}
+
+} // namespace scenario
@@ -0,0 +1,70 @@
+#ifndef SCENARIO_HPP
+#define SCENARIO_HPP
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "base.hpp"
+#include "ingest.hpp"
+#include "strategy/alt.hpp"
+#include "strategy/ch.hpp"
+#include "strategy/delta.hpp"
+#include "strategy/dense.hpp"
+#include "topology.hpp"
+
+namespace scenario {
+using std::map;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+
+using base::Route;
+using base::Station;
+
+// 一份数据的不可变部分：站点、路线、订单，以及只依赖拓扑的路由预处理（CH / ALT / 邻接矩阵 / CSR）
+// 建好后不再修改，多个模拟（可以在不同线程）通过 SimulationBase::load 共享同一份
+// 站点 buffer、包裹、事件队列等运行时状态仍由每个模拟自己持有
+struct Scenario {
+public:
+    // 均为文件中的顺序；第 i 条路线的编号是 i + 1，与 add_route 一致
+    vector<ingest::StationLine> station_lines;
+    vector<ingest::RouteLine> route_lines;
+    vector<ingest::Order> orders;
+
+    // 与 SimulationBase 中格式相同的静态拓扑，buffer 为空，已删去被支配的路线
+    map<string, Station> stations;
+    map<string, map<int, Route>> routes;
+    // 被支配的路线与可达性，载入的模拟直接取用
+    shared_ptr<const topology::Topology> topology;
+
+public:
+    // 解析一次数据文件；文件不存在时返回空场景
+    static shared_ptr<const Scenario> read(const string& path);
+    static shared_ptr<const Scenario> build(
+        vector<ingest::StationLine> station_lines,
+        vector<ingest::RouteLine> route_lines,
+        vector<ingest::Order> orders
+    );
+
+    // 第一次调用时建立，之后所有共享者拿到同一份；线程安全
+    shared_ptr<const strategy::ch::ContractionHierarchy> hierarchy() const;
+    shared_ptr<const strategy::alt::AltGraph> alt_graph() const;
+    shared_ptr<const strategy::dense::DenseGraph> dense_graph() const;
+    shared_ptr<const strategy::delta::CsrGraph> csr_graph() const;
+
+private:
+    mutable std::once_flag hierarchy_once;
+    mutable std::once_flag alt_graph_once;
+    mutable std::once_flag dense_graph_once;
+    mutable std::once_flag csr_graph_once;
+    mutable shared_ptr<const strategy::ch::ContractionHierarchy> built_hierarchy;
+    mutable shared_ptr<const strategy::alt::AltGraph> built_alt_graph;
+    mutable shared_ptr<const strategy::dense::DenseGraph> built_dense_graph;
+    mutable shared_ptr<const strategy::delta::CsrGraph> built_csr_graph;
+};
+
+} // namespace scenario
+#endif
@@ -1,26 +1,187 @@
 #include "sim.hpp"
 
+#include <limits>
+#include <typeinfo>
+
 #include "strategy/v1.hpp"
 #include "strategy/v2.hpp"
+#include "strategy/v3.hpp"
 
 namespace sim {
 
-using strategy::v1::V1Arrival;
+using strategy::v1::V1BPolicy;
+using strategy::v1::V1Policy;
+using strategy::v2::V2BPolicy;
+using strategy::v2::V2Policy;
+using strategy::v3::V3Policy;
+
+// 登记创建时间不晚于下一个事件的订单，队列空时登记下一个订单
+void SimulationBase::admit_orders() {
+    if (this->order_stream == nullptr) {
+        return;
+    }
+    while (const ingest::Order* order = this->order_stream->peek()) {
+        if (!this->event_queue.empty()) {
+            const Event* next = this->event_queue.top();
+            const bool later = this->by_tick ? event::to_tick(order->time) > next->tick
+                                             : order->time > next->time;
+            if (later) {
+                return;
+            }
+        }
+        this->add_order(order->id, order->time, order->ctg, order->src, order->dst);
+        this->order_stream->pop();
+    }
+    log::ecargo(
+        "Ingest",
+        "{} orders streamed, simulation waited for the parser {} times",
+        this->order_stream->consumed,
+        this->order_stream->stalls
+    );
+    if (this->order_stream->out_of_order > 0) {
+        logs_cargo(
+            "Error",
+            "{} orders were created earlier than the order before them, pipelined ingestion "
+            "needs packets sorted by time",
+            this->order_stream->out_of_order
+        );
+    }
+    this->order_stream.reset();
+}
+
+void SimulationBase::verify_graph() {
+    PROFILE_SCOPE("verify_graph");
+    // 共享场景的路线建立时已经删去被支配的路线
+    if (this->source != nullptr) {
+        this->topology = this->source->topology;
+    } else {
+        this->topology =
+            std::make_shared<const topology::Topology>(this->stations, this->own_routes);
+        this->topology->prune(this->own_routes);
+    }
+    this->topology->log_stats();
+}
+
+bool SimulationBase::admissible(
+    const string& id,
+    double time,
+    PackageCategory ctg,
+    const string& src,
+    const string& dst
+) {
+    if (this->topology == nullptr || this->topology->reachable(src, dst)) {
+        return true;
+    }
+    logs_cargo("Error", "order {} quarantined: station {} is unreachable from {}", id, dst, src);
+    this->quarantined.push_back(ingest::Order { id, time, ctg, src, dst });
+    return false;
+}
+
+void SimulationBase::enable_ticks() {
+    if (this->by_tick) {
+        return;
+    }
+    this->by_tick = true;
+    decltype(this->event_queue) queue { EventComparator { true } };
+    for (; !this->event_queue.empty(); this->event_queue.pop()) {
+        queue.push(this->event_queue.top());
+    }
+    std::swap(this->event_queue, queue);
+}
+
+void SimulationBase::enable_speculation(int threads, int min_batch) {
+    this->enable_ticks();
+    this->workers = std::make_unique<pool::WorkerPool>(threads);
+    this->speculation_min_batch = min_batch;
+}
+
+void SimulationBase::speculate(const vector<Event*>& batch) {
+    vector<Event*> todo;
+    for (Event* event: batch) {
+        if (event->speculative()) {
+            todo.push_back(event);
+        }
+    }
+    // 任务太少时唤醒线程的开销比省下的计算多，留给 process_event 自己算
+    if ((int)todo.size() < this->speculation_min_batch) {
+        return;
+    }
+    this->workers->parallel_for(todo.size(), [&](size_t i) { todo[i]->speculate(); });
+}
+
+void SimulationBase::pop_batch(vector<Event*>& batch) {
+    assert(this->by_tick);
+    batch.clear();
+    const int64_t tick = this->event_queue.top()->tick;
+    while (!this->event_queue.empty() && this->event_queue.top()->tick == tick) {
+        batch.push_back(this->event_queue.top());
+        this->event_queue.pop();
+    }
+}
+
+void SimulationBase::begin() {
+    if (this->started) {
+        return;
+    }
+    this->started = true;
+    if (this->write_csv) {
+        this->occupancy_csv.open("number_package_in_station.csv", std::ios::trunc);
+        this->trip_csv.open("package_trip.csv", std::ios::trunc);
+    }
+}
 
-void Simulation::run() {
-    std::ofstream num_p("number_package_in_station.csv", std::ios::trunc);
-    num_p.clear();
-    std::ofstream package_trip("package_trip.csv", std::ios::trunc);
-    package_trip.clear();
+void SimulationBase::report(double time) {
+    if (this->on_progress == nullptr) {
+        return;
+    }
+    for (double at = (this->reported + 1) * this->report_interval; at <= time;
+         at = (this->reported + 1) * this->report_interval)
+    {
+        this->reported += 1;
+        this->on_progress(Progress {
+            at,
+            this->event_cnt,
+            this->arrived,
+            this->transport_cost,
+            this->stations,
+        });
+    }
+}
 
-    // chrono
+int SimulationBase::advance(double until, int max_events) {
+    this->begin();
     auto start_time = std::chrono::high_resolution_clock::now();
-    while (!this->event_queue.empty()) {
+    int processed = 0;
+    while (processed < max_events) {
+        if (this->batch_pos == this->batch.size()) {
+            this->admit_orders();
+            if (this->event_queue.empty() || this->event_queue.top()->time > until) {
+                break;
+            }
+            if (this->by_tick) {
+                this->pop_batch(this->batch);
+                this->batch_cnt += 1;
+                if (this->workers != nullptr) {
+                    this->speculate(this->batch);
+                }
+            } else {
+                this->batch.assign(1, this->event_queue.top());
+                this->event_queue.pop();
+            }
+            this->batch_pos = 0;
+        }
+        Event* event = this->batch[this->batch_pos++];
+        this->report(event->time);
         this->event_cnt += 1;
-        Event* event = this->event_queue.top();
-        this->event_queue.pop();
+        processed += 1;
         this->current_time = event->time;
-        event->process_event();
+        {
+            PROFILE_TYPE_SCOPE(typeid(*event));
+            event->process_event();
+        }
+        if (this->trace != nullptr) {
+            this->trace->event(event->time, typeid(*event));
+        }
 
         // cout << "arrived: " << this->arrived << ", "; // "arrived: 1\n"
         // cout << "time cost: " << this->total_time << "\n";
@@ -28,28 +189,84 @@ void Simulation::run() {
         logs("arrived: {}, money cost: {}", this->arrived, this->transport_cost);
         delete event;
     }
-    auto spent_run_time = std::chrono::high_resolution_clock::now() - start_time;
-    log::ecargo(
-        "Run",
-        "{}ms spent for simulation",
-        std::chrono::duration<double, std::milli>(spent_run_time).count()
-    );
+    this->spent += std::chrono::high_resolution_clock::now() - start_time;
+    if (this->batch_pos == this->batch.size()) {
+        this->admit_orders();
+        if (this->event_queue.empty()) {
+            this->finish();
+        }
+    }
+    return processed;
 }
 
-void Simulation::add_order(string id, double time, PackageCategory ctg, string src, string dst) {
-    // this->id_cnt += 1;
-    // string id = std::to_string(this->id_cnt);
-    this->packages[id] = Package { id, ctg, time, src, dst, false, -10086 };
-    if (this->strategy_version == StrategyVersion::V1
-        || this->strategy_version == StrategyVersion::V1B)
-    {
-        this->schedule_event(new V1Arrival(time, *this, id, src));
-    } else if (this->strategy_version == StrategyVersion::V2
-               || this->strategy_version == StrategyVersion::V2B)
-    {
-        this->schedule_event(new strategy::v2::V2Arrival(time, *this, id, src, true));
-    } else if (this->strategy_version == StrategyVersion::V3) {
-        this->schedule_event(new strategy::v3::V3Arrival(time, *this, id, src, true));
+void SimulationBase::finish() {
+    if (this->finished) {
+        return;
+    }
+    this->finished = true;
+    if (this->journal != nullptr) {
+        this->journal->finish(this->transport_cost);
+    }
+    if (this->trace != nullptr) {
+        this->trace->close();
+    }
+    if (this->write_csv) {
+        this->occupancy_csv.close();
+        this->trip_csv.close();
+    }
+    if (this->workers != nullptr) {
+        log::ecargo(
+            "Speculate",
+            "{} events computed ahead on {} threads were checked, {} reused",
+            this->speculated,
+            this->workers->size(),
+            this->speculation_hits
+        );
+    }
+    log::ecargo("Run", "{}ms spent for simulation", this->spent.count());
+}
+
+SimulationBase::~SimulationBase() {
+    for (size_t i = this->batch_pos; i < this->batch.size(); i++) {
+        delete this->batch[i];
+    }
+    while (!this->event_queue.empty()) {
+        delete this->event_queue.top();
+        this->event_queue.pop();
+    }
+}
+
+void SimulationBase::run() {
+    this->advance(std::numeric_limits<double>::infinity(), std::numeric_limits<int>::max());
+}
+
+bool SimulationBase::run_until(double time) {
+    this->advance(time, std::numeric_limits<int>::max());
+    return !this->finished;
+}
+
+int SimulationBase::step(int n) {
+    return this->advance(std::numeric_limits<double>::infinity(), n);
+}
+
+AnySimulation::AnySimulation(StrategyVersion strategy_version, EvaluateVersion evaluate_version):
+    strategy_version(strategy_version) {
+    switch (strategy_version) {
+        case StrategyVersion::V1:
+            this->sim = std::make_unique<Simulation<V1Policy>>(evaluate_version);
+            break;
+        case StrategyVersion::V1B:
+            this->sim = std::make_unique<Simulation<V1BPolicy>>(evaluate_version);
+            break;
+        case StrategyVersion::V2:
+            this->sim = std::make_unique<Simulation<V2Policy>>(evaluate_version);
+            break;
+        case StrategyVersion::V2B:
+            this->sim = std::make_unique<Simulation<V2BPolicy>>(evaluate_version);
+            break;
+        case StrategyVersion::V3:
+            this->sim = std::make_unique<Simulation<V3Policy>>(evaluate_version);
+            break;
     }
 }
 
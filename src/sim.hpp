@@ -4,8 +4,12 @@
 #include <cassert>
 #include <chrono>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <iterator>
 #include <map>
+#include <memory>
+#include <memory_resource>
 #include <queue>
 #include <set>
 #include <sstream>
@@ -17,13 +21,20 @@
 #include "base.hpp"
 #include "eval.hpp"
 #include "event.hpp"
+#include "ingest.hpp"
+#include "journal.hpp"
 #include "log.hpp"
+#include "pool.hpp"
+#include "profile.hpp"
 #include "rust.hpp"
+#include "scenario.hpp"
 #include "strategy.hpp"
+#include "strategy/replay.hpp"
 #include "strategy/v1.hpp"
 #include "strategy/v2.hpp"
 #include "strategy/v3.hpp"
-// #include "strategy/v2.hpp"
+#include "topology.hpp"
+#include "trace.hpp"
 
 namespace sim {
 
@@ -45,6 +56,7 @@ using log::logs;
 using log::logs_cargo;
 
 using base::Package;
+using base::Packages;
 using base::PackageCategory;
 using base::Route;
 using base::Station;
@@ -58,73 +70,235 @@ using strategy::dijkstra;
 using strategy::dijkstra_enhanced;
 using strategy::StrategyVersion;
 
-struct Simulation {
+// on_interval 回调看到的只读视图，只在回调期间有效
+struct Progress {
+    double time; // interval 的整数倍；早于 time 的事件都已处理，其余都未处理
+    int event_cnt;
+    int arrived;
+    double transport_cost; // 目前为止的运输成本，不含与时间有关的代价
+    const map<string, Station>& stations; // buffer.size() 即各站点的占用
+};
+
+// 与策略无关的模拟世界：事件队列、站点、路线、包裹
+struct SimulationBase {
 private:
-    double current_time; // current time
+    // 站点 buffer 与 packages 的节点都从这里分配，模拟结束时整块归还，不逐个还给系统堆
+    // 只在模拟线程上使用：推测执行的线程不改动 buffer 与 packages
+    // 须在 stations、packages 之前声明，最后析构
+    std::pmr::unsynchronized_pool_resource arena;
+    double current_time = 0; // current time
     std::priority_queue<Event*, std::vector<Event*, std::allocator<Event*>>, EventComparator>
         event_queue;
+    // 已入队的事件数，作为下一个事件的 seq
+    uint64_t scheduled = 0;
+    bool by_tick = false;
     int arrived = 0;
     int route_cnt = 0;
     double transport_cost = 0;
 
+    // 包裹退役：送达后代价折算进各 EvaluateVersion 的累计值，行程写入文件，再从 packages 删除
+    bool retire_finished = false;
+    std::ofstream retired_trip;
+    double retired_cost[std::size(EVALUATE_FUNC_MAP)] = {};
+
+    std::unique_ptr<journal::Writer> journal;
+    std::unique_ptr<trace::Writer> trace;
+    std::unique_ptr<trace::Columns> columns;
+    // run 期间打开的 number_package_in_station.csv 与 package_trip.csv
+    bool write_csv = true;
+    std::ofstream occupancy_csv;
+    std::ofstream trip_csv;
+    // 流水线读入时尚未登记的订单
+    std::unique_ptr<ingest::OrderStream> order_stream;
+    // load 载入的共享场景
+    std::shared_ptr<const scenario::Scenario> source;
+    // add_route 建立的路线；load 之后改用共享场景中的路线，本次模拟不再另建
+    map<string, map<int, Route>> own_routes;
+    const map<string, map<int, Route>>* route_table = &this->own_routes;
+    // verify_graph 之后才有，之后登记的订单先检查终点是否可达
+    std::shared_ptr<const topology::Topology> topology;
+    // 推测执行同一 tick 事件的线程池
+    std::unique_ptr<pool::WorkerPool> workers;
+    // 一批中可推测执行的事件不少于这么多时才交给线程池
+    int speculation_min_batch = 4;
+
+    // run_until / step 之间保留的游标：当前一批事件与下一个要处理的位置
+    vector<Event*> batch;
+    size_t batch_pos = 0;
+    bool started = false;
+    bool finished = false;
+    std::chrono::duration<double, std::milli> spent { 0 };
+    // on_interval：下一次回调是第 reported + 1 个 interval
+    double report_interval = 0;
+    int64_t reported = 0;
+    std::function<void(const Progress&)> on_progress;
+
+    void admit_orders();
+    void speculate(const vector<Event*>& batch);
+    // 第一次推进前打开 CSV
+    void begin();
+    // 事件处理完后关闭文件、输出统计，只做一次
+    void finish();
+    // 处理事件，直到下一个事件晚于 until 或已处理 max_events 个；返回处理的事件数
+    int advance(double until, int max_events);
+    void report(double time);
+
 public:
     int event_cnt = 0;
+    // tick 模式下处理过的时刻数
+    int batch_cnt = 0;
+    // 推测执行：处理时带有预算结果的事件数，其中验证通过、直接使用的事件数
+    int speculated = 0;
+    int speculation_hits = 0;
 
 public:
+    // 参数与共享场景相同，buffer 与 start_process_ok_time 属于本次模拟
     map<string, Station> stations;
-    map<string, map<int, Route>> routes;
-    map<string, Package> packages;
+    Packages packages { &this->arena };
+    // 终点不可达、没有登记的订单
+    vector<ingest::Order> quarantined;
 
-    // map<string, map<string,
 public:
-    const StrategyVersion strategy_version = StrategyVersion::V1;
     const EvaluateVersion evaluate_version = EvaluateVersion::V0;
 
 public:
-    // strategy info
-    // any other ways?
-    // map<string, V2StationInfo> v2_station_info;
-    strategy::v2::V2Cache v2_cache;
-
-public:
-    Simulation() = default;
-    Simulation(StrategyVersion strategy_version, EvaluateVersion evaluate_version):
-        strategy_version(strategy_version),
-        evaluate_version(evaluate_version) {}
+    explicit SimulationBase(EvaluateVersion evaluate_version): evaluate_version(evaluate_version) {}
+    SimulationBase(const SimulationBase&) = delete;
+    SimulationBase& operator=(const SimulationBase&) = delete;
+    // 停在 run_until / step 中途时，释放队列与当前一批中还没有处理的事件
+    virtual ~SimulationBase();
 
+    // 运行到结束；之前用过 run_until / step 时从停下的地方继续
     void run();
+    // 处理所有不晚于 time 的事件，返回是否还有事件；tick 模式下同一 tick 的一批总是一起处理
+    bool run_until(double time);
+    // 最多处理 n 个事件，返回实际处理的个数；之后可以继续调用 step / run_until / run
+    int step(int n);
+    bool done() const {
+        return this->finished;
+    }
+    // 最近处理的事件的时间
+    double now() const {
+        return this->current_time;
+    }
+    // 模拟时间每经过 interval 回调一次 fn，在处理第一个不早于该时刻的事件之前
+    void on_interval(double interval, std::function<void(const Progress&)> fn) {
+        this->report_interval = interval;
+        this->reported = static_cast<int64_t>(this->current_time / interval);
+        this->on_progress = std::move(fn);
+    }
 
     void schedule_event(Event* event) {
+        event->tick = event::to_tick(event->time);
+        event->seq = this->scheduled++;
         this->event_queue.push(event);
     }
 
-    void
-    add_order(string id, double time, PackageCategory ctg, string src, string dst); // add station
+    // 定点时间模式：事件按 (tick, seq) 出队，run 每次取出同一 tick 的一批事件依次处理
+    // 可以在 read_data 之后、run 之前开启，已入队的事件会重新建堆
+    void enable_ticks();
+    // 取出下一个 tick 的全部事件，按 seq 排列；只在 tick 模式下使用
+    // 处理中新产生的同一 tick 的事件 seq 更大，会成为下一批，顺序与逐个出队一致
+    void pop_batch(vector<Event*>& batch);
+    // 推测执行（隐含 tick 模式）：每批事件处理前先在 threads 个额外线程上并发调用 speculate
+    // 之后仍按 seq 逐个处理，预算结果只在验证通过时使用，结果与不开启时完全一致
+    void enable_speculation(int threads, int min_batch = 4);
+
+    // 只在建图 / 读数据时调用，由具体策略决定如何登记
+    virtual void
+    add_order(string id, double time, PackageCategory ctg, string src, string dst) = 0;
+    virtual void add_station(string id, double throughput, double process_delay, double cost) = 0;
+
+    // 读完站点与路线、登记订单前调用：删去被支配的平行路线，求可达性并输出图的统计
+    // read_data 与 load 会自动调用；直接 add_route 建图时可以手动调用
+    void verify_graph();
+    // verify_graph 之前为 nullptr
+    const topology::Topology* graph_topology() const {
+        return this->topology.get();
+    }
+
+    // 开启后每次决策写入二进制日志，供 strategy::replay 重放
+    void enable_journal(const string& path) {
+        this->journal = std::make_unique<journal::Writer>(path);
+    }
+
+    // station 在 time 从 buffer 取出 package，start 开始处理，经 route 发出（-1 表示已到终点）
+    void record_decision(
+        double time,
+        double start,
+        const string& station,
+        const string& package,
+        int route
+    ) {
+        if (this->journal != nullptr) {
+            this->journal->decision(time, start, station, package, route);
+        }
+    }
+
+    // 开启后 occupancy / trip / 事件同时写入列式 trace，供 UI 按时间窗口或包裹读取
+    void enable_trace(const string& path, double chunk_span = 24) {
+        this->trace = std::make_unique<trace::Writer>(path, chunk_span);
+    }
+    // 开启后 occupancy / trip 同时按列记在内存中，站点、包裹按给出的顺序编号
+    void enable_columns(const vector<string>& stations, const vector<string>& packages) {
+        this->columns = std::make_unique<trace::Columns>(stations, packages);
+    }
+    const trace::Columns* recorded_columns() const {
+        return this->columns.get();
+    }
+    // 关闭后 run 不再写 number_package_in_station.csv 与 package_trip.csv
+    void disable_csv() {
+        this->write_csv = false;
+    }
 
     void add_transport_cost(double cost) {
         this->transport_cost += cost;
     }
-
-    void add_station(string id, double throughput, double process_delay, double cost) {
-        this->stations[id] = Station { id, throughput, process_delay, cost };
-        this->routes.emplace(id, map<int, Route>());
-
-        if (this->strategy_version == StrategyVersion::V2
-            || this->strategy_version == StrategyVersion::V2B
-            || this->strategy_version == StrategyVersion::V3)
-        {
-            this->v2_cache.station_plans.emplace(id, strategy::v2::StationPlan(id, *this));
-            this->v2_cache.station_info.emplace(id, strategy::v2::StationInfo());
+    // number_package_in_station.csv 的一次快照：每个站点一行 time,station,buffer size
+    void write_occupancy(double time) {
+        PROFILE_SCOPE("trace/occupancy");
+        for (const auto& [id, station]: this->stations) {
+            if (this->write_csv) {
+                this->occupancy_csv << time << "," << id << "," << station.buffer.size() << "\n";
+            }
+            if (this->trace != nullptr) {
+                this->trace->occupancy(time, id, station.buffer.size());
+            }
+            if (this->columns != nullptr) {
+                this->columns->occupancy(time, id, station.buffer.size());
+            }
+        }
+    }
+    // package_trip.csv 的一行：package 在 time 从 src 发往 dst（src == dst 表示到达或在终点处理）
+    void write_trip(double time, const string& package, const string& src, const string& dst) {
+        if (this->write_csv) {
+            this->trip_csv << time << "," << package << "," << src << "," << dst << "\n";
+        }
+        if (this->trace != nullptr) {
+            this->trace->trip(time, package, src, dst);
+        }
+        if (this->columns != nullptr) {
+            this->columns->trip(time, package, src, dst);
         }
     }
+
+    double total_transport_cost() const {
+        return this->transport_cost;
+    }
+
+    // 站点 -> 路线编号 -> 路线；建图之后只读
+    const map<string, map<int, Route>>& routes() const {
+        return *this->route_table;
+    }
     // add route
     void add_route(string src, string dst, double time, double cost) {
         // check src and dst exist
+        assert(this->source == nullptr);
         assert(this->stations.find(src) != this->stations.end());
         assert(this->stations.find(dst) != this->stations.end());
         this->route_cnt += 1;
         auto route = Route { this->route_cnt, src, dst, time, cost };
-        this->routes.at(src).emplace(this->route_cnt, route); // add key value
+        this->own_routes.at(src).emplace(this->route_cnt, route); // add key value
     }
     // arrive package
     void finish_order(string package, double time) {
@@ -138,75 +312,247 @@ public:
         this->arrived += 1;
         this->packages[package].finished = true;
         this->packages[package].time_finished = time;
+        if (this->retire_finished) {
+            this->retire(this->packages.find(package));
+        }
+    }
+
+    // 开启后送达的包裹从 packages 删去。一次读入时未到创建时间的订单也在 packages 中，
+    // 只有 read_data(path, true) 流水线读入时 packages 才只含在途包裹，内存与在途包裹数成正比
+    // 每个送达包裹写一行 id,category,src,dst,time_created,time_finished
+    void enable_retirement(const string& path = "package_finished.csv") {
+        this->retire_finished = true;
+        this->retired_trip.open(path, std::ios::trunc);
+        // 开启前已送达的包裹一并退役
+        for (auto it = this->packages.begin(); it != this->packages.end();) {
+            auto next = std::next(it);
+            if (it->second.finished) {
+                this->retire(it);
+            }
+            it = next;
+        }
     }
 
     // fuck c++
     double eval() {
-        return (*(EVALUATE_FUNC_MAP[static_cast<int>(this->evaluate_version)].second))(
-            this->transport_cost,
-            this->packages
-        );
+        PROFILE_SCOPE("eval");
+        const int version = static_cast<int>(this->evaluate_version);
+        return (*(EVALUATE_FUNC_MAP[version].second))(this->transport_cost, this->packages)
+            + this->retired_cost[version];
+    }
+    // 模拟与评估函数无关：跑一次，在 versions 下各求一次总代价，与分别 eval() 逐位一致
+    vector<double> eval_all(const vector<EvaluateVersion>& versions) const {
+        PROFILE_SCOPE("eval");
+        const eval::PackageColumns cols(this->packages);
+        vector<double> res;
+        for (EvaluateVersion v: versions) {
+            const int version = static_cast<int>(v);
+            res.push_back(
+                EVALUATE_FUNC_MAP[version].second->columns_cost(this->transport_cost, cols)
+                + this->retired_cost[version]
+            );
+        }
+        return res;
     }
 
-    void read_data(const string& path) {
-        std::ifstream file(path, std::ios::in);
-        if (file.is_open()) {
-            string line;
-            bool is_stations_section = false;
-            bool is_routes_section = false;
-            bool is_orders_section = false;
-            while (std::getline(file, line)) {
-                if (line == "stations:") {
-                    is_stations_section = true;
-                    is_routes_section = false;
-                    is_orders_section = false;
-                } else if (line == "edges:") {
-                    is_stations_section = false;
-                    is_routes_section = true;
-                    is_orders_section = false;
-                } else if (line == "packets:") {
-                    is_stations_section = false;
-                    is_routes_section = false;
-                    is_orders_section = true;
-                } else if (is_stations_section) {
-                    std::stringstream ss(line);
-                    string id;
-                    double throughput, time_process, cost;
-                    char p_l; // parenthesis left
-                    char c; // comma
-                    char p_r; // parenthesis right
-
-                    ss >> id >> c >> p_l >> throughput >> c >> time_process >> c >> cost >> p_r;
-                    this->add_station(id, throughput, time_process, cost);
-                } else if (is_routes_section) {
-                    std::stringstream ss(line);
-                    string src;
-                    string dst;
-                    double time_cost, money_cost;
-                    char c;
-
-                    ss >> src >> c >> dst >> c >> time_cost >> c >> money_cost;
-                    this->add_route(src, dst, time_cost, money_cost);
-                } else if (is_orders_section) {
-                    std::stringstream ss(line);
-                    double time;
-                    int ctg;
-                    string src;
-                    string dst;
-                    string id;
-                    char c;
-
-                    ss >> id >> c >> time >> c >> ctg >> c >> src >> c >> dst;
-                    if (ctg == 0)
-                        this->add_order(id, time, PackageCategory::STANDARD, src, dst);
-                    else
-                        this->add_order(id, time, PackageCategory::EXPRESS, src, dst);
+    // pipelined 为 true 时 packets 段交给解析线程，run 中边读边模拟（要求按创建时间排序）
+    // 返回文件是否打开
+    bool read_data(const string& path, bool pipelined = false) {
+        PROFILE_SCOPE("read_data");
+        return ingest::read_sections(
+            path,
+            [&](ingest::StationLine&& station) {
+                this->add_station(
+                    station.id,
+                    station.throughput,
+                    station.process_delay,
+                    station.cost
+                );
+            },
+            [&](ingest::RouteLine&& route) {
+                this->add_route(route.src, route.dst, route.time, route.cost);
+            },
+            [&](std::ifstream& file) {
+                this->verify_graph();
+                if (pipelined) {
+                    this->order_stream = std::make_unique<ingest::OrderStream>(std::move(file));
+                    return false;
                 }
+                return true;
+            },
+            [&](ingest::Order&& order) {
+                this->add_order(order.id, order.time, order.ctg, order.src, order.dst);
             }
-        } else {
-            std::cout << "File not found" << std::endl;
+        );
+    }
+
+    // 从共享场景建立本次模拟，不重新解析文件；只在空模拟上调用
+    // 路线、拓扑与 CH / ALT 等预处理直接与其他共享者共用；站点按场景中已建好的参数逐个登记，
+    // 只有 buffer、包裹、事件队列属于本次模拟
+    void load(std::shared_ptr<const scenario::Scenario> shared) {
+        PROFILE_SCOPE("load");
+        this->source = std::move(shared);
+        this->route_table = &this->source->routes;
+        for (const auto& [id, s]: this->source->stations) {
+            this->add_station(id, s.throughput, s.process_delay, s.cost);
+        }
+        this->verify_graph();
+        for (const auto& o: this->source->orders) {
+            this->add_order(o.id, o.time, o.ctg, o.src, o.dst);
+        }
+    }
+    // load 载入的场景，没有时为 nullptr
+    const scenario::Scenario* shared_scenario() const {
+        return this->source.get();
+    }
+    // 本次模拟的 arena，策略中随包裹增删的节点容器也可以从这里分配
+    std::pmr::memory_resource* resource() {
+        return &this->arena;
+    }
+
+protected:
+    // 登记站点时建立它的空路线表；load 之后共享场景中已经有了
+    void add_route_table(const string& station) {
+        if (this->source == nullptr) {
+            this->own_routes.emplace(station, map<int, Route>());
+        }
+    }
+    // verify_graph 之后终点不可达的订单记入 quarantined，返回 false
+    bool admissible(
+        const string& id,
+        double time,
+        PackageCategory ctg,
+        const string& src,
+        const string& dst
+    );
+
+private:
+    void retire(Packages::iterator it) {
+        const Package& pkg = it->second;
+        for (int i = 0; i < (int)std::size(EVALUATE_FUNC_MAP); i++) {
+            this->retired_cost[i] += EVALUATE_FUNC_MAP[i].second->package_cost(pkg);
+        }
+        this->retired_trip << pkg.id << ","
+                           << (pkg.category == PackageCategory::EXPRESS ? 1 : 0) << ","
+                           << pkg.src << "," << pkg.dst << "," << pkg.time_created << ","
+                           << pkg.time_finished << "\n";
+        this->packages.erase(it);
+    }
+};
+
+// 策略在编译期确定，事件处理直接调用 Policy 的选包与路径规划
+// Policy 持有该策略独有的状态（如 V2Cache）
+template<typename Policy>
+struct Simulation final: public SimulationBase {
+public:
+    Policy policy;
+
+public:
+    explicit Simulation(EvaluateVersion evaluate_version = EvaluateVersion::V0):
+        SimulationBase(evaluate_version) {}
+
+    void add_order(string id, double time, PackageCategory ctg, string src, string dst) override {
+        if (!this->admissible(id, time, ctg, src, dst)) {
+            return;
         }
+        this->packages[id] = Package { id, ctg, time, src, dst, false, -10086 };
+        this->policy.add_order(*this, id, time, src);
+    }
+
+    void add_station(string id, double throughput, double process_delay, double cost) override {
+        this->stations.insert_or_assign(
+            id,
+            Station { id, throughput, process_delay, cost, std::pmr::set<string>(this->resource()) }
+        );
+        this->add_route_table(id);
+        this->policy.add_station(*this, id);
+    }
+};
+
+// 运行时按 StrategyVersion 选择 Simulation<Policy>
+struct AnySimulation {
+public:
+    AnySimulation(): AnySimulation(StrategyVersion::V1, EvaluateVersion::V0) {}
+    AnySimulation(StrategyVersion strategy_version, EvaluateVersion evaluate_version);
+
+    void run() {
+        this->sim->run();
+    }
+    bool run_until(double time) {
+        return this->sim->run_until(time);
+    }
+    int step(int n) {
+        return this->sim->step(n);
+    }
+    bool done() const {
+        return this->sim->done();
+    }
+    double now() const {
+        return this->sim->now();
     }
+    void on_interval(double interval, std::function<void(const Progress&)> fn) {
+        this->sim->on_interval(interval, std::move(fn));
+    }
+    void add_order(string id, double time, PackageCategory ctg, string src, string dst) {
+        this->sim->add_order(id, time, ctg, src, dst);
+    }
+    void add_station(string id, double throughput, double process_delay, double cost) {
+        this->sim->add_station(id, throughput, process_delay, cost);
+    }
+    void add_route(string src, string dst, double time, double cost) {
+        this->sim->add_route(src, dst, time, cost);
+    }
+    bool read_data(const string& path, bool pipelined = false) {
+        return this->sim->read_data(path, pipelined);
+    }
+    void load(std::shared_ptr<const scenario::Scenario> shared) {
+        this->sim->load(std::move(shared));
+    }
+    void verify_graph() {
+        this->sim->verify_graph();
+    }
+    double eval() {
+        return this->sim->eval();
+    }
+    vector<double> eval_all(const vector<EvaluateVersion>& versions) const {
+        return this->sim->eval_all(versions);
+    }
+    void enable_retirement(const string& path = "package_finished.csv") {
+        this->sim->enable_retirement(path);
+    }
+    void enable_journal(const string& path) {
+        this->sim->enable_journal(path);
+    }
+    void enable_trace(const string& path, double chunk_span = 24) {
+        this->sim->enable_trace(path, chunk_span);
+    }
+    void enable_columns(const vector<string>& stations, const vector<string>& packages) {
+        this->sim->enable_columns(stations, packages);
+    }
+    void disable_csv() {
+        this->sim->disable_csv();
+    }
+    void enable_ticks() {
+        this->sim->enable_ticks();
+    }
+    void enable_speculation(int threads, int min_batch = 4) {
+        this->sim->enable_speculation(threads, min_batch);
+    }
+    int event_cnt() const {
+        return this->sim->event_cnt;
+    }
+    SimulationBase& base() {
+        return *this->sim;
+    }
+    const SimulationBase& base() const {
+        return *this->sim;
+    }
+
+public:
+    const StrategyVersion strategy_version;
+
+private:
+    std::unique_ptr<SimulationBase> sim;
 };
 
 } // namespace sim
@@ -1,6 +1,15 @@
 #include "doctest/doctest.h"
 
+#include <random>
+#include <set>
+
+#include "eval.hpp"
 #include "strategy.hpp"
+#include "pool.hpp"
+#include "strategy/alt.hpp"
+#include "strategy/delta.hpp"
+#include "strategy/dense.hpp"
+#include "strategy/v3.hpp"
 
 namespace strategy {
 
@@ -218,4 +227,444 @@ TEST_CASE("dijkstra-v1b-2") {
     }
 }
 
+TEST_CASE("dijkstra-ch") {
+    auto stations = map<string, Station> {
+        { "a", Station { "a", 1.0 / 6, 2 } }, { "b", Station { "b", 1.0 / 5, 2 } },
+        { "c", Station { "c", 1.0 / 4, 2 } }, { "d", Station { "d", 1.0 / 3, 2 } },
+        { "e", Station { "e", 1.0 / 2, 2 } },
+    };
+    map<string, map<int, Route>> routes;
+    routes["a"] = {
+        { 1, Route { 1, "a", "b", 1, 1 } },
+        { 7, Route { 7, "a", "b", 0.9, 1 } },
+        { 8, Route { 8, "a", "b", 2, 1 } },
+        { 2, Route { 2, "a", "c", 2, 1 } },
+    };
+    routes["b"] = {
+        { 3, Route { 3, "b", "c", 3, 1 } },
+        { 4, Route { 4, "b", "d", 4, 1 } },
+    };
+    routes["c"] = {
+        { 5, Route { 5, "c", "d", 5, 1 } },
+    };
+    routes["d"] = {
+        { 6, Route { 6, "d", "e", 6, 1 } },
+    };
+    ch::ContractionHierarchy hierarchy(stations, routes);
+    auto path = dijkstra(hierarchy, "a", "e");
+    auto ans = vector<int> { 7, 4, 6 };
+    CHECK(path == ans);
+
+    // b 满了，应绕开 b
+    for (int i = 1; i <= 100; i++) {
+        stations.at("b").buffer.emplace("omg" + std::to_string(i));
+    }
+    // CH 只有静态边权，满站不改变结果
+    CHECK(dijkstra(ch::ContractionHierarchy(stations, routes), "a", "e") == path);
+    path = dijkstra_enhanced(stations, routes, "a", "e");
+    ans = vector<int> { 2, 5, 6 };
+    CHECK(path == ans);
+    // 满站惩罚叠加在 CH 上
+    alt::AltGraph graph(stations, routes);
+    vector<bool> full(graph.size(), false);
+    full[graph.index_of("b")] = true;
+    CHECK(dijkstra_enhanced(hierarchy, graph, routes, "a", "e", full) == ans);
+    full[graph.index_of("b")] = false;
+    full[graph.index_of("e")] = true;
+    // 终点满时不必避开
+    path = dijkstra_enhanced(hierarchy, graph, routes, "a", "e", full);
+    CHECK(path == dijkstra(hierarchy, "a", "e"));
+
+    // 不可达：e 没有出边
+    CHECK(!hierarchy.query("e", "a").has_value());
+    CHECK(hierarchy.query(hierarchy.index_of("a"), hierarchy.index_of("a")) == vector<int>());
+}
+
+namespace {
+
+// 随机测试图：n 个站点连成环保证强连通，每 parallel 个站点在环上多一条平行路线（0 为不加），
+// 再加 extra 条随机路线；站点与路线的参数由 make_station(id) / make_route(rid, src, dst) 给出
+struct RandomGraph {
+    map<string, Station> stations;
+    map<string, map<int, Route>> routes;
+    int route_cnt = 0;
+
+    template<typename MakeStation, typename MakeRoute>
+    RandomGraph(
+        std::mt19937& rng,
+        int n,
+        int extra,
+        int parallel,
+        MakeStation make_station,
+        MakeRoute make_route
+    ) {
+        for (int i = 0; i < n; i++) {
+            const string id = "s" + std::to_string(i);
+            this->stations[id] = make_station(id);
+        }
+        auto add_route = [&](int u, int v) {
+            this->route_cnt += 1;
+            const string src = "s" + std::to_string(u);
+            this->routes[src][this->route_cnt] =
+                make_route(this->route_cnt, src, "s" + std::to_string(v));
+        };
+        for (int i = 0; i < n; i++) {
+            add_route(i, (i + 1) % n);
+            if (parallel > 0 && i % parallel == 0) {
+                add_route(i, (i + 1) % n);
+            }
+        }
+        for (int i = 0; i < extra; i++) {
+            add_route(rng() % n, rng() % n);
+        }
+    }
+
+    // 静态边权下的路径代价，与 dijkstra 的边权相同
+    double path_cost(const string& src, const vector<int>& path) const {
+        double cost = 0;
+        string at = src;
+        for (int r: path) {
+            const Route& route = this->routes.at(at).at(r);
+            cost += (route.time + this->stations.at(route.dst).process_delay) * 1.667
+                + (route.cost + this->stations.at(route.dst).cost);
+            at = route.dst;
+        }
+        return cost;
+    }
+};
+
+// 站点与路线参数均匀分布在 [0, 10) 上的随机图
+RandomGraph uniform_graph(std::mt19937& rng, int n, int extra) {
+    std::uniform_real_distribution<double> uni(0, 10);
+    return RandomGraph(
+        rng,
+        n,
+        extra,
+        0,
+        [&](const string& id) { return Station { id, 1, uni(rng) / 5, uni(rng) / 5 }; },
+        [&](int rid, const string& src, const string& dst) {
+            return Route { rid, src, dst, uni(rng), uni(rng) };
+        }
+    );
+}
+
+} // namespace
+
+// 随机图上与 dijkstra 的路径代价一致
+TEST_CASE("dijkstra-ch-random") {
+    std::mt19937 rng(2024);
+    const int n = 60;
+    const RandomGraph g = uniform_graph(rng, n, n * 3);
+    const auto& stations = g.stations;
+    const auto& routes = g.routes;
+    ch::ContractionHierarchy hierarchy(stations, routes);
+    for (int i = 0; i < n; i += 3) {
+        for (int j = 0; j < n; j += 2) {
+            if (i == j) {
+                continue;
+            }
+            const string src = "s" + std::to_string(i);
+            const string dst = "s" + std::to_string(j);
+            const double expected = g.path_cost(src, dijkstra(stations, routes, src, dst));
+            const double actual = g.path_cost(src, dijkstra(hierarchy, src, dst));
+            CHECK(std::abs(expected - actual) < 1e-6);
+        }
+    }
+}
+
+TEST_CASE("dijkstra-alt-random") {
+    std::mt19937 rng(2025);
+    const int n = 80;
+    const RandomGraph g = uniform_graph(rng, n, n * 3);
+    const auto& stations = g.stations;
+    const auto& routes = g.routes;
+    alt::AltGraph graph(stations, routes);
+    alt::AltGraph plain(stations, routes, 0); // 无 landmark 的 A* 即 dijkstra
+    int settled_alt = 0, settled_bi = 0, settled_plain = 0;
+    for (int i = 0; i < n; i += 3) {
+        for (int j = 0; j < n; j += 2) {
+            const string src = "s" + std::to_string(i);
+            const string dst = "s" + std::to_string(j);
+            const double expected = g.path_cost(src, dijkstra(stations, routes, src, dst));
+            int settled = 0;
+            auto forward = alt::astar(graph, src, dst, nullptr, &settled);
+            settled_alt += settled;
+            auto both = alt::bidirectional_dijkstra(graph, src, dst, nullptr, &settled);
+            settled_bi += settled;
+            CHECK(std::abs(expected - g.path_cost(src, forward.value())) < 1e-6);
+            CHECK(std::abs(expected - g.path_cost(src, both.value())) < 1e-6);
+            alt::astar(plain, src, dst, nullptr, &settled);
+            settled_plain += settled;
+        }
+    }
+    CHECK(settled_alt <= settled_plain);
+    CHECK(settled_bi <= settled_plain);
+
+    // 除起点外全部不可经过时，只剩直达路线
+    vector<bool> blocked(graph.size(), true);
+    for (const auto& [r, route]: routes.at("s0")) {
+        auto path = alt::astar(graph, "s0", route.dst, &blocked);
+        REQUIRE(path.has_value());
+        CHECK(path.value().size() <= 1);
+    }
+}
+
+TEST_CASE("dijkstra-penalized-random") {
+    std::mt19937 rng(2026);
+    const int n = 40;
+    RandomGraph g = uniform_graph(rng, n, n * 2);
+    auto& stations = g.stations;
+    const auto& routes = g.routes;
+    alt::AltGraph graph(stations, routes);
+    ch::ContractionHierarchy hierarchy(stations, routes);
+    // 路径代价，以及是否经过 dst 以外的满站
+    auto evaluate = [&](const string& src, const string& dst, const vector<int>& path) {
+        bool penalized = false;
+        string at = src;
+        for (int r: path) {
+            at = routes.at(at).at(r).dst;
+            penalized |= at != dst && stations.at(at).buffer.size() > FULL_STANDARD_COEFFICIENT;
+        }
+        CHECK(at == dst);
+        return std::make_pair(penalized, g.path_cost(src, path));
+    };
+    // 满站越来越多，直到大多数点对没有避开满站的路径
+    for (const int full_cnt: { 0, 4, 12, 30 }) {
+        vector<bool> full(n, false);
+        for (int k = 0; k < full_cnt; k++) {
+            full[rng() % n] = true;
+        }
+        for (int v = 0; v < n; v++) {
+            Station& station = stations.at(graph.name_of(v));
+            station.buffer.clear();
+            for (int k = 0; full[v] && k < 20; k++) {
+                station.buffer.insert("p" + std::to_string(k));
+            }
+        }
+        for (int i = 0; i < n; i += 3) {
+            for (int j = 1; j < n; j += 2) {
+                const string src = "s" + std::to_string(i);
+                const string dst = "s" + std::to_string(j);
+                // 原来的两次搜索：先避开满站，找不到再不限制
+                auto avoiding = alt::astar(graph, src, dst, &full);
+                const auto expected = evaluate(
+                    src,
+                    dst,
+                    avoiding.has_value() ? avoiding.value() : dijkstra(stations, routes, src, dst)
+                );
+                const auto single =
+                    evaluate(src, dst, dijkstra_enhanced(stations, routes, src, dst));
+                const auto dense =
+                    evaluate(src, dst, alt::penalized_dijkstra(graph, src, dst, full).value());
+                const auto overlay = evaluate(
+                    src,
+                    dst,
+                    dijkstra_enhanced(hierarchy, graph, routes, src, dst, full)
+                );
+                CHECK(expected.first == single.first);
+                CHECK(expected.first == dense.first);
+                CHECK(expected.first == overlay.first);
+                CHECK(std::abs(expected.second - single.second) < 1e-6);
+                CHECK(std::abs(expected.second - dense.second) < 1e-6);
+                CHECK(std::abs(expected.second - overlay.second) < 1e-6);
+            }
+        }
+    }
+}
+
+TEST_CASE("dense-tree-random") {
+    std::mt19937 rng(2027);
+    std::uniform_real_distribution<double> uni(0, 10);
+    // 不是 4 的倍数，补齐的列也参与松弛；平行路线放在第二层
+    const int n = 37;
+    RandomGraph g(
+        rng,
+        n,
+        n * 3,
+        3,
+        [&](const string& id) {
+            return Station { id, 0.5 + uni(rng) / 2, uni(rng) / 5, uni(rng) / 5 };
+        },
+        [&](int rid, const string& src, const string& dst) {
+            return Route { rid, src, dst, uni(rng), uni(rng) };
+        }
+    );
+    auto& stations = g.stations;
+    const auto& routes = g.routes;
+    const dense::DenseGraph graph(stations, routes);
+    CHECK(graph.stride == 40);
+    CHECK(graph.layers >= 2);
+    v2::V2Cache cache(stations);
+    int due_cnt = 0;
+    for (int round = 0; round < 3; round++) {
+        // 随机负载：覆盖空 buffer、处理冷却、due 包裹先到与后到的各个分支
+        for (auto& [id, station]: stations) {
+            station.buffer.clear();
+            const int size = rng() % 3 == 0 ? 0 : rng() % 30;
+            for (int k = 0; k < size; k++) {
+                station.buffer.insert("p" + std::to_string(k));
+            }
+            station.start_process_ok_time = uni(rng);
+        }
+        for (auto& [id, plan]: cache.station_plans) {
+            for (int k = rng() % 3; k > 0; k--) {
+                plan.add_due_pkg(uni(rng), "d" + std::to_string(due_cnt++));
+            }
+        }
+        for (int i = 0; i < n; i += 2) {
+            const string src = "s" + std::to_string(i);
+            const double start = uni(rng);
+            const auto expected =
+                v3::dijkstra_tree(stations, routes, src, start, cache.station_plans);
+            const auto dense = v3::dense_tree(graph, src, start, cache.station_plans);
+            CHECK(dense.prev == expected.prev);
+            CHECK(dense.start_send_time_at_min_cost == expected.start_send_time_at_min_cost);
+            for (const auto isa: { dense::Isa::SCALAR, dense::Isa::SSE2, dense::Isa::AVX2 }) {
+                if (!dense::supported(isa)) {
+                    continue;
+                }
+                const dense::Tree tree = dense::wait_tree(
+                    graph,
+                    graph.index_of(src),
+                    start,
+                    cache.station_plans,
+                    1.0,
+                    1.667,
+                    isa
+                );
+                bool same = true;
+                for (int v = 0; v < n; v++) {
+                    const string& id = graph.name_of(v);
+                    auto it = expected.prev.find(id);
+                    same &= tree.start_send[v] == expected.start_send_time_at_min_cost.at(id);
+                    same &= (it == expected.prev.end()) == (tree.prev[v] == -1);
+                    same &= it == expected.prev.end()
+                        || (it->second.first == graph.name_of(tree.prev[v])
+                            && it->second.second == tree.route[v]);
+                }
+                CHECK(same);
+            }
+        }
+    }
+}
+
+TEST_CASE("delta-tree-random") {
+    std::mt19937 rng(2028);
+    std::uniform_real_distribution<double> uni(0, 10);
+    const int n = 600;
+    // 整数的耗时与费用在 tc = 1 时会有大量代价相同的路径，检查与 dijkstra 的取舍一致
+    RandomGraph g(
+        rng,
+        n,
+        n * 4,
+        5,
+        [&](const string& id) {
+            return Station { id, 0.5 + uni(rng) / 2, 1.0 + rng() % 2, (double)(rng() % 2) };
+        },
+        [&](int rid, const string& src, const string& dst) {
+            return Route { rid, src, dst, 1.0 + rng() % 4, (double)(rng() % 3) };
+        }
+    );
+    auto& stations = g.stations;
+    const auto& routes = g.routes;
+    const delta::CsrGraph graph(stations, routes);
+    CHECK(graph.first.back() == g.route_cnt);
+    v2::V2Cache cache(stations);
+    pool::WorkerPool workers(3);
+    int due_cnt = 0;
+    for (int round = 0; round < 2; round++) {
+        for (auto& [id, station]: stations) {
+            station.buffer.clear();
+            const int size = rng() % 3 == 0 ? 0 : rng() % 30;
+            for (int k = 0; k < size; k++) {
+                station.buffer.insert("p" + std::to_string(k));
+            }
+            station.start_process_ok_time = uni(rng);
+        }
+        for (auto& [id, plan]: cache.station_plans) {
+            for (int k = rng() % 3; k > 0; k--) {
+                plan.add_due_pkg(uni(rng), "d" + std::to_string(due_cnt++));
+            }
+        }
+        for (int i = 0; i < n; i += 37) {
+            const string src = "s" + std::to_string(i);
+            const double start = uni(rng);
+            for (const double tc: { 1.0, 1.667 }) {
+                const auto expected =
+                    v3::dijkstra_tree(stations, routes, src, start, cache.station_plans, 1.0, tc);
+                for (pool::WorkerPool* pool: { (pool::WorkerPool*)nullptr, &workers }) {
+                    const auto res = v3::delta_tree(
+                        graph,
+                        src,
+                        start,
+                        cache.station_plans,
+                        pool,
+                        nullptr,
+                        1.0,
+                        tc
+                    );
+                    CHECK(res.prev == expected.prev);
+                    CHECK(res.start_send_time_at_min_cost == expected.start_send_time_at_min_cost);
+                }
+            }
+        }
+    }
+    // 桶宽取有限下界的中位数
+    const double inf = std::numeric_limits<double>::infinity();
+    CHECK(delta::bucket_width({ 3, inf, 1, 2, inf }) == 2);
+    CHECK(delta::bucket_width({ inf }) == 1);
+}
+
+TEST_CASE("buffer-index-random") {
+    // 任意顺序增删，含删除后再加入；与按 id 存放的参照逐项比较组头与聚合值
+    std::mt19937 rng(2029);
+    std::uniform_real_distribution<double> uni(0, 10);
+    map<string, Package> packages;
+    for (int i = 0; i < 200; i++) {
+        const string id = "p" + std::to_string(i);
+        packages[id] = Package {
+            id,
+            rng() % 3 == 0 ? PackageCategory::EXPRESS : PackageCategory::STANDARD,
+            uni(rng),
+            "s0",
+            "s" + std::to_string(rng() % 3),
+        };
+    }
+    v3::BufferIndex index;
+    std::set<string> present;
+    bool same = true;
+    for (int step = 0; step < 5000; step++) {
+        const string id = "p" + std::to_string(rng() % packages.size());
+        if (present.count(id) != 0) {
+            index.remove(packages.at(id));
+            present.erase(id);
+        } else {
+            index.add(packages.at(id));
+            present.insert(id);
+        }
+        map<string, int> size, express;
+        map<string, double> earliest;
+        map<string, pair<double, string>> head;
+        for (const auto& p: present) {
+            const Package& pkg = packages.at(p);
+            const double ddl = pkg.time_created
+                + (pkg.category == PackageCategory::EXPRESS ? eval::V1_EXPRESS_DDL_HOURS
+                                                            : eval::V1_STANDARD_DDL_HOURS);
+            head.emplace(pkg.dst, make_pair(ddl, p));
+            head[pkg.dst] = std::min(head[pkg.dst], make_pair(ddl, p));
+            size[pkg.dst] += 1;
+            express[pkg.dst] += pkg.category == PackageCategory::EXPRESS;
+            earliest.emplace(pkg.dst, pkg.time_created);
+            earliest[pkg.dst] = std::min(earliest[pkg.dst], pkg.time_created);
+        }
+        same &= index.groups.size() == size.size();
+        for (const auto& [dst, group]: index.groups) {
+            same &= group.size == size[dst] && group.express_cnt(packages) == express[dst];
+            same &= group.earliest_created(packages) == earliest[dst];
+            same &= group.head() == head[dst];
+        }
+    }
+    CHECK(same);
+}
+
 } // namespace strategy
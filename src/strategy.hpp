@@ -2,12 +2,18 @@
 #define STRATEGY_HPP
 
 #include <map>
+#include <memory_resource>
 #include <queue>
+#include <tuple>
 #include <utility>
 #include <vector>
 
+#include "arena.hpp"
 #include "base.hpp"
 #include "log.hpp"
+#include "profile.hpp"
+#include "strategy/alt.hpp"
+#include "strategy/ch.hpp"
 
 namespace strategy {
 using namespace base;
@@ -28,6 +34,25 @@ enum struct StrategyVersion {
     V3,
 };
 
+// 点对点路径规划的搜索方式，由各策略的 Policy 选择
+enum struct RouteSearch {
+    DIJKSTRA, // 全图 dijkstra
+    CH, // contraction hierarchy，仅静态边权
+    ALT, // landmark 下界的 A*
+    BIDIRECTIONAL, // 双向 dijkstra，仅静态边权
+};
+
+// buffer 超过 throughput 的多少倍视为满站
+constexpr double FULL_STANDARD_COEFFICIENT = 19;
+
+// u 的出边，没有时为空；返回引用，搜索时不必复制
+inline const map<int, Route>&
+out_routes(const map<string, map<int, Route>>& routes, const string& u) {
+    static const map<int, Route> none;
+    auto it = routes.find(u);
+    return it == routes.end() ? none : it->second;
+}
+
 // 使用堆优化 dijkstra 求解时间最短路，返回最短路整条路径 id vector
 // routes[x] is all routes of x
 // routes[x][rid] is route of x
@@ -40,8 +65,11 @@ inline vector<int> dijkstra(
     const double time_coefficient = 1.667
 ) {
     logs_cargo("Info", "dijkstra called");
-    map<string, double> dist;
-    map<string, pair<string, int>> prev; // nodes' prev station and route
+    PROFILE_SCOPE("route/dijkstra");
+    arena::Scope scope;
+    std::pmr::map<string, double> dist(arena::scratch());
+    // nodes' prev station and route
+    std::pmr::map<string, pair<string, int>> prev(arena::scratch());
     for (const auto& [id, station]: stations) {
         dist[id] = std::numeric_limits<double>::max();
     }
@@ -49,9 +77,9 @@ inline vector<int> dijkstra(
     // priority_queue<pair<double, string>> q;
     priority_queue<
         pair<double, string>,
-        vector<pair<double, string>>,
+        std::pmr::vector<pair<double, string>>,
         greater<pair<double, string>>>
-        q;
+        q(arena::scratch());
 
     q.push(make_pair(0, src));
     while (!q.empty()) {
@@ -61,7 +89,7 @@ inline vector<int> dijkstra(
             continue;
         }
         // if not found, edges is empty
-        auto edges = routes.find(u) == routes.end() ? map<int, Route> {} : routes.at(u);
+        const auto& edges = out_routes(routes, u);
         for (const auto& route: edges) {
             // cout << "  route: " << route.src << " => " << route.dst << "\n";
             string v = route.second.dst;
@@ -95,6 +123,11 @@ inline vector<int> dijkstra(
     return path;
 }
 
+// 满站（终点除外）作为字典序惩罚：先比较路径是否经过满站，再比较代价
+// 存在避开满站的路径时取其中最短的，否则取不限制的最短路，一次搜索完成
+// 状态为 (是否已经过满站, 站点)，未经过满站的状态总是先出堆
+// 每次调用都扫描全部站点判定满站，只作测试与 bench 的参照实现；
+// V1B 用 alt::penalized_dijkstra 与随 buffer 变化维护的满站标记
 inline vector<int> dijkstra_enhanced(
     const map<string, Station>& stations,
     const map<string, map<int, Route>>& routes,
@@ -102,74 +135,107 @@ inline vector<int> dijkstra_enhanced(
     const string dst,
     const double money_coefficient = 1.0,
     const double time_coefficient = 1.667,
-    const double full_standard_coefficient = 19
+    const double full_standard_coefficient = FULL_STANDARD_COEFFICIENT
 ) {
     // called
     logs_cargo("Info", "dijkstra_enhanced called");
-    map<string, double> dist;
-    map<string, pair<string, int>> prev; // nodes' prev station and route
+    PROFILE_SCOPE("route/dijkstra_enhanced");
+    arena::Scope scope;
+    std::pmr::memory_resource* scratch = arena::scratch();
+    std::pmr::map<string, double> dist[2] = { std::pmr::map<string, double>(scratch),
+                                              std::pmr::map<string, double>(scratch) };
+    // nodes' prev station and route
+    std::pmr::map<string, pair<string, int>> prev[2] = {
+        std::pmr::map<string, pair<string, int>>(scratch),
+        std::pmr::map<string, pair<string, int>>(scratch),
+    };
+    std::pmr::map<string, int> prev_layer[2] = { std::pmr::map<string, int>(scratch),
+                                                 std::pmr::map<string, int>(scratch) };
+    std::pmr::map<string, bool> full(scratch);
     for (const auto& [id, station]: stations) {
-        dist[id] = std::numeric_limits<double>::max();
+        dist[0][id] = std::numeric_limits<double>::max();
+        dist[1][id] = std::numeric_limits<double>::max();
+        full[id] = id != dst
+            && station.buffer.size() > full_standard_coefficient * station.throughput;
     }
-    dist[src] = 0;
-    // priority_queue<pair<double, string>> q;
+    dist[0][src] = 0;
     priority_queue<
-        pair<double, string>,
-        vector<pair<double, string>>,
-        greater<pair<double, string>>>
-        q;
+        std::tuple<int, double, string>,
+        std::pmr::vector<std::tuple<int, double, string>>,
+        greater<std::tuple<int, double, string>>>
+        q(scratch);
 
-    q.push(make_pair(0, src));
+    q.push(std::make_tuple(0, 0, src));
+    int reached = -1; // dst 出堆时所在的层，-1 为不可达
     while (!q.empty()) {
-        auto [d, u] = q.top();
+        auto [penalized, d, u] = q.top();
         q.pop();
-        if (d > dist[u]) {
+        if (d > dist[penalized][u]) {
             continue;
         }
+        if (u == dst) {
+            reached = penalized;
+            break;
+        }
         // if not found, edges is empty
-        auto edges = routes.find(u) == routes.end() ? map<int, Route> {} : routes.at(u);
+        const auto& edges = out_routes(routes, u);
         for (const auto& route: edges) {
             string v = route.second.dst;
             double w = (route.second.time + stations.at(v).process_delay) * time_coefficient
                 + (route.second.cost + stations.at(route.second.dst).cost) * money_coefficient;
-
-            bool station_full = false;
-
-            if (stations.find(v) != stations.end()
-                && stations.at(v).buffer.size()
-                    > full_standard_coefficient * stations.at(v).throughput
-                && v != dst)
-            {
-                station_full = true;
-            }
-
-            if (dist[u] + w < dist[v] && !station_full) {
-                // cout << "    update dist: " << dist[u] + w << "\n";
-                dist[v] = dist[u] + w;
-                prev[v] = { u, route.first };
-                // cout << "    prev: " << prev[v] << "\n";
-                q.push(make_pair(dist[v], v));
+            const int layer = penalized || full.at(v) ? 1 : 0;
+            if (dist[penalized][u] + w < dist[layer][v]) {
+                dist[layer][v] = dist[penalized][u] + w;
+                prev[layer][v] = { u, route.first };
+                prev_layer[layer][v] = penalized;
+                q.push(std::make_tuple(layer, dist[layer][v], v));
             }
         }
     }
-    // if failed
-    if (prev.find(dst) == prev.end()) {
-        return dijkstra(stations, routes, src, dst);
-    }
 
     vector<int> path;
-    // for (string at = dst; at != ""; at = prev[at]) {
-    //     path.push_back(at);
-    // }
-    for (string at = dst; at != src;) {
-        auto [from, route] = prev[at];
-        // logs("from: {}, route: {}", from, route);
+    // 经过满站后再回到 src 的状态在第 1 层，只有第 0 层的 src 是起点
+    for (string at = dst; reached != -1 && (at != src || reached != 0);) {
+        auto [from, route] = prev[reached][at];
         path.push_back(route);
+        reached = prev_layer[reached][at];
         at = from;
     }
     std::reverse(path.begin(), path.end());
     return path;
 }
 
+// 使用预处理好的 contraction hierarchy 查询，边权与上面的 dijkstra 相同
+inline vector<int>
+dijkstra(const ch::ContractionHierarchy& hierarchy, const string src, const string dst) {
+    logs_cargo("Info", "dijkstra called");
+    PROFILE_SCOPE("route/ch");
+    return hierarchy.query(src, dst).value();
+}
+
+// 满站惩罚叠加在 CH 上，结果代价与 dijkstra_enhanced 相同：
+// CH 的最短路不经过满站（dst 除外）时它就是避开满站的最短路，直接返回；否则回退到
+// alt::penalized_dijkstra。full 按 graph 下标
+inline vector<int> dijkstra_enhanced(
+    const ch::ContractionHierarchy& hierarchy,
+    const alt::AltGraph& graph,
+    const map<string, map<int, Route>>& routes,
+    const string& src,
+    const string& dst,
+    const vector<bool>& full
+) {
+    logs_cargo("Info", "dijkstra_enhanced called");
+    PROFILE_SCOPE("route/ch-penalized");
+    vector<int> path = hierarchy.query(src, dst).value();
+    string at = src;
+    for (int route: path) {
+        at = routes.at(at).at(route).dst;
+        if (at != dst && full[graph.index_of(at)]) {
+            return alt::penalized_dijkstra(graph, src, dst, full).value();
+        }
+    }
+    return path;
+}
+
 } // namespace strategy
 #endif
@@ -0,0 +1,309 @@
+#include "strategy/alt.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <memory_resource>
+#include <queue>
+#include <tuple>
+
+#include "arena.hpp"
+#include "profile.hpp"
+
+namespace strategy::alt {
+
+using std::greater;
+using std::make_pair;
+using std::priority_queue;
+
+constexpr double INF = std::numeric_limits<double>::max();
+
+// 单源全图 dijkstra，adj 为 out 时求 d(s, v)，为 in 时求 d(v, s)
+vector<double> full_dijkstra(const vector<vector<AltGraph::Arc>>& adj, int s) {
+    vector<double> dist(adj.size(), INF);
+    priority_queue<pair<double, int>, vector<pair<double, int>>, greater<>> q;
+    dist[s] = 0;
+    q.push(make_pair(0, s));
+    while (!q.empty()) {
+        auto [d, u] = q.top();
+        q.pop();
+        if (d > dist[u]) {
+            continue;
+        }
+        for (const auto& arc: adj[u]) {
+            if (d + arc.weight < dist[arc.to]) {
+                dist[arc.to] = d + arc.weight;
+                q.push(make_pair(dist[arc.to], arc.to));
+            }
+        }
+    }
+    return dist;
+}
+
+AltGraph::AltGraph(
+    const map<string, Station>& stations,
+    const map<string, map<int, Route>>& routes,
+    int landmark_cnt,
+    double money_coefficient,
+    double time_coefficient
+) {
+    for (const auto& [id, station]: stations) {
+        this->node_of[id] = this->names.size();
+        this->names.push_back(id);
+    }
+    const int n = this->names.size();
+    this->out.assign(n, {});
+    this->in.assign(n, {});
+    for (const auto& [src, edges]: routes) {
+        for (const auto& [rid, route]: edges) {
+            const Station& v = stations.at(route.dst);
+            const double w = (route.time + v.process_delay) * time_coefficient
+                + (route.cost + v.cost) * money_coefficient;
+            const int from = this->node_of.at(src);
+            const int to = this->node_of.at(route.dst);
+            this->out[from].push_back(Arc { to, rid, w });
+            this->in[to].push_back(Arc { from, rid, w });
+        }
+    }
+
+    // farthest 选点：每次取离已选 landmark 最远的点
+    vector<double> closest(n, INF);
+    int next = 0;
+    for (int k = 0; k < std::min(landmark_cnt, n); k++) {
+        this->landmarks.push_back(next);
+        this->from_landmark.push_back(full_dijkstra(this->out, next));
+        this->to_landmark.push_back(full_dijkstra(this->in, next));
+        for (int v = 0; v < n; v++) {
+            const double d = std::min(this->from_landmark.back()[v], this->to_landmark.back()[v]);
+            closest[v] = std::min(closest[v], d);
+        }
+        next = -1;
+        for (int v = 0; v < n; v++) {
+            if (closest[v] == INF || closest[v] == 0) {
+                continue;
+            }
+            if (next == -1 || closest[v] > closest[next]) {
+                next = v;
+            }
+        }
+        if (next == -1) {
+            break;
+        }
+    }
+}
+
+double AltGraph::lower_bound(int v, int t) const {
+    double bound = 0;
+    for (int k = 0; k < (int)this->landmarks.size(); k++) {
+        // d(L, t) <= d(L, v) + d(v, t)
+        const double lv = this->from_landmark[k][v];
+        const double lt = this->from_landmark[k][t];
+        if (lv != INF && lt != INF) {
+            bound = std::max(bound, lt - lv);
+        }
+        // d(v, L) <= d(v, t) + d(t, L)
+        const double vl = this->to_landmark[k][v];
+        const double tl = this->to_landmark[k][t];
+        if (vl != INF && tl != INF) {
+            bound = std::max(bound, vl - tl);
+        }
+    }
+    return bound;
+}
+
+optional<vector<int>> astar(
+    const AltGraph& graph,
+    const string& src,
+    const string& dst,
+    const vector<bool>* blocked,
+    int* settled
+) {
+    PROFILE_SCOPE("route/alt");
+    arena::Scope scope;
+    std::pmr::memory_resource* scratch = arena::scratch();
+    const int s = graph.index_of(src);
+    const int t = graph.index_of(dst);
+    const int n = graph.size();
+    std::pmr::vector<double> dist(n, INF, scratch);
+    // prev station and route
+    std::pmr::vector<pair<int, int>> prev(n, make_pair(-1, -1), scratch);
+    std::pmr::vector<double> h(n, -1, scratch);
+    auto heuristic = [&](int v) {
+        if (h[v] < 0) {
+            h[v] = graph.lower_bound(v, t);
+        }
+        return h[v];
+    };
+    priority_queue<pair<double, int>, std::pmr::vector<pair<double, int>>, greater<>> q(scratch);
+    dist[s] = 0;
+    q.push(make_pair(heuristic(s), s));
+    int settled_cnt = 0;
+    while (!q.empty()) {
+        auto [key, u] = q.top();
+        q.pop();
+        if (key > dist[u] + heuristic(u)) {
+            continue;
+        }
+        settled_cnt += 1;
+        if (u == t) {
+            break;
+        }
+        for (const auto& arc: graph.out[u]) {
+            const int v = arc.to;
+            if (blocked != nullptr && (*blocked)[v] && v != t) {
+                continue;
+            }
+            if (dist[u] + arc.weight < dist[v]) {
+                dist[v] = dist[u] + arc.weight;
+                prev[v] = make_pair(u, arc.route);
+                q.push(make_pair(dist[v] + heuristic(v), v));
+            }
+        }
+    }
+    if (settled != nullptr) {
+        *settled = settled_cnt;
+    }
+    if (s != t && prev[t].first == -1) {
+        return std::nullopt;
+    }
+    vector<int> path;
+    for (int at = t; at != s; at = prev[at].first) {
+        path.push_back(prev[at].second);
+    }
+    std::reverse(path.begin(), path.end());
+    return path;
+}
+
+optional<vector<int>> bidirectional_dijkstra(
+    const AltGraph& graph,
+    const string& src,
+    const string& dst,
+    const vector<bool>* blocked,
+    int* settled
+) {
+    PROFILE_SCOPE("route/bidirectional");
+    const int s = graph.index_of(src);
+    const int t = graph.index_of(dst);
+    const int n = graph.size();
+    if (s == t) {
+        return vector<int> {};
+    }
+    arena::Scope scope;
+    std::pmr::memory_resource* scratch = arena::scratch();
+    using Dist = std::pmr::vector<double>;
+    using Link = std::pmr::vector<pair<int, int>>;
+    using Queue = priority_queue<pair<double, int>, std::pmr::vector<pair<double, int>>, greater<>>;
+    Dist dist[2] = { Dist(n, INF, scratch), Dist(n, INF, scratch) };
+    // 正向：前驱站点与路线；反向：后继站点与路线
+    Link link[2] = { Link(n, make_pair(-1, -1), scratch), Link(n, make_pair(-1, -1), scratch) };
+    Queue q[2] = { Queue(scratch), Queue(scratch) };
+    dist[0][s] = 0;
+    dist[1][t] = 0;
+    q[0].push(make_pair(0, s));
+    q[1].push(make_pair(0, t));
+    double best = INF;
+    int meet = -1;
+    int settled_cnt = 0;
+    while (!q[0].empty() && !q[1].empty() && q[0].top().first + q[1].top().first < best) {
+        const int dir = q[0].top().first <= q[1].top().first ? 0 : 1;
+        auto [d, u] = q[dir].top();
+        q[dir].pop();
+        if (d > dist[dir][u]) {
+            continue;
+        }
+        settled_cnt += 1;
+        for (const auto& arc: dir == 0 ? graph.out[u] : graph.in[u]) {
+            const int v = arc.to;
+            if (blocked != nullptr && (*blocked)[v] && v != s && v != t) {
+                continue;
+            }
+            if (d + arc.weight < dist[dir][v]) {
+                dist[dir][v] = d + arc.weight;
+                link[dir][v] = make_pair(u, arc.route);
+                q[dir].push(make_pair(dist[dir][v], v));
+                if (dist[1 - dir][v] != INF && dist[0][v] + dist[1][v] < best) {
+                    best = dist[0][v] + dist[1][v];
+                    meet = v;
+                }
+            }
+        }
+    }
+    if (settled != nullptr) {
+        *settled = settled_cnt;
+    }
+    if (meet == -1) {
+        return std::nullopt;
+    }
+    vector<int> path;
+    for (int at = meet; at != s; at = link[0][at].first) {
+        path.push_back(link[0][at].second);
+    }
+    std::reverse(path.begin(), path.end());
+    for (int at = meet; at != t; at = link[1][at].first) {
+        path.push_back(link[1][at].second);
+    }
+    return path;
+}
+
+optional<vector<int>> penalized_dijkstra(
+    const AltGraph& graph,
+    const string& src,
+    const string& dst,
+    const vector<bool>& full,
+    int* settled
+) {
+    PROFILE_SCOPE("route/penalized");
+    arena::Scope scope;
+    std::pmr::memory_resource* scratch = arena::scratch();
+    const int s = graph.index_of(src);
+    const int t = graph.index_of(dst);
+    const int n = graph.size();
+    // 状态 layer * n + v，layer 为 1 表示已经过满站
+    std::pmr::vector<double> dist(2 * n, INF, scratch);
+    // prev state and route
+    std::pmr::vector<pair<int, int>> prev(2 * n, make_pair(-1, -1), scratch);
+    priority_queue<
+        std::tuple<int, double, int>,
+        std::pmr::vector<std::tuple<int, double, int>>,
+        greater<>>
+        q(scratch);
+    dist[s] = 0;
+    q.push(std::make_tuple(0, 0, s));
+    int reached = -1;
+    int settled_cnt = 0;
+    while (!q.empty()) {
+        auto [layer, d, u] = q.top();
+        q.pop();
+        const int from = layer * n + u;
+        if (d > dist[from]) {
+            continue;
+        }
+        settled_cnt += 1;
+        if (u == t) {
+            reached = from;
+            break;
+        }
+        for (const auto& arc: graph.out[u]) {
+            const int v = arc.to;
+            const int to = (layer == 1 || (full[v] && v != t) ? n : 0) + v;
+            if (d + arc.weight < dist[to]) {
+                dist[to] = d + arc.weight;
+                prev[to] = make_pair(from, arc.route);
+                q.push(std::make_tuple(to / n, dist[to], v));
+            }
+        }
+    }
+    if (settled != nullptr) {
+        *settled = settled_cnt;
+    }
+    if (reached == -1) {
+        return std::nullopt;
+    }
+    vector<int> path;
+    for (int at = reached; at != s; at = prev[at].first) {
+        path.push_back(prev[at].second);
+    }
+    std::reverse(path.begin(), path.end());
+    return path;
+}
+
+} // namespace strategy::alt
@@ -0,0 +1,93 @@
+#ifndef STRATEGY_ALT_HPP
+#define STRATEGY_ALT_HPP
+
+#include <map>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base.hpp"
+
+namespace strategy::alt {
+using namespace base;
+using std::map;
+using std::optional;
+using std::pair;
+using std::string;
+using std::vector;
+
+// 静态边权的邻接表及 landmark 距离表，读完数据后建立一次
+// 边权与 strategy::dijkstra 一致；等待时间等动态代价只会让边权变大，所以下界仍然成立
+struct AltGraph {
+public:
+    struct Arc {
+        int to;
+        int route;
+        double weight;
+    };
+
+    AltGraph(
+        const map<string, Station>& stations,
+        const map<string, map<int, Route>>& routes,
+        int landmark_cnt = 4,
+        double money_coefficient = 1.0,
+        double time_coefficient = 1.667
+    );
+
+    // v 到 t 的代价下界
+    double lower_bound(int v, int t) const;
+
+    int index_of(const string& id) const {
+        return this->node_of.at(id);
+    }
+    const string& name_of(int v) const {
+        return this->names[v];
+    }
+    int size() const {
+        return this->names.size();
+    }
+
+public:
+    vector<vector<Arc>> out;
+    vector<vector<Arc>> in; // 反向边，Arc::to 为起点
+    vector<int> landmarks;
+
+private:
+    map<string, int> node_of;
+    vector<string> names;
+    vector<vector<double>> from_landmark; // d(L, v)
+    vector<vector<double>> to_landmark; // d(v, L)
+};
+
+// 静态边权上的 A*（ALT 下界），blocked 中的站点（src、dst 除外）不可经过
+// 找不到路径时返回 nullopt；settled 不为空时写入 settle 的点数
+optional<vector<int>> astar(
+    const AltGraph& graph,
+    const string& src,
+    const string& dst,
+    const vector<bool>* blocked = nullptr,
+    int* settled = nullptr
+);
+
+// 静态边权上的双向 dijkstra，参数含义同 astar
+optional<vector<int>> bidirectional_dijkstra(
+    const AltGraph& graph,
+    const string& src,
+    const string& dst,
+    const vector<bool>* blocked = nullptr,
+    int* settled = nullptr
+);
+
+// 满站（dst 除外）作为字典序惩罚的单次 dijkstra，结果与 strategy::dijkstra_enhanced 相同：
+// 有避开满站的路径时取其中最短的，否则取不限制的最短路；full 按 AltGraph 下标
+optional<vector<int>> penalized_dijkstra(
+    const AltGraph& graph,
+    const string& src,
+    const string& dst,
+    const vector<bool>& full,
+    int* settled = nullptr
+);
+
+} // namespace strategy::alt
+#endif
@@ -0,0 +1,340 @@
+#include "strategy/ch.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <queue>
+#include <utility>
+
+namespace strategy::ch {
+
+using std::greater;
+using std::make_pair;
+using std::pair;
+using std::priority_queue;
+
+constexpr double INF = std::numeric_limits<double>::max();
+// witness search 最多 settle 的点数，超出则保守地加 shortcut
+constexpr int WITNESS_SETTLE_LIMIT = 500;
+
+namespace {
+
+// 查询用的临时数组，每个线程一份，在各个 hierarchy 之间复用
+// 只重置被访问过的点，查询代价与 settle 的点数成正比而不是与站点数成正比
+struct Workspace {
+    vector<double> dist[2];
+    vector<int> parent[2];
+    vector<int> touched;
+    priority_queue<pair<double, int>, vector<pair<double, int>>, greater<>> q[2];
+
+    // 保证能容纳 n 个点；新增的位置与重置后的状态相同
+    void reserve(int n) {
+        if ((int)this->dist[0].size() >= n) {
+            return;
+        }
+        for (int i = 0; i < 2; i++) {
+            this->dist[i].resize(n, INF);
+            this->parent[i].resize(n, -1);
+        }
+    }
+    void reset() {
+        for (int x: this->touched) {
+            for (int i = 0; i < 2; i++) {
+                this->dist[i][x] = INF;
+                this->parent[i][x] = -1;
+            }
+        }
+        this->touched.clear();
+        for (int i = 0; i < 2; i++) {
+            while (!this->q[i].empty()) {
+                this->q[i].pop();
+            }
+        }
+    }
+};
+
+Workspace& workspace() {
+    thread_local Workspace ws;
+    return ws;
+}
+
+} // namespace
+
+ContractionHierarchy::ContractionHierarchy(
+    const map<string, Station>& stations,
+    const map<string, map<int, Route>>& routes,
+    double money_coefficient,
+    double time_coefficient
+) {
+    for (const auto& [id, station]: stations) {
+        this->node_of[id] = this->names.size();
+        this->names.push_back(id);
+    }
+    for (const auto& [src, edges]: routes) {
+        for (const auto& [rid, route]: edges) {
+            const Station& v = stations.at(route.dst);
+            const double w = (route.time + v.process_delay) * time_coefficient
+                + (route.cost + v.cost) * money_coefficient;
+            this->arcs.push_back(
+                Arc { this->node_of.at(src), this->node_of.at(route.dst), w, rid, -1, -1 }
+            );
+        }
+    }
+    this->contract();
+}
+
+void ContractionHierarchy::contract() {
+    const int n = this->names.size();
+    vector<vector<int>> out(n), in(n);
+    for (int a = 0; a < (int)this->arcs.size(); a++) {
+        out[this->arcs[a].from].push_back(a);
+        in[this->arcs[a].to].push_back(a);
+    }
+    vector<bool> contracted(n, false);
+    vector<int> contracted_neighbors(n, 0);
+    vector<double> witness_dist(n, INF);
+    vector<int> witness_touched;
+
+    // 从 u 出发、不经过 skip 和已收缩点的有界 dijkstra
+    auto witness_search = [&](int u, int skip, double limit) {
+        for (int x: witness_touched) {
+            witness_dist[x] = INF;
+        }
+        witness_touched.clear();
+        priority_queue<pair<double, int>, vector<pair<double, int>>, greater<>> q;
+        witness_dist[u] = 0;
+        witness_touched.push_back(u);
+        q.push(make_pair(0, u));
+        int settled = 0;
+        while (!q.empty() && settled < WITNESS_SETTLE_LIMIT) {
+            auto [d, x] = q.top();
+            q.pop();
+            if (d > witness_dist[x]) {
+                continue;
+            }
+            if (d > limit) {
+                break;
+            }
+            settled += 1;
+            for (int a: out[x]) {
+                const int y = this->arcs[a].to;
+                if (contracted[y] || y == skip) {
+                    continue;
+                }
+                if (d + this->arcs[a].weight < witness_dist[y]) {
+                    if (witness_dist[y] == INF) {
+                        witness_touched.push_back(y);
+                    }
+                    witness_dist[y] = d + this->arcs[a].weight;
+                    q.push(make_pair(witness_dist[y], y));
+                }
+            }
+        }
+    };
+
+    // 收缩 v 所需的 shortcut；add 为 true 时真正加入
+    auto process = [&](int v, bool add) {
+        // 平行边只保留最短的一条
+        map<int, int> best_in, best_out;
+        for (int a: in[v]) {
+            const int u = this->arcs[a].from;
+            if (contracted[u] || u == v) {
+                continue;
+            }
+            if (best_in.find(u) == best_in.end()
+                || this->arcs[a].weight < this->arcs[best_in[u]].weight)
+            {
+                best_in[u] = a;
+            }
+        }
+        double max_out = 0;
+        for (int b: out[v]) {
+            const int x = this->arcs[b].to;
+            if (contracted[x] || x == v) {
+                continue;
+            }
+            if (best_out.find(x) == best_out.end()
+                || this->arcs[b].weight < this->arcs[best_out[x]].weight)
+            {
+                best_out[x] = b;
+            }
+            max_out = std::max(max_out, this->arcs[b].weight);
+        }
+        int needed = 0;
+        for (const auto& [u, a]: best_in) {
+            witness_search(u, v, this->arcs[a].weight + max_out);
+            for (const auto& [x, b]: best_out) {
+                if (x == u) {
+                    continue;
+                }
+                const double w = this->arcs[a].weight + this->arcs[b].weight;
+                if (witness_dist[x] <= w) {
+                    continue;
+                }
+                needed += 1;
+                if (add) {
+                    out[u].push_back(this->arcs.size());
+                    in[x].push_back(this->arcs.size());
+                    this->arcs.push_back(Arc { u, x, w, -1, a, b });
+                    this->shortcuts += 1;
+                }
+            }
+        }
+        return needed - (int)best_in.size() - (int)best_out.size() + contracted_neighbors[v];
+    };
+
+    priority_queue<pair<int, int>, vector<pair<int, int>>, greater<>> order;
+    for (int v = 0; v < n; v++) {
+        order.push(make_pair(process(v, false), v));
+    }
+    this->rank.assign(n, -1);
+    int next_rank = 0;
+    while (!order.empty()) {
+        auto [priority, v] = order.top();
+        order.pop();
+        if (contracted[v]) {
+            continue;
+        }
+        // lazy update：优先级变差就放回去
+        const int updated = process(v, false);
+        if (!order.empty() && updated > order.top().first) {
+            order.push(make_pair(updated, v));
+            continue;
+        }
+        process(v, true);
+        contracted[v] = true;
+        this->rank[v] = next_rank++;
+        for (int a: in[v]) {
+            contracted_neighbors[this->arcs[a].from] += 1;
+        }
+        for (int a: out[v]) {
+            contracted_neighbors[this->arcs[a].to] += 1;
+        }
+    }
+
+    this->up_out.assign(n, {});
+    this->up_in.assign(n, {});
+    for (int a = 0; a < (int)this->arcs.size(); a++) {
+        const Arc& arc = this->arcs[a];
+        if (this->rank[arc.from] < this->rank[arc.to]) {
+            this->up_out[arc.from].push_back(a);
+        } else {
+            this->up_in[arc.to].push_back(a);
+        }
+    }
+}
+
+void ContractionHierarchy::unpack(int arc, vector<int>& path) const {
+    if (this->arcs[arc].route != -1) {
+        path.push_back(arc);
+        return;
+    }
+    this->unpack(this->arcs[arc].first, path);
+    this->unpack(this->arcs[arc].second, path);
+}
+
+// 双向搜索，返回展开后的原始 arc 序列
+// stall-on-demand：u 能经由反方向的上行边从 rank 更高、已有更短距离的点到达时，
+// u 的距离不是上行图里的最短距离，不再从 u 扩展
+optional<vector<int>> ContractionHierarchy::search(int s, int t, int* settled) const {
+    Workspace& ws = workspace();
+    ws.reserve(this->names.size());
+    auto& dist = ws.dist;
+    auto& parent = ws.parent;
+    auto& q = ws.q;
+    int settled_cnt = 0;
+    dist[0][s] = 0;
+    dist[1][t] = 0;
+    ws.touched.push_back(s);
+    ws.touched.push_back(t);
+    q[0].push(make_pair(0, s));
+    q[1].push(make_pair(0, t));
+    double best = INF;
+    int meet = -1;
+    while (true) {
+        // 选择堆顶较小的方向；两边堆顶都不小于 best 时结束
+        int dir = -1;
+        for (int i = 0; i < 2; i++) {
+            if (!q[i].empty() && q[i].top().first < best
+                && (dir == -1 || q[i].top().first < q[dir].top().first))
+            {
+                dir = i;
+            }
+        }
+        if (dir == -1) {
+            break;
+        }
+        auto [d, u] = q[dir].top();
+        q[dir].pop();
+        if (d > dist[dir][u]) {
+            continue;
+        }
+        settled_cnt += 1;
+        if (dist[1 - dir][u] != INF && d + dist[1 - dir][u] < best) {
+            best = d + dist[1 - dir][u];
+            meet = u;
+        }
+        const vector<int>& stall = dir == 0 ? this->up_in[u] : this->up_out[u];
+        bool stalled = false;
+        for (int a: stall) {
+            const int w = dir == 0 ? this->arcs[a].from : this->arcs[a].to;
+            if (dist[dir][w] != INF && dist[dir][w] + this->arcs[a].weight < d) {
+                stalled = true;
+                break;
+            }
+        }
+        if (stalled) {
+            continue;
+        }
+        const vector<int>& edges = dir == 0 ? this->up_out[u] : this->up_in[u];
+        for (int a: edges) {
+            const int v = dir == 0 ? this->arcs[a].to : this->arcs[a].from;
+            if (d + this->arcs[a].weight < dist[dir][v]) {
+                if (dist[0][v] == INF && dist[1][v] == INF) {
+                    ws.touched.push_back(v);
+                }
+                dist[dir][v] = d + this->arcs[a].weight;
+                parent[dir][v] = a;
+                q[dir].push(make_pair(dist[dir][v], v));
+            }
+        }
+    }
+
+    optional<vector<int>> path;
+    if (meet != -1) {
+        path.emplace();
+        vector<int> up;
+        for (int at = meet; at != s; at = this->arcs[parent[0][at]].from) {
+            up.push_back(parent[0][at]);
+        }
+        std::reverse(up.begin(), up.end());
+        for (int a: up) {
+            this->unpack(a, *path);
+        }
+        for (int at = meet; at != t; at = this->arcs[parent[1][at]].to) {
+            this->unpack(parent[1][at], *path);
+        }
+    }
+    ws.reset();
+    if (settled != nullptr) {
+        *settled = settled_cnt;
+    }
+    return path;
+}
+
+optional<vector<int>> ContractionHierarchy::query(int s, int t, int* settled) const {
+    if (s == t) {
+        if (settled != nullptr) {
+            *settled = 0;
+        }
+        return vector<int>();
+    }
+    auto path = this->search(s, t, settled);
+    if (path.has_value()) {
+        for (int& a: *path) {
+            a = this->arcs[a].route;
+        }
+    }
+    return path;
+}
+
+} // namespace strategy::ch
@@ -0,0 +1,77 @@
+#ifndef STRATEGY_CH_HPP
+#define STRATEGY_CH_HPP
+
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "base.hpp"
+
+namespace strategy::ch {
+using namespace base;
+using std::map;
+using std::optional;
+using std::string;
+using std::vector;
+
+// 静态边权上的 contraction hierarchy
+// 边权与 strategy::dijkstra 一致：(路线时间 + 终点站处理延迟) * time + (路线费用 + 终点站费用) * money
+// 预处理后点对点查询只需在上行图上做双向搜索
+// 构造后只读，查询的临时数组每个线程一份，可以在多个线程上同时查询
+struct ContractionHierarchy {
+public:
+    ContractionHierarchy(
+        const map<string, Station>& stations,
+        const map<string, map<int, Route>>& routes,
+        double money_coefficient = 1.0,
+        double time_coefficient = 1.667
+    );
+
+    // 返回 s -> t 最短路的路线 id 序列，不可达时返回 nullopt
+    // settled 不为空时写入 settle 的点数（双向合计）
+    optional<vector<int>> query(int s, int t, int* settled = nullptr) const;
+    optional<vector<int>>
+    query(const string& src, const string& dst, int* settled = nullptr) const {
+        return this->query(this->index_of(src), this->index_of(dst), settled);
+    }
+
+    int index_of(const string& id) const {
+        return this->node_of.at(id);
+    }
+    const string& name_of(int v) const {
+        return this->names[v];
+    }
+    int size() const {
+        return this->names.size();
+    }
+
+    int shortcut_cnt() const {
+        return this->shortcuts;
+    }
+
+private:
+    struct Arc {
+        int from;
+        int to;
+        double weight;
+        int route; // 原始路线 id，shortcut 为 -1
+        int first; // shortcut 展开后的两条 arc
+        int second;
+    };
+
+    map<string, int> node_of;
+    vector<string> names;
+    vector<int> rank;
+    vector<Arc> arcs;
+    vector<vector<int>> up_out; // rank 升高的出边
+    vector<vector<int>> up_in; // rank 升高的入边（反向搜索用）
+    int shortcuts = 0;
+
+    void contract();
+    void unpack(int arc, vector<int>& path) const;
+    optional<vector<int>> search(int s, int t, int* settled) const;
+};
+
+} // namespace strategy::ch
+#endif
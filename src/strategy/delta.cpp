@@ -0,0 +1,202 @@
+#include "strategy/delta.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <memory_resource>
+#include <tuple>
+
+#include "arena.hpp"
+
+namespace strategy::delta {
+
+constexpr double INF = std::numeric_limits<double>::infinity();
+constexpr double MAX = std::numeric_limits<double>::max();
+
+CsrGraph::CsrGraph(
+    const map<string, Station>& stations,
+    const map<string, map<int, Route>>& routes
+) {
+    for (const auto& [id, station]: stations) {
+        this->node_of[id] = this->names.size();
+        this->names.push_back(id);
+        this->process_delay.push_back(station.process_delay);
+    }
+    this->first.assign(this->size() + 1, 0);
+    for (const auto& [src, edges]: routes) {
+        this->first[this->index_of(src) + 1] = edges.size();
+    }
+    for (int u = 0; u < this->size(); u++) {
+        this->first[u + 1] += this->first[u];
+    }
+    // routes 按站点 id 排序，与下标顺序相同，依次追加即可
+    for (const auto& [src, edges]: routes) {
+        assert((int)this->to.size() == this->first[this->index_of(src)]);
+        for (const auto& [id, route]: edges) {
+            this->to.push_back(this->index_of(route.dst));
+            this->route.push_back(id);
+            this->time.push_back(route.time);
+            this->money.push_back(route.cost + stations.at(route.dst).cost);
+        }
+    }
+}
+
+bool prefer_parallel(int station_cnt) {
+    return station_cnt >= PARALLEL_MIN_STATIONS;
+}
+
+double bucket_width(const vector<double>& in_bound) {
+    // 宽度取入边下界的中位数：最低的桶里约一半站点的下界不小于桶宽，一轮就能确定
+    // 更窄则轮数多、每轮可并行的出边少；更宽则桶里留下的站点多，每轮要重复扫描
+    vector<double> finite;
+    for (const double lb: in_bound) {
+        if (lb != INF) {
+            finite.push_back(lb);
+        }
+    }
+    if (finite.empty()) {
+        return 1;
+    }
+    auto mid = finite.begin() + finite.size() / 2;
+    std::nth_element(finite.begin(), mid, finite.end());
+    return *mid > 0 ? *mid : 1;
+}
+
+dense::Tree wait_tree(
+    const CsrGraph& graph,
+    int src,
+    double start_process_time,
+    const map<string, v2::StationPlan>& station_plans,
+    pool::WorkerPool* workers,
+    double money_coefficient,
+    double time_coefficient
+) {
+    // 工作线程只写 cand / spent 中各自的区间，这些数组由调用线程在 scratch 中分配
+    arena::Scope scope;
+    std::pmr::memory_resource* scratch = arena::scratch();
+    const int n = graph.size();
+    std::pmr::vector<const v2::StationPlan*> plans(scratch);
+    for (const auto& [id, plan]: station_plans) {
+        assert(id == graph.name_of(plans.size()));
+        plans.push_back(&plan);
+    }
+    // 等待时间不小于 0，(time + delay) * tc + money * mc 是每条边实际权重的下界，舍入后也是
+    vector<double> in_bound(n, INF);
+    for (size_t e = 0; e < graph.to.size(); e++) {
+        const int v = graph.to[e];
+        const double lb = (graph.time[e] + graph.process_delay[v]) * time_coefficient
+            + graph.money[e] * money_coefficient;
+        in_bound[v] = std::min(in_bound[v], lb);
+    }
+    const double width = bucket_width(in_bound);
+
+    vector<double> cost(n, MAX);
+    vector<double> send(n, MAX);
+    vector<int> prev(n, -1);
+    vector<int> via(n, -1);
+    std::pmr::vector<char> settled(n, false, scratch);
+    // slot 为站点当前所在的桶，-1 表示不在桶中；桶里过时的项出桶时丢弃
+    std::pmr::vector<long long> slot(n, -1, scratch);
+    std::pmr::vector<int> seen(n, -1, scratch);
+    std::pmr::map<long long, std::pmr::vector<int>> buckets(scratch);
+    auto push = [&](int v) {
+        const long long key = cost[v] / width;
+        if (slot[v] != key) {
+            slot[v] = key;
+            buckets[key].push_back(v);
+        }
+    };
+    cost[src] = 0;
+    send[src] = start_process_time + graph.process_delay[src];
+    push(src);
+
+    std::pmr::vector<int> frontier(scratch);
+    std::pmr::vector<int> offset(scratch);
+    std::pmr::vector<double> cand(scratch);
+    std::pmr::vector<double> spent(scratch);
+    for (int round = 0; !buckets.empty(); round++) {
+        auto it = buckets.begin();
+        const long long key = it->first;
+        auto& bucket = it->second;
+        double low = MAX;
+        for (const int v: bucket) {
+            if (slot[v] == key) {
+                low = std::min(low, cost[v]);
+            }
+        }
+        // 代价最小的站点一定已确定；其余站点的代价不超过 low + 入边下界时，之后的松弛至少为
+        // low + 入边下界，也不会再改进。只从确定的标号松弛，等待时间估计与 dijkstra 相同
+        frontier.clear();
+        size_t kept = 0;
+        for (const int v: bucket) {
+            if (slot[v] != key || seen[v] == round) {
+                continue;
+            }
+            seen[v] = round;
+            if (cost[v] == low || cost[v] < low + in_bound[v]) {
+                settled[v] = true;
+                slot[v] = -1;
+                frontier.push_back(v);
+            } else {
+                bucket[kept++] = v;
+            }
+        }
+        bucket.resize(kept);
+        if (kept == 0) {
+            buckets.erase(it);
+        }
+        std::sort(frontier.begin(), frontier.end());
+
+        offset.assign(1, 0);
+        for (const int u: frontier) {
+            offset.push_back(offset.back() + graph.first[u + 1] - graph.first[u]);
+        }
+        cand.resize(offset.back());
+        spent.resize(offset.back());
+        // 估计一个站点的所有出边，只读标号与各站负载，可以并发
+        auto estimate = [&](size_t i) {
+            const int u = frontier[i];
+            const double now = send[u];
+            for (int e = graph.first[u], k = offset[i]; e < graph.first[u + 1]; e++, k++) {
+                const int v = graph.to[e];
+                const double wait = plans[v]->estimated_wait_time(now, now + graph.time[e]);
+                spent[k] = graph.time[e] + wait + graph.process_delay[v];
+                cand[k] = cost[u]
+                    + (spent[k] * time_coefficient + graph.money[e] * money_coefficient);
+            }
+        };
+        if (workers != nullptr && workers->size() > 1 && offset.back() >= PARALLEL_MIN_EDGES) {
+            workers->parallel_for(frontier.size(), estimate);
+        } else {
+            for (size_t i = 0; i < frontier.size(); i++) {
+                estimate(i);
+            }
+        }
+
+        // 在调用线程上合并；代价相同时取 dijkstra 先松弛的一条：
+        // 前一站代价小者（先出堆），其次 id 小者，同一站点的平行路线取编号小者
+        for (size_t i = 0; i < frontier.size(); i++) {
+            const int u = frontier[i];
+            for (int e = graph.first[u], k = offset[i]; e < graph.first[u + 1]; e++, k++) {
+                const int v = graph.to[e];
+                if (settled[v]) {
+                    continue;
+                }
+                const bool better = cand[k] < cost[v]
+                    || (cand[k] == cost[v] && prev[v] != -1
+                        && std::make_tuple(cost[u], u, graph.route[e])
+                            < std::make_tuple(cost[prev[v]], prev[v], via[v]));
+                if (better) {
+                    cost[v] = cand[k];
+                    send[v] = send[u] + spent[k];
+                    prev[v] = u;
+                    via[v] = graph.route[e];
+                    push(v);
+                }
+            }
+        }
+    }
+    return dense::Tree { std::move(prev), std::move(via), std::move(send) };
+}
+
+} // namespace strategy::delta
@@ -0,0 +1,75 @@
+#ifndef STRATEGY_DELTA_HPP
+#define STRATEGY_DELTA_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base.hpp"
+#include "pool.hpp"
+#include "strategy/dense.hpp"
+#include "strategy/v2.hpp"
+
+namespace strategy::delta {
+using namespace base;
+using std::map;
+using std::string;
+using std::vector;
+
+// 大图上按下标存放的邻接表（CSR），读完数据后建立一次
+// 站点按 id 顺序编号，每个站点的出边按路线编号升序，与 out_routes 的遍历顺序相同
+struct CsrGraph {
+public:
+    CsrGraph(const map<string, Station>& stations, const map<string, map<int, Route>>& routes);
+
+    int index_of(const string& id) const {
+        return this->node_of.at(id);
+    }
+    const string& name_of(int v) const {
+        return this->names[v];
+    }
+    int size() const {
+        return this->names.size();
+    }
+
+public:
+    vector<int> first; // u 的出边为 [first[u], first[u + 1])
+    vector<int> to;
+    vector<int> route;
+    vector<double> time;
+    vector<double> money; // 路线的 cost 加上终点站的 cost
+    vector<double> process_delay; // 按站点
+
+private:
+    map<string, int> node_of;
+    vector<string> names;
+};
+
+// 下标数组上不查 map，单线程时也比堆版本快一个数量级，见 bench 的 route/*_tree-<站点数>
+// 并行时每轮要同步一次工作线程，站点不少于 PARALLEL_MIN_STATIONS 时每轮的出边才够分
+constexpr int PARALLEL_MIN_STATIONS = 2048;
+bool prefer_parallel(int station_cnt);
+
+// 一轮中待估计的出边不少于这个数时才分给工作线程，否则在调用线程上做完
+constexpr int PARALLEL_MIN_EDGES = 256;
+
+// 桶宽：各站点最短入边静态下界的中位数，见 wait_tree
+double bucket_width(const vector<double>& in_bound);
+
+// 估计等待时间的最短路树，按 CsrGraph 下标，结果与 v3::dijkstra_tree 逐位相同
+// delta-stepping：标号按宽 delta 分桶，每轮取最低的桶中已确定的站点，由 workers 并行估计它们的出边
+// 等待时间随出发时间变化，只从已确定的标号松弛才能与 dijkstra 相同：
+// 站点的代价不超过 当前最小代价 + 它的最短入边下界 时不会再被改进（Crauser 的 IN 判据）
+// workers 为空时在调用线程上计算；station_plans 与 graph 的站点相同，按 id 顺序一一对应
+dense::Tree wait_tree(
+    const CsrGraph& graph,
+    int src,
+    double start_process_time,
+    const map<string, v2::StationPlan>& station_plans,
+    pool::WorkerPool* workers,
+    double money_coefficient = 1.0,
+    double time_coefficient = 1.667
+);
+
+} // namespace strategy::delta
+#endif
@@ -0,0 +1,325 @@
+#include "strategy/dense.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <memory_resource>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define DENSE_X86 1
+#endif
+
+#include "arena.hpp"
+
+namespace strategy::dense {
+
+constexpr double INF = std::numeric_limits<double>::infinity();
+constexpr double MAX = std::numeric_limits<double>::max();
+
+DenseGraph::DenseGraph(
+    const map<string, Station>& stations,
+    const map<string, map<int, Route>>& routes
+) {
+    for (const auto& [id, station]: stations) {
+        this->node_of[id] = this->names.size();
+        this->names.push_back(id);
+    }
+    const int n = this->size();
+    this->stride = (n + 3) / 4 * 4;
+    // 每对站点间的路线数决定层数；map<int, Route> 按编号升序，先到的放在低层
+    vector<int> parallel(n * n, 0);
+    for (const auto& [src, edges]: routes) {
+        for (const auto& [id, route]: edges) {
+            const int k = parallel[this->index_of(src) * n + this->index_of(route.dst)]++;
+            this->layers = std::max(this->layers, k + 1);
+        }
+    }
+    const int cells = this->layers * n * this->stride;
+    this->time.assign(cells, 0);
+    this->money.assign(cells, INF);
+    this->route.assign(cells, -1);
+    this->process_delay.assign(this->stride, 0);
+    for (const auto& [id, station]: stations) {
+        this->process_delay[this->index_of(id)] = station.process_delay;
+    }
+    std::fill(parallel.begin(), parallel.end(), 0);
+    for (const auto& [src, edges]: routes) {
+        const int u = this->index_of(src);
+        for (const auto& [id, route]: edges) {
+            const int v = this->index_of(route.dst);
+            const int at = this->row(parallel[u * n + v]++, u) + v;
+            this->time[at] = route.time;
+            this->money[at] = route.cost + stations.at(route.dst).cost;
+            this->route[at] = id;
+        }
+    }
+}
+
+bool prefer_dense(int station_cnt, int route_cnt) {
+    if (station_cnt > DENSE_MAX_STATIONS) {
+        return false;
+    }
+    // 稀疏核每条边要查几次 map：200 个站点、平均出度 3 时稠密核仍快 3 倍
+    // 平均出度不到 1 的图大多是链，整行扫描几乎都是空格子
+    return route_cnt >= station_cnt;
+}
+
+namespace {
+
+// 一次搜索中不变的输入与各站点的标号，长度均为 stride
+// ready 等四项是各站点的负载，与 v2::StationPlan::estimated_wait_time 逐项对应：
+// buffer 为空时 ready 为 -inf、backlog 为 0，max(now, ready) + backlog 即为 now
+struct Sweep {
+    int stride;
+    double money_coefficient;
+    double time_coefficient;
+    const double* ready; // start_process_ok_time
+    const double* backlog; // buffer.size() / throughput
+    const double* next_due; // 最早的 due 包裹到达时间，没有时为 max
+    const double* due_backlog; // due 包裹数 / throughput
+    const double* delay;
+    double* cost;
+    double* send;
+    int* prev;
+    int* via;
+};
+
+// settle u 之后松弛一层的第 u 行；各向量版本逐项按同样的顺序计算，结果与这里相同
+void
+relax_scalar(const Sweep& s, const double* time, const double* money, const int* route, int u) {
+    const double now = s.send[u];
+    const double base = s.cost[u];
+    for (int v = 0; v < s.stride; v++) {
+        const double arrive = now + time[v];
+        const double finish = std::max(now, s.ready[v]) + s.backlog[v];
+        const double due = std::max(finish, s.next_due[v]) + s.due_backlog[v];
+        const double wait = std::max(0.0, (arrive < s.next_due[v] ? finish : due) - arrive);
+        const double spent = time[v] + wait + s.delay[v];
+        const double cand = base + (spent * s.time_coefficient + money[v] * s.money_coefficient);
+        if (cand < s.cost[v]) {
+            s.cost[v] = cand;
+            s.send[v] = now + spent;
+            s.prev[v] = u;
+            s.via[v] = route[v];
+        }
+    }
+}
+
+#ifdef DENSE_X86
+// x86-64 都有 SSE2；blend 用与或拼出来
+void relax_sse2(const Sweep& s, const double* time, const double* money, const int* route, int u) {
+    const __m128d now = _mm_set1_pd(s.send[u]);
+    const __m128d base = _mm_set1_pd(s.cost[u]);
+    const __m128d tc = _mm_set1_pd(s.time_coefficient);
+    const __m128d mc = _mm_set1_pd(s.money_coefficient);
+    const __m128d zero = _mm_setzero_pd();
+    auto blend = [](__m128d a, __m128d b, __m128d mask) {
+        return _mm_or_pd(_mm_and_pd(mask, b), _mm_andnot_pd(mask, a));
+    };
+    for (int v = 0; v < s.stride; v += 2) {
+        const __m128d t = _mm_loadu_pd(time + v);
+        const __m128d next_due = _mm_loadu_pd(s.next_due + v);
+        const __m128d arrive = _mm_add_pd(now, t);
+        const __m128d finish =
+            _mm_add_pd(_mm_max_pd(now, _mm_loadu_pd(s.ready + v)), _mm_loadu_pd(s.backlog + v));
+        const __m128d due =
+            _mm_add_pd(_mm_max_pd(finish, next_due), _mm_loadu_pd(s.due_backlog + v));
+        const __m128d early = _mm_cmplt_pd(arrive, next_due);
+        const __m128d wait = _mm_max_pd(zero, _mm_sub_pd(blend(due, finish, early), arrive));
+        const __m128d spent = _mm_add_pd(_mm_add_pd(t, wait), _mm_loadu_pd(s.delay + v));
+        const __m128d cand = _mm_add_pd(
+            base,
+            _mm_add_pd(_mm_mul_pd(spent, tc), _mm_mul_pd(_mm_loadu_pd(money + v), mc))
+        );
+        const __m128d cost = _mm_loadu_pd(s.cost + v);
+        const __m128d better = _mm_cmplt_pd(cand, cost);
+        int mask = _mm_movemask_pd(better);
+        if (mask == 0) {
+            continue;
+        }
+        _mm_storeu_pd(s.cost + v, blend(cost, cand, better));
+        _mm_storeu_pd(s.send + v, blend(_mm_loadu_pd(s.send + v), _mm_add_pd(now, spent), better));
+        for (; mask != 0; mask &= mask - 1) {
+            const int w = v + __builtin_ctz(mask);
+            s.prev[w] = u;
+            s.via[w] = route[w];
+        }
+    }
+}
+
+// 只给这一个函数开 AVX2，运行时确认 CPU 支持后才会调用；不开 FMA，乘加不会被合并，舍入与标量相同
+__attribute__((target("avx2"))) void
+relax_avx2(const Sweep& s, const double* time, const double* money, const int* route, int u) {
+    const __m256d now = _mm256_set1_pd(s.send[u]);
+    const __m256d base = _mm256_set1_pd(s.cost[u]);
+    const __m256d tc = _mm256_set1_pd(s.time_coefficient);
+    const __m256d mc = _mm256_set1_pd(s.money_coefficient);
+    const __m256d zero = _mm256_setzero_pd();
+    for (int v = 0; v < s.stride; v += 4) {
+        const __m256d t = _mm256_loadu_pd(time + v);
+        const __m256d next_due = _mm256_loadu_pd(s.next_due + v);
+        const __m256d arrive = _mm256_add_pd(now, t);
+        const __m256d finish = _mm256_add_pd(
+            _mm256_max_pd(now, _mm256_loadu_pd(s.ready + v)),
+            _mm256_loadu_pd(s.backlog + v)
+        );
+        const __m256d due =
+            _mm256_add_pd(_mm256_max_pd(finish, next_due), _mm256_loadu_pd(s.due_backlog + v));
+        const __m256d early = _mm256_cmp_pd(arrive, next_due, _CMP_LT_OQ);
+        const __m256d wait =
+            _mm256_max_pd(zero, _mm256_sub_pd(_mm256_blendv_pd(due, finish, early), arrive));
+        const __m256d spent = _mm256_add_pd(_mm256_add_pd(t, wait), _mm256_loadu_pd(s.delay + v));
+        const __m256d cand = _mm256_add_pd(
+            base,
+            _mm256_add_pd(_mm256_mul_pd(spent, tc), _mm256_mul_pd(_mm256_loadu_pd(money + v), mc))
+        );
+        const __m256d cost = _mm256_loadu_pd(s.cost + v);
+        const __m256d better = _mm256_cmp_pd(cand, cost, _CMP_LT_OQ);
+        int mask = _mm256_movemask_pd(better);
+        if (mask == 0) {
+            continue;
+        }
+        _mm256_storeu_pd(s.cost + v, _mm256_blendv_pd(cost, cand, better));
+        _mm256_storeu_pd(
+            s.send + v,
+            _mm256_blendv_pd(_mm256_loadu_pd(s.send + v), _mm256_add_pd(now, spent), better)
+        );
+        for (; mask != 0; mask &= mask - 1) {
+            const int w = v + __builtin_ctz(mask);
+            s.prev[w] = u;
+            s.via[w] = route[w];
+        }
+    }
+}
+#endif
+
+using Relax = void (*)(const Sweep&, const double*, const double*, const int*, int);
+
+Relax relax_of(Isa isa) {
+    switch (isa) {
+#ifdef DENSE_X86
+        case Isa::AVX2:
+            return relax_avx2;
+        case Isa::SSE2:
+            return relax_sse2;
+#endif
+        default:
+            return relax_scalar;
+    }
+}
+
+Isa best_isa() {
+#ifdef DENSE_X86
+    return __builtin_cpu_supports("avx2") ? Isa::AVX2 : Isa::SSE2;
+#else
+    return Isa::SCALAR;
+#endif
+}
+
+} // namespace
+
+bool supported(Isa isa) {
+    switch (isa) {
+        case Isa::AVX2:
+            return best_isa() == Isa::AVX2;
+        case Isa::SSE2:
+            return best_isa() != Isa::SCALAR;
+        default:
+            return true;
+    }
+}
+
+const char* isa_name(Isa isa) {
+    switch (isa) {
+        case Isa::AUTO:
+            return isa_name(best_isa());
+        case Isa::SCALAR:
+            return "scalar";
+        case Isa::SSE2:
+            return "sse2";
+        case Isa::AVX2:
+            return "avx2";
+    }
+    return "";
+}
+
+Tree wait_tree(
+    const DenseGraph& graph,
+    int src,
+    double start_process_time,
+    const map<string, v2::StationPlan>& station_plans,
+    double money_coefficient,
+    double time_coefficient,
+    Isa isa
+) {
+    static const Isa best = best_isa();
+    assert(isa == Isa::AUTO || supported(isa));
+    const Relax relax = relax_of(isa == Isa::AUTO ? best : isa);
+
+    arena::Scope scope;
+    std::pmr::memory_resource* scratch = arena::scratch();
+    const int n = graph.size();
+    const int stride = graph.stride;
+    std::pmr::vector<double> ready(stride, -INF, scratch);
+    std::pmr::vector<double> backlog(stride, 0, scratch);
+    std::pmr::vector<double> next_due(stride, MAX, scratch);
+    std::pmr::vector<double> due_backlog(stride, 0, scratch);
+    int i = 0;
+    for (const auto& [id, plan]: station_plans) {
+        assert(id == graph.name_of(i));
+        const Station& station = plan.station;
+        if (!station.buffer.empty()) {
+            ready[i] = station.start_process_ok_time;
+            backlog[i] = station.buffer.size() / station.throughput;
+        }
+        next_due[i] = plan.next_arrival_time();
+        due_backlog[i] = plan.arrival_time_of_due_pkgs.size() / station.throughput;
+        i++;
+    }
+    std::pmr::vector<double> cost(stride, MAX, scratch);
+    std::pmr::vector<double> send(stride, MAX, scratch);
+    std::pmr::vector<int> prev(stride, -1, scratch);
+    std::pmr::vector<int> via(stride, -1, scratch);
+    std::pmr::vector<bool> settled(n, false, scratch);
+    const Sweep sweep {
+        stride,
+        money_coefficient,
+        time_coefficient,
+        ready.data(),
+        backlog.data(),
+        next_due.data(),
+        due_backlog.data(),
+        graph.process_delay.data(),
+        cost.data(),
+        send.data(),
+        prev.data(),
+        via.data(),
+    };
+    cost[src] = 0;
+    send[src] = start_process_time + graph.process_delay[src];
+    while (true) {
+        // 与堆版本的出堆顺序相同：代价最小，相同时 id 小者
+        int u = -1;
+        for (int v = 0; v < n; v++) {
+            if (!settled[v] && cost[v] < (u == -1 ? MAX : cost[u])) {
+                u = v;
+            }
+        }
+        if (u == -1) {
+            break;
+        }
+        settled[u] = true;
+        for (int layer = 0; layer < graph.layers; layer++) {
+            const int at = graph.row(layer, u);
+            relax(sweep, &graph.time[at], &graph.money[at], &graph.route[at], u);
+        }
+    }
+    return Tree {
+        vector<int>(prev.begin(), prev.begin() + n),
+        vector<int>(via.begin(), via.begin() + n),
+        vector<double>(send.begin(), send.begin() + n),
+    };
+}
+
+} // namespace strategy::dense
@@ -0,0 +1,86 @@
+#ifndef STRATEGY_DENSE_HPP
+#define STRATEGY_DENSE_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base.hpp"
+#include "strategy/v2.hpp"
+
+namespace strategy::dense {
+using namespace base;
+using std::map;
+using std::string;
+using std::vector;
+
+// 小图上的邻接矩阵，读完数据后建立一次；每行补齐到 4 个 double，按 SIMD 宽度整行松弛
+// 平行路线分层存放：第 k 层的 (u, v) 是 u -> v 编号第 k 小的路线，没有时 money 为 inf
+struct DenseGraph {
+public:
+    DenseGraph(const map<string, Station>& stations, const map<string, map<int, Route>>& routes);
+
+    int index_of(const string& id) const {
+        return this->node_of.at(id);
+    }
+    const string& name_of(int v) const {
+        return this->names[v];
+    }
+    int size() const {
+        return this->names.size();
+    }
+    // 第 layer 层第 u 行的起始下标
+    int row(int layer, int u) const {
+        return (layer * this->size() + u) * this->stride;
+    }
+
+public:
+    int stride = 0; // 行宽
+    int layers = 0;
+    vector<double> time; // 路线耗时，没有路线时为 0
+    vector<double> money; // 路线的 cost 加上终点站的 cost
+    vector<int> route; // 路线编号，没有路线时为 -1
+    vector<double> process_delay; // 按列，补齐的部分为 0
+
+private:
+    map<string, int> node_of;
+    vector<string> names;
+};
+
+// 稠密核扫一整行的代价约为 站点数 × 层数 / 4 次向量运算，稀疏核每条边要查几次 map
+// 站点数不超过 DENSE_MAX_STATIONS 且平均出度不小于 1 时用前者，见 bench 的 route/dense_tree
+constexpr int DENSE_MAX_STATIONS = 256;
+bool prefer_dense(int station_cnt, int route_cnt);
+
+// 整行松弛的实现；AUTO 为当前 CPU 支持的最宽的一种
+enum struct Isa {
+    AUTO,
+    SCALAR,
+    SSE2,
+    AVX2,
+};
+bool supported(Isa isa);
+const char* isa_name(Isa isa);
+
+// 估计等待时间的最短路树，按 DenseGraph 下标；与 v3::dijkstra_tree 逐位相同
+// 不可达的站点 prev 为 -1，start_send 为 max
+struct Tree {
+    vector<int> prev; // 前一站
+    vector<int> route; // 到达所用的路线
+    vector<double> start_send;
+};
+
+// 数组版 dijkstra：每次 settle 代价最小的站点（相同时下标小者），再对它的每一层整行松弛
+// station_plans 与 graph 的站点相同，按 id 顺序一一对应
+Tree wait_tree(
+    const DenseGraph& graph,
+    int src,
+    double start_process_time,
+    const map<string, v2::StationPlan>& station_plans,
+    double money_coefficient = 1.0,
+    double time_coefficient = 1.667,
+    Isa isa = Isa::AUTO
+);
+
+} // namespace strategy::dense
+#endif
@@ -0,0 +1,150 @@
+#include "strategy/replay.hpp"
+
+#include "rust.hpp"
+#include "sim.hpp"
+
+namespace strategy::replay {
+
+void ReplayPolicy::add_order(Sim& sim, const string& id, double time, const string& src) {
+    this->arriving[id] = make_pair(src, time);
+    sim.schedule_event(new ReplayArrival(time, sim, id, src));
+}
+
+bool ReplayPolicy::start(Sim& sim, const string& path) {
+    this->reader = std::make_unique<journal::Reader>(path);
+    if (!this->reader->is_open()) {
+        logs_cargo("Replay", "journal {} not found", path);
+        return false;
+    }
+    this->schedule_next(sim);
+    return true;
+}
+
+void ReplayPolicy::schedule_next(Sim& sim) {
+    if (this->divergence.has_value()) {
+        return;
+    }
+    auto decision = this->reader->next();
+    if (!decision.has_value()) {
+        this->finish(sim);
+        return;
+    }
+    const double time = decision->time;
+    sim.schedule_event(new ReplayDecision(time, sim, std::move(decision.value())));
+}
+
+void ReplayPolicy::diverge(const Decision& decision, const string& reason) {
+    if (this->divergence.has_value()) {
+        return;
+    }
+    this->divergence =
+        Divergence { this->replayed, decision.time, decision.station, decision.package, reason };
+    logs_cargo(
+        "Replay",
+        "diverged at decision {} [{:.3f}] station {} package {}: {}",
+        this->replayed,
+        decision.time,
+        decision.station,
+        decision.package,
+        reason
+    );
+}
+
+void ReplayPolicy::apply(Sim& sim, const Decision& decision) {
+    auto station_it = sim.stations.find(decision.station);
+    if (station_it == sim.stations.end()) {
+        this->diverge(decision, "unknown station");
+        return;
+    }
+    Station& station = station_it->second;
+    if (station.buffer.find(decision.package) == station.buffer.end()) {
+        // 同一时刻的到达还没出队，到达时再应用
+        auto it = this->arriving.find(decision.package);
+        if (it != this->arriving.end() && it->second.first == decision.station
+            && rust::eq(it->second.second, decision.time))
+        {
+            this->deferred = decision;
+            return;
+        }
+        this->diverge(decision, "package not in buffer");
+        return;
+    }
+    if (!rust::time_ok(decision.start, station.start_process_ok_time)) {
+        this->diverge(decision, "start-process is in cd");
+        return;
+    }
+    if (decision.route == -1) {
+        if (sim.packages.at(decision.package).dst != decision.station) {
+            this->diverge(decision, "package is not at its dst");
+            return;
+        }
+        station.take_package_from_buffer_to_processing(decision.package, decision.start);
+        sim.add_transport_cost(station.cost);
+    } else {
+        const auto& routes = sim.routes().at(decision.station);
+        auto route_it = routes.find(decision.route);
+        if (route_it == routes.end()) {
+            this->diverge(decision, "no such route");
+            return;
+        }
+        station.take_package_from_buffer_to_processing(decision.package, decision.start);
+        sim.add_transport_cost(route_it->second.cost);
+        sim.add_transport_cost(station.cost);
+    }
+    sim.schedule_event(new ReplayStartSend(
+        decision.start + station.process_delay,
+        sim,
+        decision.package,
+        decision.station,
+        decision.route
+    ));
+    this->replayed += 1;
+    this->schedule_next(sim);
+}
+
+void ReplayPolicy::finish(Sim& sim) {
+    const auto expected = this->reader->transport_cost();
+    if (!expected.has_value()) {
+        this->divergence = Divergence { this->replayed, 0, "", "", "journal truncated" };
+        logs_cargo("Replay", "journal truncated after {} decisions", this->replayed);
+        return;
+    }
+    if (expected.value() != sim.total_transport_cost()) {
+        this->divergence = Divergence { this->replayed, 0, "", "", "transport cost mismatch" };
+        logs_cargo(
+            "Replay",
+            "transport cost {} differs from journal {}",
+            sim.total_transport_cost(),
+            expected.value()
+        );
+    }
+}
+
+void ReplayArrival::process_event() {
+    this->sim.policy.arriving.erase(this->package);
+    this->sim.stations.at(this->station).buffer.insert(this->package);
+    auto& deferred = this->sim.policy.deferred;
+    if (deferred.has_value() && deferred->package == this->package) {
+        const Decision decision = std::move(deferred.value());
+        deferred.reset();
+        this->sim.policy.apply(this->sim, decision);
+    }
+}
+
+void ReplayDecision::process_event() {
+    this->sim.policy.apply(this->sim, this->decision);
+}
+
+void ReplayStartSend::process_event() {
+    if (this->route == -1) {
+        this->sim.finish_order(this->package, this->time);
+        return;
+    }
+    const Route& route = this->sim.routes().at(this->src).at(this->route);
+    this->sim.policy.arriving[this->package] = make_pair(route.dst, this->time + route.time);
+    this->sim.schedule_event(
+        new ReplayArrival(this->time + route.time, this->sim, this->package, route.dst)
+    );
+}
+
+} // namespace strategy::replay
@@ -0,0 +1,114 @@
+#ifndef STRATEGY_REPLAY_HPP
+#define STRATEGY_REPLAY_HPP
+
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+
+#include "base.hpp"
+#include "event.hpp"
+#include "journal.hpp"
+#include "log.hpp"
+
+namespace sim {
+template<typename Policy>
+struct Simulation;
+}
+
+namespace strategy::replay {
+using std::make_pair;
+using std::map;
+using std::optional;
+using std::pair;
+using std::string;
+
+using base::Route;
+using base::Station;
+using event::SimEvent;
+using journal::Decision;
+using log::logs_cargo;
+
+// 第一处与日志不一致的决策
+struct Divergence {
+    long long index; // 第几条决策，从 0 开始
+    double time;
+    string station;
+    string package;
+    string reason;
+};
+
+// 按决策日志重放：不调用任何选包与路径规划，只推进 buffer、处理 cd、费用与到达
+// 用法：读入与录制时相同的数据后调用 start(sim, path)，再 run()
+struct ReplayPolicy {
+    using Sim = sim::Simulation<ReplayPolicy>;
+
+    std::unique_ptr<journal::Reader> reader;
+    optional<Divergence> divergence;
+    long long replayed = 0;
+    // 在途包裹的下一次到达 (站点, 时间)；决策早于同一时刻的到达出队时据此等待
+    map<string, pair<string, double>> arriving;
+    optional<Decision> deferred;
+
+    void add_station(Sim& sim, const string& id) {}
+    void add_order(Sim& sim, const string& id, double time, const string& src);
+
+    // 打开日志并安排第一条决策，日志无法打开时返回 false
+    bool start(Sim& sim, const string& path);
+    // 应用一条决策；与当前状态不一致时记录 divergence 并停止重放
+    void apply(Sim& sim, const Decision& decision);
+    // 日志读完后与结束标记中的运输费用比对
+    void finish(Sim& sim);
+
+private:
+    void diverge(const Decision& decision, const string& reason);
+    void schedule_next(Sim& sim);
+};
+
+using Simulation = sim::Simulation<ReplayPolicy>;
+
+struct ReplayArrival: public SimEvent<Simulation> {
+public:
+    ReplayArrival(double t, Simulation& sim, string package, string station):
+        SimEvent<Simulation>(t, sim),
+        package(std::move(package)),
+        station(std::move(station)) {}
+
+    void process_event() override;
+
+private:
+    string package;
+    string station;
+};
+
+struct ReplayDecision: public SimEvent<Simulation> {
+public:
+    ReplayDecision(double t, Simulation& sim, Decision decision):
+        SimEvent<Simulation>(t, sim),
+        decision(std::move(decision)) {}
+
+    void process_event() override;
+
+private:
+    Decision decision;
+};
+
+struct ReplayStartSend: public SimEvent<Simulation> {
+public:
+    ReplayStartSend(double t, Simulation& sim, string package, string src, int route):
+        SimEvent<Simulation>(t, sim),
+        package(std::move(package)),
+        src(std::move(src)),
+        route(route) {}
+
+    void process_event() override;
+
+private:
+    string package;
+    string src;
+    int route;
+};
+
+} // namespace strategy::replay
+#endif
@@ -1,17 +1,121 @@
 #include "strategy/v1.hpp"
 
-#include <fstream>
-
+#include "profile.hpp"
 #include "sim.hpp"
 #include "strategy.hpp"
 
 namespace strategy::v1 {
 
-void V1TryProcessOne::process_event() {
+void V1Policy::add_order(Sim& sim, const string& id, double time, const string& src) {
+    sim.schedule_event(new V1Arrival<V1Policy>(time, sim, id, src));
+}
+
+void StaticRouting::prepare(
+    const map<string, Station>& stations,
+    const map<string, map<int, Route>>& routes,
+    const scenario::Scenario* shared
+) {
+    if (this->search == RouteSearch::CH && this->hierarchy == nullptr) {
+        this->hierarchy = shared != nullptr
+            ? shared->hierarchy()
+            : std::make_shared<const ch::ContractionHierarchy>(stations, routes);
+    }
+    if (this->search == RouteSearch::ALT || this->search == RouteSearch::BIDIRECTIONAL) {
+        this->prepare_graph(stations, routes, shared);
+    }
+}
+
+void StaticRouting::prepare_graph(
+    const map<string, Station>& stations,
+    const map<string, map<int, Route>>& routes,
+    const scenario::Scenario* shared
+) {
+    if (this->alt_graph == nullptr) {
+        this->alt_graph = shared != nullptr
+            ? shared->alt_graph()
+            : std::make_shared<const alt::AltGraph>(stations, routes);
+    }
+}
+
+vector<int> StaticRouting::static_route(
+    const map<string, Station>& stations,
+    const map<string, map<int, Route>>& routes,
+    const string& src,
+    const string& dst
+) {
+    switch (this->search) {
+        case RouteSearch::CH:
+            return dijkstra(*this->hierarchy, src, dst);
+        case RouteSearch::ALT:
+            return alt::astar(*this->alt_graph, src, dst).value();
+        case RouteSearch::BIDIRECTIONAL:
+            return alt::bidirectional_dijkstra(*this->alt_graph, src, dst).value();
+        default:
+            return dijkstra(stations, routes, src, dst);
+    }
+}
+
+vector<int> V1Policy::route(const Sim& sim, const string& src, const string& dst) {
+    this->prepare(sim.stations, sim.routes(), sim.shared_scenario());
+    return this->static_route(sim.stations, sim.routes(), src, dst);
+}
+
+void V1BPolicy::add_order(Sim& sim, const string& id, double time, const string& src) {
+    sim.schedule_event(new V1Arrival<V1BPolicy>(time, sim, id, src));
+}
+
+// 满站判定，与 dijkstra_enhanced 相同
+bool is_full(const Station& station) {
+    return station.buffer.size() > FULL_STANDARD_COEFFICIENT * station.throughput;
+}
+
+void V1BPolicy::buffer_changed(const Sim& sim, const string& id) {
+    if (this->full.empty()) {
+        return;
+    }
+    const int v = this->alt_graph->index_of(id);
+    const bool now = is_full(sim.stations.at(id));
+    if (this->full[v] != now) {
+        this->full[v] = now;
+        this->full_cnt += now ? 1 : -1;
+    }
+}
+
+vector<int> V1BPolicy::route(const Sim& sim, const string& src, const string& dst) {
+    this->prepare(sim.stations, sim.routes(), sim.shared_scenario());
+    this->prepare_graph(sim.stations, sim.routes(), sim.shared_scenario());
+    if (this->full.empty()) {
+        const alt::AltGraph& graph = *this->alt_graph;
+        this->full.resize(graph.size());
+        for (int v = 0; v < graph.size(); v++) {
+            this->full[v] = is_full(sim.stations.at(graph.name_of(v)));
+            this->full_cnt += this->full[v];
+        }
+    }
+    // 只有终点满时不必避开
+    if (this->full_cnt == 0
+        || (this->full_cnt == 1 && this->full[this->alt_graph->index_of(dst)]))
+    {
+        return this->static_route(sim.stations, sim.routes(), src, dst);
+    }
+    if (this->search == RouteSearch::CH) {
+        return dijkstra_enhanced(
+            *this->hierarchy,
+            *this->alt_graph,
+            sim.routes(),
+            src,
+            dst,
+            this->full
+        );
+    }
+    logs_cargo("Info", "dijkstra_enhanced called");
+    return alt::penalized_dijkstra(*this->alt_graph, src, dst, this->full).value();
+}
+
+template<typename Policy>
+void V1TryProcessOne<Policy>::process_event() {
     // std::ofstream file("output.txt", std::ios::app);
     // std::ofstream file("output.txt", std::ios::app);
-    std::ofstream number_package_in_station("number_package_in_station.csv", std::ios::app);
-    std::ofstream package_trip("package_trip.csv", std::ios::app);
 
     logs("[{:.3f}] {}] station {} try to process one.", this->time, this->station, this->station);
     // 根据吞吐量判断 StartProcess 间隔
@@ -25,7 +129,7 @@ void V1TryProcessOne::process_event() {
             this->station
         );
         // when cd is ok, try again
-        this->sim.schedule_event(new V1TryProcessOne(
+        this->sim.schedule_event(new V1TryProcessOne<Policy>(
             this->sim.stations.at(this->station).start_process_ok_time,
             this->sim,
             this->station
@@ -44,30 +148,19 @@ void V1TryProcessOne::process_event() {
     }
     // [process success]
     string earlist_package = *this->sim.stations.at(this->station).buffer.begin();
-    for (const auto& package: this->sim.stations.at(this->station).buffer) {
-        if (this->sim.packages[package].time_created
-            < this->sim.packages[earlist_package].time_created)
-        {
-            earlist_package = package;
+    {
+        PROFILE_SCOPE("select/V1");
+        for (const auto& package: this->sim.stations.at(this->station).buffer) {
+            if (this->sim.packages[package].time_created
+                < this->sim.packages[earlist_package].time_created)
+            {
+                earlist_package = package;
+            }
         }
     }
     // use dijkstra
-    auto path = [&]() {
-        if (this->sim.strategy_version == StrategyVersion::V1B) {
-            return dijkstra_enhanced(
-                this->sim.stations,
-                this->sim.routes,
-                this->station,
-                this->sim.packages[earlist_package].dst
-            );
-        }
-        return dijkstra(
-            this->sim.stations,
-            this->sim.routes,
-            this->station,
-            this->sim.packages[earlist_package].dst
-        );
-    }();
+    auto path =
+        this->sim.policy.route(this->sim, this->station, this->sim.packages[earlist_package].dst);
     if (path.size() == 0) {
         // already at src
         logs(
@@ -83,13 +176,12 @@ void V1TryProcessOne::process_event() {
         // 会修改 ok_time
         this->sim.stations.at(this->station)
             .take_package_from_buffer_to_processing(earlist_package, this->time);
-        for (const auto& [id, station]: this->sim.stations) {
-            number_package_in_station << this->time << "," << id << ","
-                                      << this->sim.stations.at(id).buffer.size() << "\n";
-        }
+        this->sim.policy.buffer_changed(this->sim, this->station);
+        this->sim.record_decision(this->time, this->time, this->station, earlist_package, -1);
+        this->sim.write_occupancy(this->time);
         // only station cost
         this->sim.add_transport_cost(this->sim.stations.at(this->station).cost);
-        this->sim.schedule_event(new V1StartSend(
+        this->sim.schedule_event(new V1StartSend<Policy>(
             // [todo]
             // 会预备一个 TryProcess，那么如何判断时间是否 ok?（注意精度问题）
             this->time + this->sim.stations.at(this->station).process_delay,
@@ -98,13 +190,12 @@ void V1TryProcessOne::process_event() {
             this->station,
             -1
         ));
-        this->sim.schedule_event(new V1TryProcessOne(
+        this->sim.schedule_event(new V1TryProcessOne<Policy>(
             this->sim.stations.at(this->station).start_process_ok_time,
             this->sim,
             this->station
         ));
-        package_trip << this->time << "," << earlist_package << "," << this->station << ","
-                     << this->station << "\n";
+        this->sim.write_trip(this->time, earlist_package, this->station, this->station);
         return;
     }
     logs(
@@ -113,33 +204,35 @@ void V1TryProcessOne::process_event() {
         this->station,
         this->station,
         earlist_package,
-        this->sim.routes.at(this->station).at(path[0]).dst
+        this->sim.routes().at(this->station).at(path[0]).dst
     );
     this->sim.stations.at(this->station)
         .take_package_from_buffer_to_processing(earlist_package, this->time);
-    for (const auto& [id, station]: this->sim.stations) {
-        number_package_in_station << this->time << "," << id << ","
-                                  << this->sim.stations.at(id).buffer.size() << "\n";
-    }
+    this->sim.policy.buffer_changed(this->sim, this->station);
+    this->sim.record_decision(this->time, this->time, this->station, earlist_package, path[0]);
+    this->sim.write_occupancy(this->time);
     // choose path[0]
-    this->sim.add_transport_cost(this->sim.routes.at(this->station).at(path[0]).cost);
+    this->sim.add_transport_cost(this->sim.routes().at(this->station).at(path[0]).cost);
     this->sim.add_transport_cost(this->sim.stations.at(this->station).cost);
-    this->sim.schedule_event(new V1StartSend(
+    this->sim.schedule_event(new V1StartSend<Policy>(
         this->time + this->sim.stations.at(this->station).process_delay,
         this->sim,
         earlist_package,
         this->station,
         path[0]
     ));
-    package_trip << this->time << "," << earlist_package << "," << this->station << ","
-                 << this->sim.routes.at(this->station).at(path[0]).dst << "\n";
+    this->sim.write_trip(
+        this->time,
+        earlist_package,
+        this->station,
+        this->sim.routes().at(this->station).at(path[0]).dst
+    );
 }
 
-void V1Arrival::process_event() {
+template<typename Policy>
+void V1Arrival<Policy>::process_event() {
     // std::ofstream file("output.txt", std::ios::app);
     // std::ofstream file("output.txt", std::ios::app);
-    std::ofstream number_package_in_station("number_package_in_station.csv", std::ios::app);
-    std::ofstream package_trip("package_trip.csv", std::ios::app);
 
     logs(
         "[{:.3f}] {}] Arrival pack {}: {}",
@@ -149,43 +242,19 @@ void V1Arrival::process_event() {
         this->station
     );
     this->sim.stations.at(this->station).buffer.insert(this->package);
+    this->sim.policy.buffer_changed(this->sim, this->station);
 
-    for (const auto& [id, station]: this->sim.stations) {
-        number_package_in_station << this->time << "," << id << ","
-                                  << this->sim.stations.at(id).buffer.size() << "\n";
-    }
-    package_trip << this->time << "," << this->package << "," << this->station << ","
-                 << this->station << "\n";
-    this->sim.schedule_event(new V1TryProcessOne(this->time, this->sim, this->station));
+    this->sim.write_occupancy(this->time);
+    this->sim.write_trip(this->time, this->package, this->station, this->station);
+    this->sim.schedule_event(new V1TryProcessOne<Policy>(this->time, this->sim, this->station));
     // this->sim.schedule_event();
     // [test]
     // buffer size
     // logs("[{:.3f}] buffer size: {}", this->time, this->sim.stations[this->station].buffer.size());
 }
 
-void V0StartProcess::process_event() {
-    std::ofstream package_trip("package_trip.csv", std::ios::app);
-    logs(
-        "[{:.3f}] {} StartProcess pack {}: {} => {}",
-        this->time,
-        this->src,
-        this->src,
-        this->package,
-        this->src,
-        this->sim.routes[this->src][this->route].dst
-    );
-    this->sim.schedule_event(new V1StartSend(
-        this->time + this->sim.stations.at(this->src).process_delay,
-        this->sim,
-        this->package,
-        this->src,
-        this->route
-    ));
-    package_trip << this->time << "," << this->package << "," << this->src << ","
-                 << this->sim.routes[this->src][this->route].dst << "\n";
-}
-
-void V1StartSend::process_event() {
+template<typename Policy>
+void V1StartSend<Policy>::process_event() {
     // turn into fmt
     // std::ofstream file("output.txt", std::ios::app);
     if (this->sim.packages[this->package].dst == this->src) {
@@ -208,18 +277,25 @@ void V1StartSend::process_event() {
         this->src,
         this->package,
         this->src,
-        this->sim.routes.at(this->src).at(this->route).dst,
-        this->sim.routes.at(this->src).at(this->route).time
+        this->sim.routes().at(this->src).at(this->route).dst,
+        this->sim.routes().at(this->src).at(this->route).time
     );
-    this->sim.schedule_event(new V1Arrival(
+    this->sim.schedule_event(new V1Arrival<Policy>(
         // find src => dst route
-        this->time + this->sim.routes.at(this->src).at(this->route).time,
+        this->time + this->sim.routes().at(this->src).at(this->route).time,
         this->sim,
         this->package,
-        this->sim.routes.at(this->src).at(this->route).dst
+        this->sim.routes().at(this->src).at(this->route).dst
     ));
     // try process one right now (but after this StartSend guranteed by event push)
-    // this->sim.schedule_event(new V1TryProcessOne(this->time, this->sim, this->src));
+    // this->sim.schedule_event(new V1TryProcessOne<Policy>(this->time, this->sim, this->src));
 }
 
+template struct V1Arrival<V1Policy>;
+template struct V1Arrival<V1BPolicy>;
+template struct V1StartSend<V1Policy>;
+template struct V1StartSend<V1BPolicy>;
+template struct V1TryProcessOne<V1Policy>;
+template struct V1TryProcessOne<V1BPolicy>;
+
 } // namespace strategy::v1
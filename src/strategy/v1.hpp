@@ -1,62 +1,111 @@
 #ifndef STRATEGY_V1_HPP
 #define STRATEGY_V1_HPP
 
+#include <memory>
+#include <optional>
 #include <string>
+#include <vector>
 
 #include "event.hpp"
 #include "log.hpp"
+#include "scenario.hpp"
+#include "strategy.hpp"
+#include "strategy/alt.hpp"
+#include "strategy/ch.hpp"
 
 namespace sim {
-struct Simultaion;
+template<typename Policy>
+struct Simulation;
 }
 
 namespace strategy::v1 {
+using std::map;
 using std::string;
+using std::vector;
 
-using event::Event;
+using event::SimEvent;
 using log::logs;
 using log::logs_cargo;
-using sim::Simulation;
 
-struct V1Arrival: public Event {
-public:
-    V1Arrival(double t, Simulation& sim, string package, string dst):
-        Event(t, sim),
-        package(package),
-        station(dst) {}
+// V1 / V1B 共用：静态边权，按 search 选择搜索方式，所需预处理在第一次规划时建立
+// 模拟由共享的 Scenario 载入时直接取用场景里的预处理，不再各建一份
+struct StaticRouting {
+    RouteSearch search = RouteSearch::CH;
+    std::shared_ptr<const ch::ContractionHierarchy> hierarchy;
+    std::shared_ptr<const alt::AltGraph> alt_graph;
+
+    void prepare(
+        const map<string, Station>& stations,
+        const map<string, map<int, Route>>& routes,
+        const scenario::Scenario* shared
+    );
+    // 按 search 不考虑负载的点对点最短路
+    vector<int> static_route(
+        const map<string, Station>& stations,
+        const map<string, map<int, Route>>& routes,
+        const string& src,
+        const string& dst
+    );
+
+protected:
+    void prepare_graph(
+        const map<string, Station>& stations,
+        const map<string, map<int, Route>>& routes,
+        const scenario::Scenario* shared
+    );
+};
 
-    void process_event() override;
+// V1: 最早创建的包裹先处理，dijkstra 规划路径
+struct V1Policy: public StaticRouting {
+    using Sim = sim::Simulation<V1Policy>;
 
-private:
-    string package;
-    string station;
+    void add_station(Sim& sim, const string& id) {}
+    void add_order(Sim& sim, const string& id, double time, const string& src);
+    void buffer_changed(const Sim& sim, const string& id) {}
+    vector<int> route(const Sim& sim, const string& src, const string& dst);
 };
 
-struct V0StartProcess: public Event {
+// V1B: 同 V1，但规划时避开 buffer 较满的站点
+// 没有满站时就是 V1 的静态最短路；有满站时做一次 alt::penalized_dijkstra，
+// search 为 CH 时先试 CH 的最短路，不经过满站就不必再搜
+struct V1BPolicy: public StaticRouting {
+    using Sim = sim::Simulation<V1BPolicy>;
+
+    // 按 alt_graph 下标的满站标记，只在 buffer 越过阈值时改动；第一次规划时建立
+    vector<bool> full;
+    int full_cnt = 0;
+
+    void add_station(Sim& sim, const string& id) {}
+    void add_order(Sim& sim, const string& id, double time, const string& src);
+    // buffer 大小变化后调用
+    void buffer_changed(const Sim& sim, const string& id);
+    vector<int> route(const Sim& sim, const string& src, const string& dst);
+};
+
+template<typename Policy>
+struct V1Arrival: public SimEvent<sim::Simulation<Policy>> {
 public:
-    [[deprecated("V0 is not used anymore")]]
-    V0StartProcess(double t, Simulation& sim, string package, string src, int route):
-        Event(t, sim),
-        package(package),
-        src(src),
-        route(route) {}
+    V1Arrival(double t, sim::Simulation<Policy>& sim, string package, string dst):
+        SimEvent<sim::Simulation<Policy>>(t, sim),
+        package(std::move(package)),
+        station(std::move(dst)) {}
 
     void process_event() override;
 
 private:
     string package;
-    string src;
-    int route;
+    string station;
 };
 
 // [可能是送原地，即完成配送]
 // EndProcess
-struct V1StartSend: public Event {
+template<typename Policy>
+struct V1StartSend: public SimEvent<sim::Simulation<Policy>> {
 public:
-    V1StartSend(double t, Simulation& sim, string package, string src, int route):
-        Event(t, sim),
-        package(package),
-        src(src),
+    V1StartSend(double t, sim::Simulation<Policy>& sim, string package, string src, int route):
+        SimEvent<sim::Simulation<Policy>>(t, sim),
+        package(std::move(package)),
+        src(std::move(src)),
         route(route) {}
 
     void process_event() override;
@@ -68,15 +117,26 @@ private:
 };
 
 // 检查 buffer 和从 buffer 中拿出内容 buffer 必须在同一个 event
-struct V1TryProcessOne: public Event {
+template<typename Policy>
+struct V1TryProcessOne: public SimEvent<sim::Simulation<Policy>> {
 private:
     string station;
 
 public:
-    V1TryProcessOne(double t, Simulation& sim, string station): Event(t, sim), station(station) {}
+    V1TryProcessOne(double t, sim::Simulation<Policy>& sim, string station):
+        SimEvent<sim::Simulation<Policy>>(t, sim),
+        station(std::move(station)) {}
 
     void process_event() override;
 };
 
+// 定义与显式实例化见 v1.cpp
+extern template struct V1Arrival<V1Policy>;
+extern template struct V1Arrival<V1BPolicy>;
+extern template struct V1StartSend<V1Policy>;
+extern template struct V1StartSend<V1BPolicy>;
+extern template struct V1TryProcessOne<V1Policy>;
+extern template struct V1TryProcessOne<V1BPolicy>;
+
 } // namespace strategy::v1
 #endif
@@ -1,7 +1,11 @@
 #include "strategy/v2.hpp"
 
+#include <memory_resource>
+
+#include "arena.hpp"
 #include "base.hpp"
 #include "log.hpp"
+#include "profile.hpp"
 #include "sim.hpp"
 #include "strategy.hpp"
 
@@ -9,15 +13,16 @@ namespace strategy::v2 {
 
 using std::make_pair;
 
-void try_due_try(double t, Simulation& sim, string station) {
+template<typename Policy>
+void try_due_try(double t, sim::Simulation<Policy>& sim, string station) {
     // check cached due time
-    if (!sim.v2_cache.station_info.at(station).due_try_time.has_value()) {
-        sim.v2_cache.station_info.at(station).due_try_time = t;
-        sim.schedule_event(new V2TryProcessOne(t, sim, station));
+    if (!sim.policy.v2_cache.station_info.at(station).due_try_time.has_value()) {
+        sim.policy.v2_cache.station_info.at(station).due_try_time = t;
+        sim.schedule_event(new V2TryProcessOne<Policy>(t, sim, station));
     }
-    if (t < sim.v2_cache.station_info.at(station).due_try_time) {
-        sim.v2_cache.station_info.at(station).due_try_time = t;
-        sim.schedule_event(new V2TryProcessOne(t, sim, station));
+    if (t < sim.policy.v2_cache.station_info.at(station).due_try_time) {
+        sim.policy.v2_cache.station_info.at(station).due_try_time = t;
+        sim.schedule_event(new V2TryProcessOne<Policy>(t, sim, station));
         return;
     }
 }
@@ -29,13 +34,23 @@ vector<int> fake_dijkstra(
     string dst,
     double start_process_time,
     const map<string, StationPlan>& station_plans,
-    double money_coefficient = 1.0,
-    double time_coefficient = 1.667
+    const alt::AltGraph* alt_graph,
+    double money_coefficient,
+    double time_coefficient
 ) {
     logs_cargo("Info", "fake_dijkstra called");
-    map<string, double> cost;
-    map<string, double> start_send_time_at_min_cost;
-    map<string, pair<string, int>> prev; // nodes' prev station and route
+    PROFILE_SCOPE("route/fake_dijkstra");
+    // 有 alt_graph 时用 landmark 下界做 A*，settle 到 dst 即可停止
+    // 等待时间非负，静态边权的下界仍然成立
+    const int t = alt_graph == nullptr ? -1 : alt_graph->index_of(dst);
+    auto heuristic = [&](const string& v) {
+        return alt_graph == nullptr ? 0.0 : alt_graph->lower_bound(alt_graph->index_of(v), t);
+    };
+    arena::Scope scope;
+    std::pmr::map<string, double> cost(arena::scratch());
+    std::pmr::map<string, double> start_send_time_at_min_cost(arena::scratch());
+    // nodes' prev station and route
+    std::pmr::map<string, pair<string, int>> prev(arena::scratch());
     for (const auto& [id, station]: stations) {
         cost[id] = std::numeric_limits<double>::max();
         start_send_time_at_min_cost[id] = std::numeric_limits<double>::max();
@@ -43,17 +58,22 @@ vector<int> fake_dijkstra(
     cost[src] = 0;
     start_send_time_at_min_cost[src] = start_process_time + stations.at(src).process_delay;
     // priority_queue<pair<double, string>> q;
-    priority_queue<pair<double, string>, vector<pair<double, string>>, greater<>> q;
+    priority_queue<pair<double, string>, std::pmr::vector<pair<double, string>>, greater<>> q(
+        arena::scratch()
+    );
 
-    q.push(make_pair(0, src));
+    q.push(make_pair(heuristic(src), src));
     while (!q.empty()) {
         auto [d, u] = q.top();
         q.pop();
-        if (d > cost[u]) {
+        if (d > cost[u] + heuristic(u)) {
             continue;
         }
+        if (alt_graph != nullptr && u == dst) {
+            break;
+        }
         // if not found, edges is empty
-        auto edges = routes.find(u) == routes.end() ? map<int, Route> {} : routes.at(u);
+        const auto& edges = out_routes(routes, u);
         for (const auto& route: edges) {
             string v = route.second.dst;
             const double estimated_wait_time = station_plans.at(v).estimated_wait_time(
@@ -70,7 +90,7 @@ vector<int> fake_dijkstra(
                 start_send_time_at_min_cost[v] =
                     start_send_time_at_min_cost.at(u) + time_gonna_be_spent;
                 prev[v] = { u, route.first };
-                q.push(make_pair(cost[v], v));
+                q.push(make_pair(cost[v] + heuristic(v), v));
             }
         }
     }
@@ -99,7 +119,6 @@ double StationPlan::next_arrival_time() const {
 }
 
 double StationPlan::estimated_wait_time(double now, double arrive_time) const {
-    const Station& station = this->sim.stations.at(id);
     const double finish_cur_buf_time = [&]() {
         if (station.buffer.size() == 0) {
             return now;
@@ -120,6 +139,7 @@ double StationPlan::estimated_wait_time(double now, double arrive_time) const {
 }
 void StationPlan::add_due_pkg(double t, const string& id) {
     this->arrival_time_of_due_pkgs.push(make_pair(t, id));
+    this->note_load_change();
 }
 void StationPlan::pop_due_pkg(double t, const string& id) {
     assert(!this->arrival_time_of_due_pkgs.empty());
@@ -130,37 +150,108 @@ void StationPlan::pop_due_pkg(double t, const string& id) {
     //     return;
     // }
     this->arrival_time_of_due_pkgs.pop();
+    this->note_load_change();
+}
+
+V2Cache::V2Cache(const map<string, Station>& stations) {
+    for (const auto& [id, station]: stations) {
+        this->add_station(station);
+    }
+}
+
+void V2Cache::add_station(const Station& station) {
+    this->station_plans.emplace(station.id, StationPlan(station));
+    this->station_info.emplace(station.id, StationInfo());
+}
+
+const alt::AltGraph* WaitRouting::alt_graph_of(
+    const map<string, Station>& stations,
+    const map<string, map<int, Route>>& routes,
+    const scenario::Scenario* shared
+) {
+    if (this->search != RouteSearch::ALT) {
+        return nullptr;
+    }
+    if (this->alt_graph == nullptr) {
+        this->alt_graph = shared != nullptr
+            ? shared->alt_graph()
+            : std::make_shared<const alt::AltGraph>(stations, routes);
+    }
+    return this->alt_graph.get();
+}
+
+void V2Policy::add_station(Sim& sim, const string& id) {
+    this->v2_cache.add_station(sim.stations.at(id));
+}
+
+void V2Policy::add_order(Sim& sim, const string& id, double time, const string& src) {
+    sim.schedule_event(new V2Arrival<V2Policy>(time, sim, id, src, true));
+}
+
+string V2Policy::select(Sim& sim, const string& station) const {
+    PROFILE_SCOPE("select/V2");
+    string vip_package = *sim.stations.at(station).buffer.begin();
+    for (const auto& package: sim.stations.at(station).buffer) {
+        if (sim.packages[package].time_created < sim.packages[vip_package].time_created) {
+            vip_package = package;
+        }
+    }
+    return vip_package;
+}
+
+void V2BPolicy::add_station(Sim& sim, const string& id) {
+    this->v2_cache.add_station(sim.stations.at(id));
+}
+
+void V2BPolicy::add_order(Sim& sim, const string& id, double time, const string& src) {
+    sim.schedule_event(new V2Arrival<V2BPolicy>(time, sim, id, src, true));
 }
 
-V2Cache::V2Cache(Simulation& sim) {
-    for (const auto& [id, station]: sim.stations) {
-        station_plans.emplace(id, StationPlan(id, sim));
+string V2BPolicy::select(Sim& sim, const string& station) const {
+    PROFILE_SCOPE("select/V2B");
+    string vip_package = *sim.stations.at(station).buffer.begin();
+    for (const auto& package: sim.stations.at(station).buffer) {
+        // EXPRESS first
+        const bool vip_is_express = sim.packages[vip_package].category == PackageCategory::EXPRESS;
+        const bool package_is_express = sim.packages[package].category == PackageCategory::EXPRESS;
+        if (vip_is_express != package_is_express) {
+            if (package_is_express) {
+                vip_package = package;
+            }
+            continue;
+        }
+        if (sim.packages[package].time_created < sim.packages[vip_package].time_created) {
+            vip_package = package;
+        }
     }
+    return vip_package;
 }
 
-void V2TryProcessOne::process_event() {
+template<typename Policy>
+void V2TryProcessOne<Policy>::process_event() {
     // std::ofstream file("output.txt", std::ios::app);
     // std::ofstream file("output.txt", std::ios::app);
     // if is not dued
-    if (!this->sim.v2_cache.station_info[this->station].due_try_time.has_value()) {
+    if (!this->sim.policy.v2_cache.station_info[this->station].due_try_time.has_value()) {
         logs_cargo("Error", "station {} try to process one but no due time.");
         return;
     }
-    if (!rust::eq(this->sim.v2_cache.station_info[this->station].due_try_time.value(), this->time))
+    if (!rust::eq(
+            this->sim.policy.v2_cache.station_info[this->station].due_try_time.value(),
+            this->time
+        ))
     {
         logs_cargo(
             "Error",
             "station {} try to process one but due time is {}, cur time {}",
             this->station,
-            this->sim.v2_cache.station_info[this->station].due_try_time.value(),
+            this->sim.policy.v2_cache.station_info[this->station].due_try_time.value(),
             this->time
         );
         return;
     }
-    this->sim.v2_cache.station_info[this->station].due_try_time.reset();
+    this->sim.policy.v2_cache.station_info[this->station].due_try_time.reset();
 
-    std::ofstream number_package_in_station("number_package_in_station.csv", std::ios::app);
-    std::ofstream package_trip("package_trip.csv", std::ios::app);
 
     logs("[{:.3f}] {}] station {} try to process one.", this->time, this->station, this->station);
     // 根据吞吐量判断 StartProcess 间隔
@@ -193,50 +284,22 @@ void V2TryProcessOne::process_event() {
         return;
     }
     // [process success]
-    string vip_package = *this->sim.stations.at(this->station).buffer.begin();
-    if (this->sim.strategy_version == StrategyVersion::V2) {
-        for (const auto& package: this->sim.stations.at(this->station).buffer) {
-            if (this->sim.packages[package].time_created
-                < this->sim.packages[vip_package].time_created)
-            {
-                vip_package = package;
-            }
-        }
-    } else { // V2B
-        for (const auto& package: this->sim.stations.at(this->station).buffer) {
-            // if (this->sim.packages[package].time_created
-            //     < this->sim.packages[earlist_package].time_created)
-            // {
-            //     earlist_package = package;
-            // }
-            // EXPRESS first
-            const bool vip_is_express =
-                this->sim.packages[vip_package].category == PackageCategory::EXPRESS;
-            const bool package_is_express =
-                this->sim.packages[package].category == PackageCategory::EXPRESS;
-            if (vip_is_express != package_is_express) {
-                if (package_is_express) {
-                    vip_package = package;
-                }
-                continue;
-            }
-            if (this->sim.packages[package].time_created
-                < this->sim.packages[vip_package].time_created)
-            {
-                vip_package = package;
-            }
-        }
-    }
+    const string vip_package = this->sim.policy.select(this->sim, this->station);
 
     // use dijkstra
     auto path = [&]() {
         return fake_dijkstra(
             this->sim.stations,
-            this->sim.routes,
+            this->sim.routes(),
             this->station,
             this->sim.packages[vip_package].dst,
             this->time,
-            this->sim.v2_cache.station_plans
+            this->sim.policy.v2_cache.station_plans,
+            this->sim.policy.alt_graph_of(
+                this->sim.stations,
+                this->sim.routes(),
+                this->sim.shared_scenario()
+            )
         );
     }();
     if (path.size() == 0) {
@@ -254,16 +317,14 @@ void V2TryProcessOne::process_event() {
         // 会修改 ok_time
         this->sim.stations.at(this->station)
             .take_package_from_buffer_to_processing(vip_package, this->time);
-        for (const auto& [id, station]: this->sim.stations) {
-            number_package_in_station << this->time << "," << id << ","
-                                      << this->sim.stations.at(id).buffer.size() << "\n";
-        }
+        this->sim.record_decision(this->time, this->time, this->station, vip_package, -1);
+        this->sim.write_occupancy(this->time);
         // 终点不 due
-        // this->sim.v2_cache.station_plans.at().pop_due_pkg(earlist_package);
+        // this->sim.policy.v2_cache.station_plans.at().pop_due_pkg(earlist_package);
 
         // only station cost
         this->sim.add_transport_cost(this->sim.stations.at(this->station).cost);
-        this->sim.schedule_event(new V2StartSend(
+        this->sim.schedule_event(new V2StartSend<Policy>(
             // [todo]
             // 会预备一个 TryProcess，那么如何判断时间是否 ok?（注意精度问题）
             this->time + this->sim.stations.at(this->station).process_delay,
@@ -277,8 +338,7 @@ void V2TryProcessOne::process_event() {
             this->sim,
             this->station
         );
-        package_trip << this->time << "," << vip_package << "," << this->station << ","
-                     << this->station << "\n";
+        this->sim.write_trip(this->time, vip_package, this->station, this->station);
         return;
     }
     logs(
@@ -287,28 +347,26 @@ void V2TryProcessOne::process_event() {
         this->station,
         this->station,
         vip_package,
-        this->sim.routes.at(this->station).at(path[0]).dst
+        this->sim.routes().at(this->station).at(path[0]).dst
     );
     this->sim.stations.at(this->station)
         .take_package_from_buffer_to_processing(vip_package, this->time);
-    for (const auto& [id, station]: this->sim.stations) {
-        number_package_in_station << this->time << "," << id << ","
-                                  << this->sim.stations.at(id).buffer.size() << "\n";
-    }
+    this->sim.record_decision(this->time, this->time, this->station, vip_package, path[0]);
+    this->sim.write_occupancy(this->time);
     // choose path[0]
-    const string dst = this->sim.routes.at(this->station).at(path[0]).dst;
-    this->sim.add_transport_cost(this->sim.routes.at(this->station).at(path[0]).cost);
+    const string dst = this->sim.routes().at(this->station).at(path[0]).dst;
+    this->sim.add_transport_cost(this->sim.routes().at(this->station).at(path[0]).cost);
     this->sim.add_transport_cost(this->sim.stations.at(this->station).cost);
-    this->sim.schedule_event(new V2StartSend(
+    this->sim.schedule_event(new V2StartSend<Policy>(
         this->time + this->sim.stations.at(this->station).process_delay,
         this->sim,
         vip_package,
         this->station,
         path[0]
     ));
-    this->sim.v2_cache.station_plans.at(dst).add_due_pkg(
+    this->sim.policy.v2_cache.station_plans.at(dst).add_due_pkg(
         this->time + this->sim.stations.at(this->station).process_delay
-            + this->sim.routes.at(this->station).at(path[0]).time,
+            + this->sim.routes().at(this->station).at(path[0]).time,
         vip_package
     );
     try_due_try(
@@ -316,15 +374,18 @@ void V2TryProcessOne::process_event() {
         this->sim,
         this->station
     );
-    package_trip << this->time << "," << vip_package << "," << this->station << ","
-                 << this->sim.routes.at(this->station).at(path[0]).dst << "\n";
+    this->sim.write_trip(
+        this->time,
+        vip_package,
+        this->station,
+        this->sim.routes().at(this->station).at(path[0]).dst
+    );
 }
 
-void V2Arrival::process_event() {
+template<typename Policy>
+void V2Arrival<Policy>::process_event() {
     // std::ofstream file("output.txt", std::ios::app);
     // std::ofstream file("output.txt", std::ios::app);
-    std::ofstream number_package_in_station("number_package_in_station.csv", std::ios::app);
-    std::ofstream package_trip("package_trip.csv", std::ios::app);
 
     logs(
         "[{:.3f}] {}] Arrival pack {}: {}",
@@ -334,16 +395,13 @@ void V2Arrival::process_event() {
         this->station
     );
     if (!this->is_start) {
-        this->sim.v2_cache.station_plans.at(this->station).pop_due_pkg(this->time, this->package);
+        this->sim.policy.v2_cache.station_plans.at(this->station)
+            .pop_due_pkg(this->time, this->package);
     }
     this->sim.stations.at(this->station).buffer.insert(this->package);
 
-    for (const auto& [id, station]: this->sim.stations) {
-        number_package_in_station << this->time << "," << id << ","
-                                  << this->sim.stations.at(id).buffer.size() << "\n";
-    }
-    package_trip << this->time << "," << this->package << "," << this->station << ","
-                 << this->station << "\n";
+    this->sim.write_occupancy(this->time);
+    this->sim.write_trip(this->time, this->package, this->station, this->station);
     try_due_try(this->time, this->sim, this->station);
     // this->sim.schedule_event();
     // [test]
@@ -351,7 +409,8 @@ void V2Arrival::process_event() {
     // logs("[{:.3f}] buffer size: {}", this->time, this->sim.stations[this->station].buffer.size());
 }
 
-void V2StartSend::process_event() {
+template<typename Policy>
+void V2StartSend<Policy>::process_event() {
     // turn into fmt
     // std::ofstream file("output.txt", std::ios::app);
     if (this->sim.packages[this->package].dst == this->src) {
@@ -374,19 +433,26 @@ void V2StartSend::process_event() {
         this->src,
         this->package,
         this->src,
-        this->sim.routes.at(this->src).at(this->route).dst,
-        this->sim.routes.at(this->src).at(this->route).time
+        this->sim.routes().at(this->src).at(this->route).dst,
+        this->sim.routes().at(this->src).at(this->route).time
     );
-    this->sim.schedule_event(new V2Arrival(
+    this->sim.schedule_event(new V2Arrival<Policy>(
         // find src => dst route
-        this->time + this->sim.routes.at(this->src).at(this->route).time,
+        this->time + this->sim.routes().at(this->src).at(this->route).time,
         this->sim,
         this->package,
-        this->sim.routes.at(this->src).at(this->route).dst,
+        this->sim.routes().at(this->src).at(this->route).dst,
         false // not start
     ));
     // try process one right now (but after this StartSend guranteed by event push)
-    // this->sim.schedule_event(new V2TryProcessOne(this->time, this->sim, this->src));
+    // this->sim.schedule_event(new V2TryProcessOne<Policy>(this->time, this->sim, this->src));
 }
 
+template struct V2Arrival<V2Policy>;
+template struct V2Arrival<V2BPolicy>;
+template struct V2StartSend<V2Policy>;
+template struct V2StartSend<V2BPolicy>;
+template struct V2TryProcessOne<V2Policy>;
+template struct V2TryProcessOne<V2BPolicy>;
+
 } // namespace strategy::v2
@@ -3,21 +3,32 @@
 
 #include <limits>
 #include <map>
+#include <memory>
+#include <optional>
 #include <queue>
 #include <set>
 #include <sstream>
 
+#include "base.hpp"
 #include "event.hpp"
 #include "log.hpp"
 #include "rust.hpp"
+#include "strategy.hpp"
+#include "strategy/alt.hpp"
 
 namespace sim {
+template<typename Policy>
 struct Simulation;
 }
 
+namespace scenario {
+struct Scenario;
+}
+
 namespace strategy::v2 {
 
-using sim::Simulation;
+using base::Route;
+using base::Station;
 using std::greater;
 using std::map;
 using std::multiset;
@@ -27,24 +38,32 @@ using std::priority_queue;
 using std::string;
 using std::vector;
 
-using event::Event;
+using event::SimEvent;
 using log::logs;
 using log::logs_cargo;
 
 struct StationPlan {
     // double next_arrival_time;
-    StationPlan(string id, Simulation& sim): id(id), sim(sim) {}
+    explicit StationPlan(const Station& station): id(station.id), station(station) {}
 
     string id;
-    Simulation& sim;
+    const Station& station;
 
     priority_queue<pair<double, string>, vector<pair<double, string>>, greater<>>
         arrival_time_of_due_pkgs;
+    // 负载漂移：buffer 或 due 包裹每增减一个，等待时间估计至多变化 1 / throughput，累加于此
+    // 只增不减，两个时刻的差值是这段时间内估计变化量的上界
+    double drift = 0;
+
     // 视为开始 buffer 增加的时间
     double next_arrival_time() const;
     double estimated_wait_time(double now, double arrive_time) const;
     void add_due_pkg(double t, const string& id);
     void pop_due_pkg(double t, const string& id);
+    // buffer 增减一个包裹时调用；due 包裹的增减由 add_due_pkg / pop_due_pkg 自己记录
+    void note_load_change() {
+        this->drift += 1.0 / this->station.throughput;
+    }
 };
 
 struct StationInfo {
@@ -54,17 +73,68 @@ struct StationInfo {
 // for Simulation to store
 struct V2Cache {
     V2Cache() = default;
-    explicit V2Cache(Simulation& sim);
+    explicit V2Cache(const map<string, Station>& stations);
     map<string, StationPlan> station_plans;
     map<string, StationInfo> station_info;
+
+    void add_station(const Station& station);
 };
 
-struct V2Arrival: public Event {
+// 估计途经站点等待时间的 dijkstra，有 alt_graph 时用 landmark 下界做 A*
+vector<int> fake_dijkstra(
+    const map<string, Station>& stations,
+    const map<string, map<int, Route>>& routes,
+    string src,
+    string dst,
+    double start_process_time,
+    const map<string, StationPlan>& station_plans,
+    const alt::AltGraph* alt_graph = nullptr,
+    double money_coefficient = 1.0,
+    double time_coefficient = 1.667
+);
+
+// V2 / V2B 共用：边权含等待时间，只支持 DIJKSTRA 与 ALT，不能用静态预处理的 CH / 双向搜索
+struct WaitRouting {
+    RouteSearch search = RouteSearch::ALT;
+    std::shared_ptr<const alt::AltGraph> alt_graph;
+
+    // search 为 ALT 时第一次调用建立（或从共享场景取得）landmark 表，否则返回 nullptr
+    const alt::AltGraph* alt_graph_of(
+        const map<string, Station>& stations,
+        const map<string, map<int, Route>>& routes,
+        const scenario::Scenario* shared
+    );
+};
+
+// V2: 最早创建的包裹先处理，路径规划时估计途经站点的等待时间
+struct V2Policy: public WaitRouting {
+    using Sim = sim::Simulation<V2Policy>;
+
+    V2Cache v2_cache;
+
+    void add_station(Sim& sim, const string& id);
+    void add_order(Sim& sim, const string& id, double time, const string& src);
+    string select(Sim& sim, const string& station) const;
+};
+
+// V2B: 同 V2，但 EXPRESS 包裹优先
+struct V2BPolicy: public WaitRouting {
+    using Sim = sim::Simulation<V2BPolicy>;
+
+    V2Cache v2_cache;
+
+    void add_station(Sim& sim, const string& id);
+    void add_order(Sim& sim, const string& id, double time, const string& src);
+    string select(Sim& sim, const string& station) const;
+};
+
+template<typename Policy>
+struct V2Arrival: public SimEvent<sim::Simulation<Policy>> {
 public:
-    V2Arrival(double t, Simulation& sim, string package, string dst, bool is_start):
-        Event(t, sim),
-        package(package),
-        station(dst),
+    V2Arrival(double t, sim::Simulation<Policy>& sim, string package, string dst, bool is_start):
+        SimEvent<sim::Simulation<Policy>>(t, sim),
+        package(std::move(package)),
+        station(std::move(dst)),
         is_start(is_start) {}
 
     void process_event() override;
@@ -77,12 +147,13 @@ private:
 
 // [可能是送原地，即完成配送]
 // EndProcess
-struct V2StartSend: public Event {
+template<typename Policy>
+struct V2StartSend: public SimEvent<sim::Simulation<Policy>> {
 public:
-    V2StartSend(double t, Simulation& sim, string package, string src, int route):
-        Event(t, sim),
-        package(package),
-        src(src),
+    V2StartSend(double t, sim::Simulation<Policy>& sim, string package, string src, int route):
+        SimEvent<sim::Simulation<Policy>>(t, sim),
+        package(std::move(package)),
+        src(std::move(src)),
         route(route) {}
 
     void process_event() override;
@@ -94,15 +165,26 @@ private:
 };
 
 // 检查 buffer 和从 buffer 中拿出内容 buffer 必须在同一个 event
-struct V2TryProcessOne: public Event {
+template<typename Policy>
+struct V2TryProcessOne: public SimEvent<sim::Simulation<Policy>> {
 private:
     string station;
 
 public:
-    V2TryProcessOne(double t, Simulation& sim, string station): Event(t, sim), station(station) {}
+    V2TryProcessOne(double t, sim::Simulation<Policy>& sim, string station):
+        SimEvent<sim::Simulation<Policy>>(t, sim),
+        station(std::move(station)) {}
 
     void process_event() override;
 };
 
+// 定义与显式实例化见 v2.cpp
+extern template struct V2Arrival<V2Policy>;
+extern template struct V2Arrival<V2BPolicy>;
+extern template struct V2StartSend<V2Policy>;
+extern template struct V2StartSend<V2BPolicy>;
+extern template struct V2TryProcessOne<V2Policy>;
+extern template struct V2TryProcessOne<V2BPolicy>;
+
 } // namespace strategy::v2
 #endif
@@ -1,8 +1,15 @@
 #include "strategy/v3.hpp"
 
+#include <algorithm>
+#include <cstdlib>
+#include <memory_resource>
+#include <thread>
+
+#include "arena.hpp"
 #include "base.hpp"
 #include "eval.hpp"
 #include "log.hpp"
+#include "profile.hpp"
 #include "sim.hpp"
 #include "strategy.hpp"
 #include "strategy/v2.hpp"
@@ -12,35 +19,88 @@ namespace strategy::v3 {
 using std::make_pair;
 using strategy::v2::StationPlan;
 
+void V3Policy::add_station(Sim& sim, const string& id) {
+    this->v2_cache.add_station(sim.stations.at(id));
+    this->buffer_index.emplace(id, BufferIndex());
+}
+
+void V3Policy::add_order(Sim& sim, const string& id, double time, const string& src) {
+    sim.schedule_event(new V3Arrival(time, sim, id, src, true));
+}
+
+TreeKernel V3Policy::kernel_of(const Sim& sim) const {
+    if (this->tree_kernel != TreeKernel::AUTO) {
+        return this->tree_kernel;
+    }
+    int route_cnt = 0;
+    for (const auto& [src, edges]: sim.routes()) {
+        route_cnt += edges.size();
+    }
+    if (dense::prefer_dense(sim.stations.size(), route_cnt)) {
+        return TreeKernel::DENSE;
+    }
+    return TreeKernel::DELTA;
+}
+
+const dense::DenseGraph* V3Policy::dense_graph_of(const Sim& sim) {
+    std::call_once(this->dense_once, [&] {
+        if (this->kernel_of(sim) != TreeKernel::DENSE) {
+            return;
+        }
+        const scenario::Scenario* shared = sim.shared_scenario();
+        this->dense_graph = shared != nullptr
+            ? shared->dense_graph()
+            : std::make_shared<const dense::DenseGraph>(sim.stations, sim.routes());
+    });
+    return this->dense_graph.get();
+}
+
+const delta::CsrGraph* V3Policy::csr_graph_of(const Sim& sim) {
+    std::call_once(this->csr_once, [&] {
+        if (this->kernel_of(sim) != TreeKernel::DELTA) {
+            return;
+        }
+        const scenario::Scenario* shared = sim.shared_scenario();
+        this->csr_graph = shared != nullptr
+            ? shared->csr_graph()
+            : std::make_shared<const delta::CsrGraph>(sim.stations, sim.routes());
+        const int threads = this->route_threads >= 0
+            ? this->route_threads
+            : std::max(0, (int)std::thread::hardware_concurrency() - 1);
+        if (threads > 0 && delta::prefer_parallel(sim.stations.size())) {
+            this->workers = std::make_unique<pool::WorkerPool>(threads);
+        }
+    });
+    return this->csr_graph.get();
+}
+
 void try_due_try(double t, Simulation& sim, string station) {
     // check cached due time
-    if (!sim.v2_cache.station_info.at(station).due_try_time.has_value()) {
-        sim.v2_cache.station_info.at(station).due_try_time = t;
+    if (!sim.policy.v2_cache.station_info.at(station).due_try_time.has_value()) {
+        sim.policy.v2_cache.station_info.at(station).due_try_time = t;
         sim.schedule_event(new V3TryProcessOne(t, sim, station));
     }
-    if (t < sim.v2_cache.station_info.at(station).due_try_time) {
-        sim.v2_cache.station_info.at(station).due_try_time = t;
+    if (t < sim.policy.v2_cache.station_info.at(station).due_try_time) {
+        sim.policy.v2_cache.station_info.at(station).due_try_time = t;
         sim.schedule_event(new V3TryProcessOne(t, sim, station));
         return;
     }
 }
 
-struct DijRes {
-    map<string, pair<string, int>> prev;
-    map<string, double> start_send_time_at_min_cost;
-};
-
-DijRes dijkstra_tree(
+// probes 非空时记录每次等待时间估计；推测执行时在其他线程调用，不写日志与计时
+DijRes search_tree(
     const map<string, Station>& stations,
     const map<string, map<int, Route>>& routes,
-    string src,
+    const string& src,
     double start_process_time,
     const map<string, StationPlan>& station_plans,
+    vector<WaitProbe>* probes,
     double money_coefficient = 1.0,
     double time_coefficient = 1.667
 ) {
-    logs_cargo("Info", "legend_dijkstra called");
-    map<string, double> cost;
+    // 返回的 prev 与时间表留在普通堆上，其余临时数据放在 scratch 中
+    arena::Scope scope;
+    std::pmr::map<string, double> cost(arena::scratch());
     map<string, double> start_send_time_at_min_cost;
     map<string, pair<string, int>> prev; // nodes' prev station and route
     for (const auto& [id, station]: stations) {
@@ -50,7 +110,9 @@ DijRes dijkstra_tree(
     cost[src] = 0;
     start_send_time_at_min_cost[src] = start_process_time + stations.at(src).process_delay;
     // priority_queue<pair<double, string>> q;
-    priority_queue<pair<double, string>, vector<pair<double, string>>, greater<>> q;
+    priority_queue<pair<double, string>, std::pmr::vector<pair<double, string>>, greater<>> q(
+        arena::scratch()
+    );
 
     q.push(make_pair(0, src));
     while (!q.empty()) {
@@ -60,13 +122,16 @@ DijRes dijkstra_tree(
             continue;
         }
         // if not found, edges is empty
-        auto edges = routes.find(u) == routes.end() ? map<int, Route> {} : routes.at(u);
+        const auto& edges = out_routes(routes, u);
         for (const auto& route: edges) {
             string v = route.second.dst;
-            const double estimated_wait_time = station_plans.at(v).estimated_wait_time(
-                start_send_time_at_min_cost.at(u),
-                start_send_time_at_min_cost.at(u) + route.second.time
-            );
+            const StationPlan& plan = station_plans.at(v);
+            const double now = start_send_time_at_min_cost.at(u);
+            const double estimated_wait_time =
+                plan.estimated_wait_time(now, now + route.second.time);
+            if (probes != nullptr) {
+                probes->push_back({ &plan, now, now + route.second.time, estimated_wait_time });
+            }
             // logs_cargo("Info", "{}", estimated_wait_time);
             double time_gonna_be_spent =
                 route.second.time + estimated_wait_time + stations.at(v).process_delay;
@@ -97,34 +162,524 @@ DijRes dijkstra_tree(
     return { prev, start_send_time_at_min_cost };
 }
 
+DijRes dijkstra_tree(
+    const map<string, Station>& stations,
+    const map<string, map<int, Route>>& routes,
+    string src,
+    double start_process_time,
+    const map<string, StationPlan>& station_plans,
+    double money_coefficient,
+    double time_coefficient
+) {
+    logs_cargo("Info", "legend_dijkstra called");
+    PROFILE_SCOPE("route/dijkstra_tree");
+    return search_tree(
+        stations,
+        routes,
+        src,
+        start_process_time,
+        station_plans,
+        nullptr,
+        money_coefficient,
+        time_coefficient
+    );
+}
+
+namespace {
+
+// 按下标的树转为按 id 的 DijRes；Graph 为 DenseGraph 或 CsrGraph
+template<typename Graph>
+DijRes tree_res(const Graph& graph, const dense::Tree& tree) {
+    DijRes res;
+    for (int v = 0; v < graph.size(); v++) {
+        res.start_send_time_at_min_cost.emplace_hint(
+            res.start_send_time_at_min_cost.end(),
+            graph.name_of(v),
+            tree.start_send[v]
+        );
+        if (tree.prev[v] != -1) {
+            res.prev.emplace_hint(
+                res.prev.end(),
+                graph.name_of(v),
+                make_pair(graph.name_of(tree.prev[v]), tree.route[v])
+            );
+        }
+    }
+    return res;
+}
+
+vector<const StationPlan*> plans_by_index(const map<string, StationPlan>& station_plans) {
+    vector<const StationPlan*> plans;
+    for (const auto& [id, plan]: station_plans) {
+        plans.push_back(&plan);
+    }
+    return plans;
+}
+
+} // namespace
+
+DijRes dense_tree(
+    const dense::DenseGraph& graph,
+    const string& src,
+    double start_process_time,
+    const map<string, StationPlan>& station_plans,
+    vector<WaitProbe>* probes,
+    double money_coefficient,
+    double time_coefficient
+) {
+    const dense::Tree tree = dense::wait_tree(
+        graph,
+        graph.index_of(src),
+        start_process_time,
+        station_plans,
+        money_coefficient,
+        time_coefficient
+    );
+    if (probes == nullptr) {
+        return tree_res(graph, tree);
+    }
+    // 堆版本在 settle 每个站点时估计其所有出边；settle 后出发时间不再变化，事后补记结果相同
+    const vector<const StationPlan*> plans = plans_by_index(station_plans);
+    const int n = graph.size();
+    for (int u = 0; u < n; u++) {
+        const double now = tree.start_send[u];
+        if (now == std::numeric_limits<double>::max()) {
+            continue;
+        }
+        for (int layer = 0; layer < graph.layers; layer++) {
+            const int at = graph.row(layer, u);
+            for (int v = 0; v < n; v++) {
+                if (graph.route[at + v] == -1) {
+                    continue;
+                }
+                const double arrive_time = now + graph.time[at + v];
+                const double wait = plans[v]->estimated_wait_time(now, arrive_time);
+                probes->push_back({ plans[v], now, arrive_time, wait });
+            }
+        }
+    }
+    return tree_res(graph, tree);
+}
+
+DijRes delta_tree(
+    const delta::CsrGraph& graph,
+    const string& src,
+    double start_process_time,
+    const map<string, StationPlan>& station_plans,
+    pool::WorkerPool* workers,
+    vector<WaitProbe>* probes,
+    double money_coefficient,
+    double time_coefficient
+) {
+    const dense::Tree tree = delta::wait_tree(
+        graph,
+        graph.index_of(src),
+        start_process_time,
+        station_plans,
+        workers,
+        money_coefficient,
+        time_coefficient
+    );
+    if (probes == nullptr) {
+        return tree_res(graph, tree);
+    }
+    // 同 dense_tree，事后按 settle 时的出发时间补记
+    const vector<const StationPlan*> plans = plans_by_index(station_plans);
+    for (int u = 0; u < graph.size(); u++) {
+        const double now = tree.start_send[u];
+        if (now == std::numeric_limits<double>::max()) {
+            continue;
+        }
+        for (int e = graph.first[u]; e < graph.first[u + 1]; e++) {
+            const StationPlan* plan = plans[graph.to[e]];
+            const double arrive_time = now + graph.time[e];
+            probes->push_back({ plan, now, arrive_time, plan->estimated_wait_time(now, arrive_time) });
+        }
+    }
+    return tree_res(graph, tree);
+}
+
+// 按 policy 选用的核建树，probes 含义同 search_tree；probes 非空时可能在其他线程调用，不计时
+DijRes build_tree(Simulation& sim, const string& src, double time, vector<WaitProbe>* probes) {
+    const auto& plans = sim.policy.v2_cache.station_plans;
+    const dense::DenseGraph* graph = sim.policy.dense_graph_of(sim);
+    if (graph != nullptr && probes == nullptr) {
+        PROFILE_SCOPE("route/dense_tree");
+        return dense_tree(*graph, src, time, plans);
+    }
+    if (graph != nullptr) {
+        return dense_tree(*graph, src, time, plans, probes);
+    }
+    const delta::CsrGraph* csr = sim.policy.csr_graph_of(sim);
+    if (csr != nullptr && probes == nullptr) {
+        PROFILE_SCOPE("route/delta_tree");
+        return delta_tree(*csr, src, time, plans, sim.policy.route_workers());
+    }
+    // 推测执行本身已在工作线程上，不再分给并行核的线程
+    if (csr != nullptr) {
+        return delta_tree(*csr, src, time, plans, nullptr, probes);
+    }
+    if (probes == nullptr) {
+        return dijkstra_tree(sim.stations, sim.routes(), src, time, plans);
+    }
+    return search_tree(sim.stations, sim.routes(), src, time, plans, probes);
+}
+
+bool Speculation::valid() const {
+    for (const auto& probe: this->probes) {
+        if (probe.plan->estimated_wait_time(probe.now, probe.arrive_time) != probe.wait) {
+            return false;
+        }
+    }
+    return true;
+}
+
+double CachedTree::drift() const {
+    double res = -this->drift_base;
+    for (const v2::StationPlan* plan: this->touched) {
+        res += plan->drift;
+    }
+    return res;
+}
+
+void CachedTree::track(const vector<WaitProbe>& probes) {
+    this->touched.clear();
+    for (const auto& probe: probes) {
+        this->touched.push_back(probe.plan);
+    }
+    // 按站点 id 排序，drift() 的求和顺序不随内存地址变化，同一数据的多次模拟结果相同
+    std::sort(
+        this->touched.begin(),
+        this->touched.end(),
+        [](const v2::StationPlan* a, const v2::StationPlan* b) { return a->id < b->id; }
+    );
+    this->touched.erase(
+        std::unique(this->touched.begin(), this->touched.end()),
+        this->touched.end()
+    );
+    this->drift_base = 0;
+    this->drift_base = this->drift();
+}
+
+void CachedTree::advance(double now) {
+    const double delta = now - this->time;
+    for (auto& [id, t]: this->tree.start_send_time_at_min_cost) {
+        if (t != std::numeric_limits<double>::max()) {
+            t += delta;
+        }
+    }
+    this->time = now;
+}
+
+double ddl_of(const Package& pkg) {
+    return pkg.time_created
+        + (pkg.category == PackageCategory::EXPRESS ? eval::V1_EXPRESS_DDL_HOURS
+                                                    : eval::V1_STANDARD_DDL_HOURS);
+}
+
+void DstGroup::add(const Package& pkg) {
+    this->by_ddl.emplace_back(ddl_of(pkg), pkg.id);
+    std::push_heap(this->by_ddl.begin(), this->by_ddl.end(), greater<>());
+    this->size += 1;
+}
+
+void DstGroup::remove(const Package& pkg) {
+    this->size -= 1;
+    // 通常删除的是组头，在堆顶时直接弹出，不必记下
+    if (this->head().second == pkg.id) {
+        this->pop();
+    } else {
+        this->stale[pkg.id] += 1;
+    }
+    this->purge();
+}
+
+void DstGroup::pop() {
+    std::pop_heap(this->by_ddl.begin(), this->by_ddl.end(), greater<>());
+    this->by_ddl.pop_back();
+}
+
+void DstGroup::purge() {
+    while (!this->by_ddl.empty()) {
+        auto it = this->stale.find(this->head().second);
+        if (it == this->stale.end()) {
+            return;
+        }
+        // 删除后又加入的包裹在堆中有相同的两项，弹出哪一项都一样
+        if (--it->second == 0) {
+            this->stale.erase(it);
+        }
+        this->pop();
+    }
+}
+
+void BufferIndex::add(const Package& pkg) {
+    this->groups[pkg.dst].add(pkg);
+}
+
+void BufferIndex::remove(const Package& pkg) {
+    auto it = this->groups.find(pkg.dst);
+    if (it == this->groups.end() || it->second.size == 0) {
+        logs_cargo("Error", "package {} is not in the buffer index", pkg.id);
+        std::abort();
+    }
+    it->second.remove(pkg);
+    if (it->second.size == 0) {
+        this->groups.erase(it);
+    }
+}
+
+// 若现在开始处理，组内 DDL 最早的包裹到达终点时距离 DDL 还剩多少时间
+// 同一终点的估计到达时间相同，组内余量最小者即 DDL 最早者
+pair<double, string> group_head(const DijRes& tree, const string& dst, const DstGroup& group) {
+    const auto& [ddl, package] = group.head();
+    return make_pair(ddl - tree.start_send_time_at_min_cost.at(dst), package);
+}
+
+// 按 tree 选出的包裹及其第一跳路线（已在终点时为 -1）
+// 只比较每个终点组的组头：余量最小者优先，相同时取 id 较小者，与逐个遍历 buffer 一致
+pair<string, int> choose(const DijRes& tree, const BufferIndex& index, const string& station) {
+    PROFILE_SCOPE("select/V3");
+    pair<double, string> vip =
+        group_head(tree, index.groups.begin()->first, index.groups.begin()->second);
+    string dst = index.groups.begin()->first;
+    for (const auto& [group_dst, group]: index.groups) {
+        auto head = group_head(tree, group_dst, group);
+        if (head < vip) {
+            vip = std::move(head);
+            dst = group_dst;
+        }
+    }
+    // 沿树回溯到第一跳
+    int first_route = -1;
+    for (string at = dst; at != station;) {
+        auto [from, route] = tree.prev.at(at);
+        first_route = route;
+        at = from;
+    }
+    return make_pair(vip.second, first_route);
+}
+
+// 从 buffer 取出 package 在 start 开始处理，同步 BufferIndex 与负载漂移
+void take_package(Simulation& sim, const string& station, const string& package, double start) {
+    // 会修改 ok_time
+    sim.stations.at(station).take_package_from_buffer_to_processing(package, start);
+    sim.policy.buffer_index.at(station).remove(sim.packages[package]);
+    sim.policy.v2_cache.station_plans.at(station).note_load_change();
+}
+
+// 站点下一次能开始处理的时间：批中决定的包裹还没全部开始处理时，为最后一个之后
+double ready_time(const Simulation& sim, const string& station) {
+    const double ok_time = sim.stations.at(station).start_process_ok_time;
+    const auto it = sim.policy.batch_ready.find(station);
+    return it == sim.policy.batch_ready.end() ? ok_time : std::max(ok_time, it->second);
+}
+
+// 取出所有在 now 之前开始处理的批中包裹，与逐个处理时在 start 的取出完全相同：
+// 离开 buffer 与 BufferIndex、写占用与行程、登记到下一站的预计到达
+// 每个 V3 事件处理前调用，保证其他事件看到的 buffer 与等待估计和不批处理时一致
+void flush_takes(Simulation& sim, double now) {
+    auto& pending = sim.policy.pending_takes;
+    while (!pending.empty() && rust::time_ok(now, pending.top().start)) {
+        const PendingTake take = pending.top();
+        pending.pop();
+        take_package(sim, take.station, take.package, take.start);
+        sim.write_occupancy(take.start);
+        if (take.route == -1) {
+            sim.write_trip(take.start, take.package, take.station, take.station);
+            continue;
+        }
+        const Route& route = sim.routes().at(take.station).at(take.route);
+        sim.policy.v2_cache.station_plans.at(route.dst).add_due_pkg(
+            take.start + sim.stations.at(take.station).process_delay + route.time,
+            take.package
+        );
+        sim.write_trip(take.start, take.package, take.station, route.dst);
+    }
+}
+
+// 批处理：一次唤醒决定所有能在 [time, time + batch_window) 内开始处理的包裹
+// 所有包裹共用同一棵 dijkstra_tree，按 DDL 余量依次出堆，各自保留精确的开始处理时间
+// 包裹到各自的开始处理时间才由 flush_takes 取出；转发的包裹直接排定到下一站的 Arrival，
+// 省掉 StartSend。Arrival 各有各的时间无法合并，但批处理期间到达的包裹不再各自唤醒一次
+void process_batch(
+    Simulation& sim,
+    const string& station_id,
+    double time,
+    const DijRes& tree
+) {
+    // 堆放在 scratch 中，整个批次是一次决策
+    arena::Scope scope;
+    const Station& station = sim.stations.at(station_id);
+    BufferIndex& index = sim.policy.buffer_index.at(station_id);
+    // 与逐个处理一致：余量最小者优先，相同时取 id 较小者
+    // 堆中每个终点组只放组头，出堆后补上该组的新组头
+    priority_queue<pair<double, string>, std::pmr::vector<pair<double, string>>, greater<>> q(
+        arena::scratch()
+    );
+    for (const auto& [dst, group]: index.groups) {
+        q.push(group_head(tree, dst, group));
+    }
+    // 决定的包裹先从索引中移出以得到组内下一个组头，决定完再放回，到开始处理时间才真正取出
+    std::pmr::vector<const Package*> decided(arena::scratch());
+    const double batch_end_time = time + sim.policy.batch_window;
+    double start_time = time;
+    while (!q.empty() && !rust::time_ok(start_time, batch_end_time)) {
+        const string vip_package = q.top().second;
+        q.pop();
+        const Package& package = sim.packages[vip_package];
+        const string& dst = package.dst;
+        index.remove(package);
+        decided.push_back(&package);
+        if (index.groups.find(dst) != index.groups.end()) {
+            q.push(group_head(tree, dst, index.groups.at(dst)));
+        }
+        int first_route = -1;
+        if (dst == station_id) {
+            sim.record_decision(time, start_time, station_id, vip_package, -1);
+            // only station cost
+            sim.add_transport_cost(station.cost);
+            sim.schedule_event(new V3StartSend(
+                start_time + station.process_delay,
+                sim,
+                vip_package,
+                station_id,
+                -1
+            ));
+        } else {
+            // 沿树回溯到第一跳
+            for (string at = dst; at != station_id;) {
+                auto [from, route] = tree.prev.at(at);
+                first_route = route;
+                at = from;
+            }
+            sim.record_decision(time, start_time, station_id, vip_package, first_route);
+            const Route& route = sim.routes().at(station_id).at(first_route);
+            sim.add_transport_cost(route.cost);
+            sim.add_transport_cost(station.cost);
+            sim.schedule_event(new V3Arrival(
+                start_time + station.process_delay + route.time,
+                sim,
+                vip_package,
+                route.dst,
+                false // not start
+            ));
+        }
+        sim.policy.pending_takes.push(PendingTake {
+            start_time,
+            sim.policy.take_seq++,
+            station_id,
+            vip_package,
+            first_route,
+        });
+        // 与 take_package_from_buffer_to_processing 更新 ok_time 的方式相同
+        start_time += 1.0 / station.throughput;
+    }
+    for (const Package* package: decided) {
+        index.add(*package);
+    }
+    sim.policy.batch_ready[station_id] = start_time;
+    logs(
+        "[{:.3f}] {}] station {} processed a batch of {} packages.",
+        time,
+        station_id,
+        station_id,
+        decided.size()
+    );
+    // 第一个包裹现在就开始处理
+    flush_takes(sim, time);
+    try_due_try(start_time, sim, station_id);
+}
+
+bool V3TryProcessOne::speculative() const {
+    // 近似重规划本身就少建树，不再推测执行
+    if (this->sim.policy.replan_tolerance > 0) {
+        return false;
+    }
+    // 与 process_event 的前置检查相同；状态在轮到它之前变化时 process_event 会自己搜索
+    const Station& station = this->sim.stations.at(this->station);
+    const auto& due = this->sim.policy.v2_cache.station_info.at(this->station).due_try_time;
+    return due.has_value() && rust::eq(due.value(), this->time)
+        && rust::time_ok(this->time, ready_time(this->sim, this->station))
+        && !station.buffer.empty();
+}
+
+void V3TryProcessOne::speculate() {
+    auto speculation = std::make_unique<Speculation>();
+    speculation->tree = build_tree(this->sim, this->station, this->time, &speculation->probes);
+    this->speculation = std::move(speculation);
+}
+
+const DijRes& V3TryProcessOne::routing_tree() {
+    V3Policy& policy = this->sim.policy;
+    CachedTree& cached = policy.trees[this->station];
+    const bool approximate = policy.replan_tolerance > 0;
+    if (approximate && this->time - cached.time < policy.replan_max_age
+        && cached.drift() < policy.replan_tolerance)
+    {
+        cached.advance(this->time);
+        policy.replan_stats.reused += 1;
+        if (policy.replan_audit) {
+            const BufferIndex& index = policy.buffer_index.at(this->station);
+            const DijRes exact = build_tree(this->sim, this->station, this->time, nullptr);
+            policy.replan_stats.audited += 1;
+            policy.replan_stats.agreed += choose(cached.tree, index, this->station)
+                == choose(exact, index, this->station);
+        }
+        return cached.tree;
+    }
+    policy.replan_stats.built += 1;
+    cached.time = this->time;
+    if (this->speculation != nullptr) {
+        this->sim.speculated += 1;
+        if (this->speculation->valid()) {
+            this->sim.speculation_hits += 1;
+            logs_cargo("Info", "legend_dijkstra speculated");
+            cached.tree = std::move(this->speculation->tree);
+            return cached.tree;
+        }
+    }
+    if (approximate) {
+        logs_cargo("Info", "legend_dijkstra called");
+        vector<WaitProbe> probes;
+        cached.tree = build_tree(this->sim, this->station, this->time, &probes);
+        cached.track(probes);
+        return cached.tree;
+    }
+    cached.tree = build_tree(this->sim, this->station, this->time, nullptr);
+    return cached.tree;
+}
+
 void V3TryProcessOne::process_event() {
     // std::ofstream file("output.txt", std::ios::app);
     // std::ofstream file("output.txt", std::ios::app);
+    flush_takes(this->sim, this->time);
     // if is not dued
-    if (!this->sim.v2_cache.station_info[this->station].due_try_time.has_value()) {
+    if (!this->sim.policy.v2_cache.station_info[this->station].due_try_time.has_value()) {
         logs_cargo("Error", "station {} try to process one but no due time.");
         return;
     }
-    if (!rust::eq(this->sim.v2_cache.station_info[this->station].due_try_time.value(), this->time))
+    if (!rust::eq(
+            this->sim.policy.v2_cache.station_info[this->station].due_try_time.value(),
+            this->time
+        ))
     {
         logs_cargo(
             "Error",
             "station {} try to process one but due time is {}, cur time {}",
             this->station,
-            this->sim.v2_cache.station_info[this->station].due_try_time.value(),
+            this->sim.policy.v2_cache.station_info[this->station].due_try_time.value(),
             this->time
         );
         return;
     }
-    this->sim.v2_cache.station_info[this->station].due_try_time.reset();
+    this->sim.policy.v2_cache.station_info[this->station].due_try_time.reset();
 
-    std::ofstream number_package_in_station("number_package_in_station.csv", std::ios::app);
-    std::ofstream package_trip("package_trip.csv", std::ios::app);
 
     logs("[{:.3f}] {}] station {} try to process one.", this->time, this->station, this->station);
     // 根据吞吐量判断 StartProcess 间隔
     // [处理 cd]
-    if (!rust::time_ok(this->time, this->sim.stations.at(this->station).start_process_ok_time)) {
+    if (!rust::time_ok(this->time, ready_time(this->sim, this->station))) {
         // gg
         logs(
             "[{:.3f}] {}] station {} failed to process one package, because start-process is in cd",
@@ -134,11 +689,7 @@ void V3TryProcessOne::process_event() {
         );
         // when cd is ok, try again
         // [todo]
-        try_due_try(
-            this->sim.stations.at(this->station).start_process_ok_time,
-            this->sim,
-            this->station
-        );
+        try_due_try(ready_time(this->sim, this->station), this->sim, this->station);
         return;
     }
     // [没东西]
@@ -167,53 +718,18 @@ void V3TryProcessOne::process_event() {
     //         this->station,
     //         this->sim.packages[pkg].dst,
     //         this->time,
-    //         this->sim.v2_cache.station_plans
+    //         this->sim.policy.v2_cache.station_plans
     //     );
     //     return ImTooLazy { res, res.start_send_time_at_min_cost.at(this->sim.packages[pkg].dst) };
     // };
-    auto tree = dijkstra_tree(
-        this->sim.stations,
-        this->sim.routes,
-        this->station,
-        this->time,
-        this->sim.v2_cache.station_plans
-    );
-    auto estimated_time_to_ddl_if_process_now = [&](const string& pkg) {
-        const double ddl = this->sim.packages[pkg].time_created
-            + (this->sim.packages[pkg].category == PackageCategory::EXPRESS
-                   ? eval::V1_EXPRESS_DDL_HOURS
-                   : eval::V1_STANDARD_DDL_HOURS);
-        return ddl - tree.start_send_time_at_min_cost.at(this->sim.packages[pkg].dst);
-    };
-    string vip_package = *this->sim.stations.at(this->station).buffer.begin();
-    // auto vip_lazy = estimated_time_to_ddl_if_process_now(vip_package);
-    // log::ecargo("V3", "---", vip_lazy.time_to_ddl);
-    // log::ecargo("V3", "{}", vip_lazy.time_to_ddl);
-    double vip_time_to_ddl = estimated_time_to_ddl_if_process_now(vip_package);
-    for (const auto& package: this->sim.stations.at(this->station).buffer) {
-        if (package == vip_package) {
-            continue;
-        }
-        const double time_to_ddl = estimated_time_to_ddl_if_process_now(package);
-        // log::ecargo("V3", "{} {}", package, time_to_ddl);
-        if (time_to_ddl < vip_time_to_ddl) {
-            vip_package = package;
-            vip_time_to_ddl = time_to_ddl;
-        }
+    const DijRes& tree = this->routing_tree();
+    if (this->sim.policy.batch_window > 0) {
+        process_batch(this->sim, this->station, this->time, tree);
+        return;
     }
-    // use dijkstra
-    const vector<int> path = [&]() {
-        vector<int> path;
-        for (string at = this->sim.packages[vip_package].dst; at != this->station;) {
-            auto [from, route] = tree.prev.at(at);
-            // logs("from: {}, route: {}", from, route);
-            path.push_back(route);
-            at = from;
-        }
-        std::reverse(path.begin(), path.end());
-        return path;
-    }();
-    if (path.size() == 0) {
+    const auto [vip_package, first_route] =
+        choose(tree, this->sim.policy.buffer_index.at(this->station), this->station);
+    if (first_route == -1) {
         // already at src
         logs(
             "[{:.3f}] {}] station {} is already at the src of {}, final process and SENT.",
@@ -225,15 +741,11 @@ void V3TryProcessOne::process_event() {
         assert(this->station == this->sim.packages[vip_package].dst);
         // this->sim.stations[this->station].buffer.erase(earliest);
         // this->sim.stations[this->station].processing_package = earliest;
-        // 会修改 ok_time
-        this->sim.stations.at(this->station)
-            .take_package_from_buffer_to_processing(vip_package, this->time);
-        for (const auto& [id, station]: this->sim.stations) {
-            number_package_in_station << this->time << "," << id << ","
-                                      << this->sim.stations.at(id).buffer.size() << "\n";
-        }
+        take_package(this->sim, this->station, vip_package, this->time);
+        this->sim.record_decision(this->time, this->time, this->station, vip_package, -1);
+        this->sim.write_occupancy(this->time);
         // 终点不 due
-        // this->sim.v2_cache.station_plans.at().pop_due_pkg(earlist_package);
+        // this->sim.policy.v2_cache.station_plans.at().pop_due_pkg(earlist_package);
 
         // only station cost
         this->sim.add_transport_cost(this->sim.stations.at(this->station).cost);
@@ -251,11 +763,10 @@ void V3TryProcessOne::process_event() {
             this->sim,
             this->station
         );
-        package_trip << this->time << "," << vip_package << "," << this->station << ","
-                     << this->station << "\n";
+        this->sim.write_trip(this->time, vip_package, this->station, this->station);
         return;
     }
-    const string next_dst = this->sim.routes.at(this->station).at(path[0]).dst;
+    const string next_dst = this->sim.routes().at(this->station).at(first_route).dst;
     logs(
         "[{:.3f}] {}] station {} process {} and send to station {}.",
         this->time,
@@ -264,26 +775,21 @@ void V3TryProcessOne::process_event() {
         vip_package,
         next_dst
     );
-    this->sim.stations.at(this->station)
-        .take_package_from_buffer_to_processing(vip_package, this->time);
-    for (const auto& [id, station]: this->sim.stations) {
-        number_package_in_station << this->time << "," << id << ","
-                                  << this->sim.stations.at(id).buffer.size() << "\n";
-    }
-    // choose path[0]
-    // const string dst = this->sim.routes.at(this->station).at(path[0]).dst;
-    this->sim.add_transport_cost(this->sim.routes.at(this->station).at(path[0]).cost);
+    take_package(this->sim, this->station, vip_package, this->time);
+    this->sim.record_decision(this->time, this->time, this->station, vip_package, first_route);
+    this->sim.write_occupancy(this->time);
+    this->sim.add_transport_cost(this->sim.routes().at(this->station).at(first_route).cost);
     this->sim.add_transport_cost(this->sim.stations.at(this->station).cost);
     this->sim.schedule_event(new V3StartSend(
         this->time + this->sim.stations.at(this->station).process_delay,
         this->sim,
         vip_package,
         this->station,
-        path[0]
+        first_route
     ));
-    this->sim.v2_cache.station_plans.at(next_dst).add_due_pkg(
+    this->sim.policy.v2_cache.station_plans.at(next_dst).add_due_pkg(
         this->time + this->sim.stations.at(this->station).process_delay
-            + this->sim.routes.at(this->station).at(path[0]).time,
+            + this->sim.routes().at(this->station).at(first_route).time,
         vip_package
     );
     try_due_try(
@@ -291,15 +797,18 @@ void V3TryProcessOne::process_event() {
         this->sim,
         this->station
     );
-    package_trip << this->time << "," << vip_package << "," << this->station << ","
-                 << this->sim.routes.at(this->station).at(path[0]).dst << "\n";
+    this->sim.write_trip(
+        this->time,
+        vip_package,
+        this->station,
+        this->sim.routes().at(this->station).at(first_route).dst
+    );
 }
 
 void V3Arrival::process_event() {
     // std::ofstream file("output.txt", std::ios::app);
     // std::ofstream file("output.txt", std::ios::app);
-    std::ofstream number_package_in_station("number_package_in_station.csv", std::ios::app);
-    std::ofstream package_trip("package_trip.csv", std::ios::app);
+    flush_takes(this->sim, this->time);
 
     logs(
         "[{:.3f}] {}] Arrival pack {}: {}",
@@ -309,17 +818,23 @@ void V3Arrival::process_event() {
         this->station
     );
     if (!this->is_start) {
-        this->sim.v2_cache.station_plans.at(this->station).pop_due_pkg(this->time, this->package);
+        this->sim.policy.v2_cache.station_plans.at(this->station)
+            .pop_due_pkg(this->time, this->package);
     }
     this->sim.stations.at(this->station).buffer.insert(this->package);
+    this->sim.policy.buffer_index.at(this->station).add(this->sim.packages[this->package]);
+    this->sim.policy.v2_cache.station_plans.at(this->station).note_load_change();
 
-    for (const auto& [id, station]: this->sim.stations) {
-        number_package_in_station << this->time << "," << id << ","
-                                  << this->sim.stations.at(id).buffer.size() << "\n";
-    }
-    package_trip << this->time << "," << this->package << "," << this->station << ","
-                 << this->station << "\n";
-    try_due_try(this->time, this->sim, this->station);
+    this->sim.write_occupancy(this->time);
+    this->sim.write_trip(this->time, this->package, this->station, this->station);
+    // 批处理时站点忙到 ready_time，在那之前唤醒只会失败再重排
+    try_due_try(
+        this->sim.policy.batch_window > 0
+            ? std::max(this->time, ready_time(this->sim, this->station))
+            : this->time,
+        this->sim,
+        this->station
+    );
     // this->sim.schedule_event();
     // [test]
     // buffer size
@@ -329,6 +844,7 @@ void V3Arrival::process_event() {
 void V3StartSend::process_event() {
     // turn into fmt
     // std::ofstream file("output.txt", std::ios::app);
+    flush_takes(this->sim, this->time);
     if (this->sim.packages[this->package].dst == this->src) {
         logs(
             "[{:.3f}] {}] StartSend pack {}: {} => {}, time {}",
@@ -349,15 +865,15 @@ void V3StartSend::process_event() {
         this->src,
         this->package,
         this->src,
-        this->sim.routes.at(this->src).at(this->route).dst,
-        this->sim.routes.at(this->src).at(this->route).time
+        this->sim.routes().at(this->src).at(this->route).dst,
+        this->sim.routes().at(this->src).at(this->route).time
     );
     this->sim.schedule_event(new V3Arrival(
         // find src => dst route
-        this->time + this->sim.routes.at(this->src).at(this->route).time,
+        this->time + this->sim.routes().at(this->src).at(this->route).time,
         this->sim,
         this->package,
-        this->sim.routes.at(this->src).at(this->route).dst,
+        this->sim.routes().at(this->src).at(this->route).dst,
         false // not start
     ));
     // try process one right now (but after this StartSend guranteed by event push)
@@ -1,23 +1,31 @@
 #ifndef STRATEGY_V3_HPP
 #define STRATEGY_V3_HPP
 
+#include <algorithm>
 #include <limits>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <queue>
 #include <set>
 #include <sstream>
+#include <tuple>
 
 #include "event.hpp"
 #include "log.hpp"
 #include "rust.hpp"
+#include "pool.hpp"
+#include "strategy/delta.hpp"
+#include "strategy/dense.hpp"
+#include "strategy/v2.hpp"
 
 namespace sim {
+template<typename Policy>
 struct Simulation;
 }
 
 namespace strategy::v3 {
 
-using sim::Simulation;
 using std::greater;
 using std::map;
 using std::multiset;
@@ -27,16 +35,239 @@ using std::priority_queue;
 using std::string;
 using std::vector;
 
-using event::Event;
+using event::SimEvent;
 using log::logs;
 using log::logs_cargo;
+using base::Package;
+using base::PackageCategory;
+using strategy::v2::V2Cache;
 
-struct V3Arrival: public Event {
+// 某站点 buffer 中去往同一终点的包裹
+// 堆懒删除：remove 只记下包裹，等它到堆顶时才弹出，所以可以删除组内任意包裹
+struct DstGroup {
+    int size = 0;
+
+    void add(const Package& pkg);
+    void remove(const Package& pkg);
+    // 组内 DDL 最早的 (ddl, package)；相同 DDL 时 id 较小者在前
+    const pair<double, string>& head() const {
+        return this->by_ddl.front();
+    }
+    double min_ddl() const {
+        return this->head().first;
+    }
+
+    // 以下按需遍历组内包裹，O(组大小)；选包与批处理只用组头，不维护这些聚合值
+    // packages: id -> Package，如 sim.packages
+    template<typename Packages>
+    double earliest_created(const Packages& packages) const {
+        double res = std::numeric_limits<double>::max();
+        this->for_each([&](const string& id) {
+            res = std::min(res, packages.at(id).time_created);
+        });
+        return res;
+    }
+    template<typename Packages>
+    int express_cnt(const Packages& packages) const {
+        int res = 0;
+        this->for_each([&](const string& id) {
+            res += packages.at(id).category == PackageCategory::EXPRESS;
+        });
+        return res;
+    }
+
+private:
+    // (ddl, package) 的小根堆，用 std::push_heap 维护以便遍历
+    vector<pair<double, string>> by_ddl;
+    // 已删除、还留在堆中的项数
+    map<string, int> stale;
+
+    // 弹出堆顶已删除的项，之后堆顶总是组内的包裹
+    void purge();
+    void pop();
+    // 对组内每个包裹调用 f(id)；删除后又加入的包裹在堆中有相同的多项，跳过其中已删除的
+    template<typename F>
+    void for_each(F&& f) const {
+        map<string, int> skip = this->stale;
+        for (const auto& [ddl, id]: this->by_ddl) {
+            auto it = skip.find(id);
+            if (it != skip.end() && it->second > 0) {
+                it->second -= 1;
+                continue;
+            }
+            f(id);
+        }
+    }
+};
+
+// 站点 buffer 按终点分组的索引，与 Station::buffer 同步增删
+struct BufferIndex {
+    map<string, DstGroup> groups;
+
+    void add(const Package& pkg);
+    // pkg 可以是组内任意包裹；删除不在索引中的包裹时直接终止
+    void remove(const Package& pkg);
+};
+
+// 从 src 出发、估计等待时间的最短路树
+struct DijRes {
+    map<string, pair<string, int>> prev;
+    map<string, double> start_send_time_at_min_cost;
+};
+
+DijRes dijkstra_tree(
+    const map<string, Station>& stations,
+    const map<string, map<int, Route>>& routes,
+    string src,
+    double start_process_time,
+    const map<string, v2::StationPlan>& station_plans,
+    double money_coefficient = 1.0,
+    double time_coefficient = 1.667
+);
+
+// 搜索中的一次等待时间估计：plan 在 (now, arrive_time) 下估计为 wait
+// 除此之外树只依赖静态的站点、路线参数，全部估计不变时重新搜索会得到同一棵树
+struct WaitProbe {
+    const v2::StationPlan* plan;
+    double now;
+    double arrive_time;
+    double wait;
+};
+
+// 同 dijkstra_tree，在稠密邻接矩阵上整行松弛，结果逐位相同；probes 非空时记录每次等待时间估计
+// 不写日志与计时，推测执行的线程也可以调用
+DijRes dense_tree(
+    const dense::DenseGraph& graph,
+    const string& src,
+    double start_process_time,
+    const map<string, v2::StationPlan>& station_plans,
+    vector<WaitProbe>* probes = nullptr,
+    double money_coefficient = 1.0,
+    double time_coefficient = 1.667
+);
+
+// 同 dijkstra_tree，在 CSR 邻接表上做 delta-stepping，结果逐位相同；workers 非空时并行估计出边
+// probes 含义同 dense_tree；不写日志与计时
+DijRes delta_tree(
+    const delta::CsrGraph& graph,
+    const string& src,
+    double start_process_time,
+    const map<string, v2::StationPlan>& station_plans,
+    pool::WorkerPool* workers,
+    vector<WaitProbe>* probes = nullptr,
+    double money_coefficient = 1.0,
+    double time_coefficient = 1.667
+);
+
+// 建树用的核：AUTO 在 dense::prefer_dense 时用稠密核，否则用 delta_tree，各核结果相同
+enum struct TreeKernel {
+    AUTO,
+    SPARSE, // 堆与 map 上的 dijkstra_tree
+    DENSE, // dense_tree
+    DELTA, // delta_tree，站点数满足 delta::prefer_parallel 时并行
+};
+
+// 推测执行预先算好的树，及其用到的全部等待时间估计
+struct Speculation {
+    DijRes tree;
+    vector<WaitProbe> probes;
+
+    // 在当前状态下重算每次估计，全部相同才能直接使用 tree
+    bool valid() const;
+};
+
+// 站点最近一次建的树；近似重规划时记下搜索读过等待时间的站点，用它们的负载漂移判断树是否过时
+struct CachedTree {
+    DijRes tree;
+    // tree 中的时间对应的开始处理时间
+    double time = -std::numeric_limits<double>::infinity();
+    vector<const v2::StationPlan*> touched;
+    double drift_base = 0;
+
+    // touched 中各站建树以来的负载漂移之和
+    double drift() const;
+    // 从 probes 记下读过的站点与当前漂移
+    void track(const vector<WaitProbe>& probes);
+    // 把树中的时间平移到 now 开始处理，近似 now 时重建的结果
+    void advance(double now);
+};
+
+// 近似重规划的统计：建树与复用次数；audit 时复用的决策中与精确模式一致的次数
+struct ReplanStats {
+    int built = 0;
+    int reused = 0;
+    int audited = 0;
+    int agreed = 0;
+};
+
+// 批处理中已经决定、还没到开始处理时间的包裹，到 start 时才离开 buffer
+// route 为第一跳路线，已在终点时为 -1；seq 使同一时刻的取出顺序与决定顺序相同
+struct PendingTake {
+    double start;
+    uint64_t seq;
+    string station;
+    string package;
+    int route;
+
+    bool operator>(const PendingTake& other) const {
+        return std::tie(this->start, this->seq) > std::tie(other.start, other.seq);
+    }
+};
+
+// V3: 按估计的 DDL 余量选包，一次 dijkstra_tree 服务所有包裹
+struct V3Policy {
+    using Sim = sim::Simulation<V3Policy>;
+
+    V2Cache v2_cache;
+    // > 0 时开启批处理：一次 TryProcessOne 处理窗口内所有能开始处理的包裹
+    double batch_window = 0;
+    // 批处理决定的包裹按开始处理时间排队，每个 V3 事件处理前先取出到时的，见 flush_takes
+    priority_queue<PendingTake, vector<PendingTake>, greater<>> pending_takes;
+    uint64_t take_seq = 0;
+    // 站点最近一批的最后一个包裹开始处理后，下一次能开始处理的时间
+    map<string, double> batch_ready;
+    map<string, BufferIndex> buffer_index;
+    // > 0 时开启近似重规划：站点上次的树途经站点的负载漂移之和小于 replan_tolerance（小时）
+    // 且建立不到 replan_max_age 时直接复用；为 0 时每次重建，即精确模式
+    double replan_tolerance = 0;
+    double replan_max_age = 1;
+    // 复用时另建一棵精确的树，比较两者选出的包裹与第一跳
+    bool replan_audit = false;
+    map<string, CachedTree> trees;
+    ReplanStats replan_stats;
+    TreeKernel tree_kernel = TreeKernel::AUTO;
+    // delta_tree 并行时的额外工作线程数，为负时取 CPU 核数减一
+    int route_threads = -1;
+
+    void add_station(Sim& sim, const string& id);
+    void add_order(Sim& sim, const string& id, double time, const string& src);
+    // 选用稠密核时第一次调用建立（或从共享场景取得）邻接矩阵，否则返回 nullptr
+    // 推测执行的线程也会调用，只建立一次
+    const dense::DenseGraph* dense_graph_of(const Sim& sim);
+    // 选用 delta_tree 时第一次调用建立 CSR 邻接表（及并行用的工作线程），否则返回 nullptr
+    const delta::CsrGraph* csr_graph_of(const Sim& sim);
+    pool::WorkerPool* route_workers() {
+        return this->workers.get();
+    }
+
+private:
+    std::once_flag dense_once;
+    std::shared_ptr<const dense::DenseGraph> dense_graph;
+    std::once_flag csr_once;
+    std::shared_ptr<const delta::CsrGraph> csr_graph;
+    std::unique_ptr<pool::WorkerPool> workers;
+
+    TreeKernel kernel_of(const Sim& sim) const;
+};
+
+using Simulation = sim::Simulation<V3Policy>;
+
+struct V3Arrival: public SimEvent<Simulation> {
 public:
     V3Arrival(double t, Simulation& sim, string package, string dst, bool is_start):
-        Event(t, sim),
-        package(package),
-        station(dst),
+        SimEvent(t, sim),
+        package(std::move(package)),
+        station(std::move(dst)),
         is_start(is_start) {}
 
     void process_event() override;
@@ -49,12 +280,12 @@ private:
 
 // [可能是送原地，即完成配送]
 // EndProcess
-struct V3StartSend: public Event {
+struct V3StartSend: public SimEvent<Simulation> {
 public:
     V3StartSend(double t, Simulation& sim, string package, string src, int route):
-        Event(t, sim),
-        package(package),
-        src(src),
+        SimEvent(t, sim),
+        package(std::move(package)),
+        src(std::move(src)),
         route(route) {}
 
     void process_event() override;
@@ -66,14 +297,23 @@ private:
 };
 
 // 检查 buffer 和从 buffer 中拿出内容 buffer 必须在同一个 event
-struct V3TryProcessOne: public Event {
+struct V3TryProcessOne: public SimEvent<Simulation> {
 private:
     string station;
+    std::unique_ptr<Speculation> speculation;
+
+    // 近似重规划时可能复用站点上次的树；推测执行的树验证通过时直接使用；否则重新搜索
+    const DijRes& routing_tree();
 
 public:
-    V3TryProcessOne(double t, Simulation& sim, string station): Event(t, sim), station(station) {}
+    V3TryProcessOne(double t, Simulation& sim, string station):
+        SimEvent(t, sim),
+        station(std::move(station)) {}
 
     void process_event() override;
+    // 快照下会走到路径规划时，在同一 tick 其他事件处理前先算 dijkstra_tree
+    bool speculative() const override;
+    void speculate() override;
 };
 
 } // namespace strategy::v3
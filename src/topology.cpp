@@ -0,0 +1,158 @@
+#include "topology.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+#include "log.hpp"
+
+namespace topology {
+
+// b 被 a 支配：同一对站点间 a 的 time 与 cost 都不更大；完全相同时编号小的支配编号大的
+bool dominates(const Route& a, const Route& b) {
+    if (a.time > b.time || a.cost > b.cost) {
+        return false;
+    }
+    return a.time < b.time || a.cost < b.cost || a.id < b.id;
+}
+
+Topology::Topology(
+    const map<string, Station>& stations,
+    const map<string, map<int, Route>>& routes
+) {
+    for (const auto& [id, station]: stations) {
+        this->node_of[id] = this->station_cnt++;
+    }
+    const int n = this->station_cnt;
+    vector<vector<int>> out(n);
+    for (const auto& [src, edges]: routes) {
+        // 按终点分组比较平行路线
+        map<string, vector<const Route*>> parallel;
+        for (const auto& [rid, route]: edges) {
+            parallel[route.dst].push_back(&route);
+            this->route_cnt += 1;
+        }
+        for (const auto& [dst, group]: parallel) {
+            for (const Route* b: group) {
+                const bool dominated = std::any_of(group.begin(), group.end(), [&](const Route* a) {
+                    return a != b && dominates(*a, *b);
+                });
+                if (dominated) {
+                    this->dominated.push_back(b->id);
+                }
+            }
+            out[this->node_of.at(src)].push_back(this->node_of.at(dst));
+        }
+    }
+    std::sort(this->dominated.begin(), this->dominated.end());
+
+    // tarjan：分量按完成顺序编号，后继分量的编号总是更小
+    // 用显式栈模拟递归，长链上也不会耗尽调用栈；frames 中为 (站点, 下一条待看的出边)
+    this->component.assign(n, -1);
+    vector<int> order(n, -1);
+    vector<int> low(n, 0);
+    vector<bool> on_stack(n, false);
+    vector<int> stack;
+    vector<std::pair<int, size_t>> frames;
+    int visited = 0;
+    auto enter = [&](int u) {
+        order[u] = low[u] = visited++;
+        stack.push_back(u);
+        on_stack[u] = true;
+        frames.emplace_back(u, 0);
+    };
+    for (int root = 0; root < n; root++) {
+        if (order[root] != -1) {
+            continue;
+        }
+        enter(root);
+        while (!frames.empty()) {
+            auto& [u, next] = frames.back();
+            if (next < out[u].size()) {
+                const int v = out[u][next++];
+                if (order[v] == -1) {
+                    enter(v);
+                } else if (on_stack[v]) {
+                    low[u] = std::min(low[u], order[v]);
+                }
+                continue;
+            }
+            const int done = u;
+            frames.pop_back();
+            if (!frames.empty()) {
+                const int parent = frames.back().first;
+                low[parent] = std::min(low[parent], low[done]);
+            }
+            if (low[done] != order[done]) {
+                continue;
+            }
+            int size = 0;
+            for (int v = -1; v != done; size++) {
+                v = stack.back();
+                stack.pop_back();
+                on_stack[v] = false;
+                this->component[v] = this->component_cnt;
+            }
+            this->largest_component = std::max(this->largest_component, size);
+            this->component_cnt += 1;
+        }
+    }
+
+    // 分量 c 只能到达编号不超过 c 的分量，reach[c] 只存前 c + 1 位
+    // 按编号从小到大即逆拓扑序，后继分量的集合已经算好，按字并上即可
+    vector<vector<int>> successors(this->component_cnt);
+    for (int u = 0; u < n; u++) {
+        for (int v: out[u]) {
+            if (this->component[u] != this->component[v]) {
+                successors[this->component[u]].push_back(this->component[v]);
+            }
+        }
+    }
+    this->reach.resize(this->component_cnt);
+    for (int c = 0; c < this->component_cnt; c++) {
+        vector<uint64_t>& bits = this->reach[c];
+        bits.assign(c / 64 + 1, 0);
+        bits[c / 64] |= uint64_t(1) << (c % 64);
+        std::sort(successors[c].begin(), successors[c].end());
+        successors[c].erase(
+            std::unique(successors[c].begin(), successors[c].end()),
+            successors[c].end()
+        );
+        for (int d: successors[c]) {
+            const vector<uint64_t>& sub = this->reach[d];
+            for (size_t w = 0; w < sub.size(); w++) {
+                bits[w] |= sub[w];
+            }
+        }
+    }
+}
+
+void Topology::prune(map<string, map<int, Route>>& routes) const {
+    for (auto& [src, edges]: routes) {
+        for (auto it = edges.begin(); it != edges.end();) {
+            const bool dominated =
+                std::binary_search(this->dominated.begin(), this->dominated.end(), it->first);
+            it = dominated ? edges.erase(it) : std::next(it);
+        }
+    }
+}
+
+bool Topology::reachable(const string& src, const string& dst) const {
+    const int a = this->component_of(src);
+    const int b = this->component_of(dst);
+    return b <= a && (this->reach[a][b / 64] >> (b % 64) & 1);
+}
+
+void Topology::log_stats() const {
+    log::logs_cargo(
+        "Graph",
+        "{} stations, {} routes ({} dominated removed), {} strongly connected components, "
+        "largest {}",
+        this->station_cnt,
+        this->route_cnt - (int)this->dominated.size(),
+        this->dominated.size(),
+        this->component_cnt,
+        this->largest_component
+    );
+}
+
+} // namespace topology
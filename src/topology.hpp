@@ -0,0 +1,49 @@
+#ifndef TOPOLOGY_HPP
+#define TOPOLOGY_HPP
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base.hpp"
+
+namespace topology {
+using std::map;
+using std::string;
+using std::vector;
+
+using base::Route;
+using base::Station;
+
+// 读完站点与路线、登记订单之前的图预处理，只依赖拓扑
+// 被支配的平行路线：同一对站点间另有一条 time 与 cost 都不更大的路线（完全相同时保留编号小的）
+// 各策略的边权对 time、cost 单调，这样的路线不会被选中，删去不改变结果
+// 强连通分量与分量间的可达性用于在登记前隔离终点不可达的订单，路径规划只会遇到可达的终点
+struct Topology {
+public:
+    Topology(const map<string, Station>& stations, const map<string, map<int, Route>>& routes);
+
+    // 从 routes 中删去被支配的路线，其余路线编号不变
+    void prune(map<string, map<int, Route>>& routes) const;
+    bool reachable(const string& src, const string& dst) const;
+    int component_of(const string& id) const {
+        return this->component[this->node_of.at(id)];
+    }
+    void log_stats() const;
+
+public:
+    int station_cnt = 0;
+    int route_cnt = 0; // 预处理前
+    vector<int> dominated; // 删去的路线编号，升序
+    int component_cnt = 0;
+    int largest_component = 0;
+
+private:
+    map<string, int> node_of;
+    vector<int> component; // 站点下标 -> 强连通分量
+    vector<vector<uint64_t>> reach; // reach[a] 的第 b 位：分量 a 可以到达分量 b（b <= a）
+};
+
+} // namespace topology
+#endif
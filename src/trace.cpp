@@ -0,0 +1,455 @@
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "rust.hpp"
+
+namespace trace {
+
+// 文件布局（本机字节序）：
+// "DSTRACE1" | 块 ... | 尾部 | u64 尾部偏移 | "DSTRACE1"
+// 块：varint occ 行数, occ 字节数, trip 行数, trip 字节数, event 行数, event 字节数
+//     之后依次是三张表
+//   occ:   时间列 | station 编号差值 | buffer size
+//   trip:  时间列 | package 编号差值 | src 编号差值 | dst - src
+//   event: 时间列 | kind 编号
+//   时间列为若干 (varint 游程长度, f64 时间)；差值均为 zigzag varint
+// 尾部：名字表 (varint 个数, 每个 varint 长度 + 字节)
+//       块目录 (varint 个数, 每个 u64 offset, u64 length, f64 t_min, f64 t_max)
+//       包裹索引 (varint 个数, 每个 varint 名字编号, varint 块数, 块编号差值 varint)
+
+namespace {
+
+constexpr char MAGIC[8] = { 'D', 'S', 'T', 'R', 'A', 'C', 'E', '1' };
+
+template<typename T>
+void put(string& buf, const T& value) {
+    buf.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+void put_varint(string& buf, uint64_t value) {
+    while (value >= 0x80) {
+        buf.push_back(char(value | 0x80));
+        value >>= 7;
+    }
+    buf.push_back(char(value));
+}
+
+void put_zigzag(string& buf, int64_t value) {
+    put_varint(buf, (uint64_t(value) << 1) ^ uint64_t(value >> 63));
+}
+
+void put_times(string& buf, const vector<double>& times) {
+    for (size_t i = 0; i < times.size();) {
+        size_t j = i + 1;
+        while (j < times.size() && times[j] == times[i]) {
+            j++;
+        }
+        put_varint(buf, j - i);
+        put(buf, times[i]);
+        i = j;
+    }
+}
+
+void put_deltas(string& buf, const vector<uint32_t>& ids) {
+    int64_t last = 0;
+    for (uint32_t id: ids) {
+        put_zigzag(buf, int64_t(id) - last);
+        last = id;
+    }
+}
+
+// 只读游标，越界时停在末尾并返回 0
+struct Cursor {
+    const char* p;
+    const char* end;
+
+    template<typename T>
+    T get() {
+        T value {};
+        if (this->end - this->p >= ptrdiff_t(sizeof(T))) {
+            std::memcpy(&value, this->p, sizeof(T));
+            this->p += sizeof(T);
+        } else {
+            this->p = this->end;
+        }
+        return value;
+    }
+
+    uint64_t varint() {
+        uint64_t value = 0;
+        for (int shift = 0; this->p < this->end && shift < 64; shift += 7) {
+            const uint8_t byte = *this->p++;
+            value |= uint64_t(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) {
+                break;
+            }
+        }
+        return value;
+    }
+
+    int64_t zigzag() {
+        const uint64_t value = this->varint();
+        return int64_t(value >> 1) ^ -int64_t(value & 1);
+    }
+
+    vector<double> times(size_t n) {
+        vector<double> res;
+        res.reserve(n);
+        while (res.size() < n && this->p < this->end) {
+            const size_t run = this->varint();
+            const double time = this->get<double>();
+            res.insert(res.end(), std::min(run, n - res.size()), time);
+        }
+        res.resize(n);
+        return res;
+    }
+
+    vector<uint32_t> deltas(size_t n) {
+        vector<uint32_t> res(n);
+        int64_t last = 0;
+        for (size_t i = 0; i < n; i++) {
+            last += this->zigzag();
+            res[i] = uint32_t(last);
+        }
+        return res;
+    }
+};
+
+// 块内三张表的位置
+struct Tables {
+    size_t occ_n, trip_n, event_n;
+    Cursor occ, trip, event;
+
+    explicit Tables(const string& bytes) {
+        Cursor head { bytes.data(), bytes.data() + bytes.size() };
+        this->occ_n = head.varint();
+        const size_t occ_bytes = head.varint();
+        this->trip_n = head.varint();
+        const size_t trip_bytes = head.varint();
+        this->event_n = head.varint();
+        const size_t event_bytes = head.varint();
+        const char* end = head.end;
+        this->occ = Cursor { head.p, std::min(head.p + occ_bytes, end) };
+        this->trip = Cursor { this->occ.end, std::min(this->occ.end + trip_bytes, end) };
+        this->event = Cursor { this->trip.end, std::min(this->trip.end + event_bytes, end) };
+    }
+};
+
+} // namespace
+
+Writer::Writer(const string& path, double chunk_span, size_t chunk_rows):
+    file(path, std::ios::binary | std::ios::trunc),
+    chunk_span(chunk_span),
+    chunk_rows(chunk_rows) {
+    this->write(string(MAGIC, sizeof(MAGIC)));
+}
+
+Writer::~Writer() {
+    this->close();
+}
+
+void Writer::write(const string& bytes) {
+    this->file.write(bytes.data(), bytes.size());
+    this->written += bytes.size();
+}
+
+uint32_t Writer::intern(const string& name) {
+    auto it = this->ids.find(name);
+    if (it != this->ids.end()) {
+        return it->second;
+    }
+    const uint32_t id = this->names.size();
+    this->ids.emplace(name, id);
+    this->names.push_back(name);
+    return id;
+}
+
+void Writer::before_row(double time) {
+    if (this->chunk.rows() > 0
+        && (time >= this->chunk_start + this->chunk_span || this->chunk.rows() >= this->chunk_rows))
+    {
+        this->flush_chunk();
+    }
+    if (this->chunk.rows() == 0) {
+        this->chunk_start = time;
+        this->t_min = time;
+        this->t_max = time;
+    }
+    this->t_min = std::min(this->t_min, time);
+    this->t_max = std::max(this->t_max, time);
+}
+
+void Writer::occupancy(double time, const string& station, int64_t size) {
+    this->before_row(time);
+    this->chunk.occ_time.push_back(time);
+    this->chunk.occ_station.push_back(this->intern(station));
+    this->chunk.occ_size.push_back(size);
+}
+
+void Writer::trip(double time, const string& package, const string& src, const string& dst) {
+    this->before_row(time);
+    const uint32_t package_id = this->intern(package);
+    this->chunk.trip_time.push_back(time);
+    this->chunk.trip_package.push_back(package_id);
+    this->chunk.trip_src.push_back(this->intern(src));
+    this->chunk.trip_dst.push_back(this->intern(dst));
+    vector<uint32_t>& in_chunks = this->package_chunks[package_id];
+    const uint32_t chunk_id = this->chunks.size();
+    if (in_chunks.empty() || in_chunks.back() != chunk_id) {
+        in_chunks.push_back(chunk_id);
+    }
+}
+
+void Writer::event(double time, std::type_index kind) {
+    auto it = this->kind_ids.find(kind);
+    if (it == this->kind_ids.end()) {
+        it = this->kind_ids.emplace(kind, this->intern(rust::demangle(kind.name()))).first;
+    }
+    this->before_row(time);
+    this->chunk.event_time.push_back(time);
+    this->chunk.event_kind.push_back(it->second);
+}
+
+void Writer::flush_chunk() {
+    const Chunk& c = this->chunk;
+    string occ, trip, event;
+    put_times(occ, c.occ_time);
+    put_deltas(occ, c.occ_station);
+    for (int64_t size: c.occ_size) {
+        put_zigzag(occ, size);
+    }
+    put_times(trip, c.trip_time);
+    put_deltas(trip, c.trip_package);
+    put_deltas(trip, c.trip_src);
+    for (size_t i = 0; i < c.trip_dst.size(); i++) {
+        put_zigzag(trip, int64_t(c.trip_dst[i]) - int64_t(c.trip_src[i]));
+    }
+    put_times(event, c.event_time);
+    for (uint32_t kind: c.event_kind) {
+        put_varint(event, kind);
+    }
+
+    string bytes;
+    put_varint(bytes, c.occ_time.size());
+    put_varint(bytes, occ.size());
+    put_varint(bytes, c.trip_time.size());
+    put_varint(bytes, trip.size());
+    put_varint(bytes, c.event_time.size());
+    put_varint(bytes, event.size());
+    bytes += occ;
+    bytes += trip;
+    bytes += event;
+
+    this->chunks.push_back(ChunkInfo { this->written, bytes.size(), this->t_min, this->t_max });
+    this->write(bytes);
+    this->chunk = Chunk {};
+}
+
+void Writer::close() {
+    if (this->closed) {
+        return;
+    }
+    this->closed = true;
+    if (this->chunk.rows() > 0) {
+        this->flush_chunk();
+    }
+    string footer;
+    put_varint(footer, this->names.size());
+    for (const string& name: this->names) {
+        put_varint(footer, name.size());
+        footer += name;
+    }
+    put_varint(footer, this->chunks.size());
+    for (const ChunkInfo& info: this->chunks) {
+        put(footer, info.offset);
+        put(footer, info.length);
+        put(footer, info.t_min);
+        put(footer, info.t_max);
+    }
+    put_varint(footer, this->package_chunks.size());
+    for (const auto& [package, in_chunks]: this->package_chunks) {
+        put_varint(footer, package);
+        put_varint(footer, in_chunks.size());
+        uint32_t last = 0;
+        for (uint32_t chunk: in_chunks) {
+            put_varint(footer, chunk - last);
+            last = chunk;
+        }
+    }
+    put(footer, this->written);
+    footer.append(MAGIC, sizeof(MAGIC));
+    this->write(footer);
+    this->file.flush();
+}
+
+Columns::Columns(const vector<string>& stations, const vector<string>& packages) {
+    for (int32_t i = 0; i < (int32_t)stations.size(); i++) {
+        this->station_ids.emplace(stations[i], i);
+    }
+    for (int32_t i = 0; i < (int32_t)packages.size(); i++) {
+        this->package_ids.emplace(packages[i], i);
+    }
+}
+
+void Columns::occupancy(double time, const string& station, int64_t size) {
+    this->occ_time.push_back(time);
+    this->occ_station.push_back(this->station_ids.at(station));
+    this->occ_size.push_back(static_cast<int32_t>(size));
+}
+
+void Columns::trip(double time, const string& package, const string& src, const string& dst) {
+    this->trip_time.push_back(time);
+    this->trip_package.push_back(this->package_ids.at(package));
+    this->trip_src.push_back(this->station_ids.at(src));
+    this->trip_dst.push_back(this->station_ids.at(dst));
+}
+
+Reader::Reader(const string& path): file(path, std::ios::binary) {
+    char magic[sizeof(MAGIC)];
+    if (!this->file.read(magic, sizeof(magic)) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) {
+        return;
+    }
+    this->file.seekg(0, std::ios::end);
+    const int64_t size = this->file.tellg();
+    if (size < int64_t(2 * sizeof(MAGIC) + sizeof(uint64_t))) {
+        return;
+    }
+    uint64_t footer_offset;
+    this->file.seekg(size - int64_t(sizeof(MAGIC) + sizeof(uint64_t)));
+    this->file.read(reinterpret_cast<char*>(&footer_offset), sizeof(footer_offset));
+    this->file.read(magic, sizeof(magic));
+    if (!this->file || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0
+        || footer_offset > uint64_t(size))
+    {
+        return;
+    }
+
+    string footer(size - footer_offset, '\0');
+    this->file.seekg(footer_offset);
+    this->file.read(footer.data(), footer.size());
+    Cursor cur { footer.data(), footer.data() + footer.size() };
+    this->names.resize(cur.varint());
+    for (string& name: this->names) {
+        const size_t len = cur.varint();
+        name.assign(cur.p, std::min<size_t>(len, cur.end - cur.p));
+        cur.p += name.size();
+    }
+    this->chunks.resize(cur.varint());
+    for (ChunkInfo& info: this->chunks) {
+        info.offset = cur.get<uint64_t>();
+        info.length = cur.get<uint64_t>();
+        info.t_min = cur.get<double>();
+        info.t_max = cur.get<double>();
+    }
+    const size_t package_cnt = cur.varint();
+    for (size_t i = 0; i < package_cnt && cur.p < cur.end; i++) {
+        PackageIndex index { uint32_t(cur.varint()), {} };
+        index.chunks.resize(cur.varint());
+        uint32_t last = 0;
+        for (uint32_t& chunk: index.chunks) {
+            last += cur.varint();
+            chunk = last;
+        }
+        if (index.id < this->names.size()) {
+            this->packages.emplace(this->names[index.id], std::move(index));
+        }
+    }
+    this->ok = bool(this->file);
+}
+
+double Reader::begin_time() const {
+    double res = 0;
+    for (size_t i = 0; i < this->chunks.size(); i++) {
+        res = i == 0 ? this->chunks[i].t_min : std::min(res, this->chunks[i].t_min);
+    }
+    return res;
+}
+
+double Reader::end_time() const {
+    double res = 0;
+    for (size_t i = 0; i < this->chunks.size(); i++) {
+        res = i == 0 ? this->chunks[i].t_max : std::max(res, this->chunks[i].t_max);
+    }
+    return res;
+}
+
+string Reader::load(uint32_t chunk) const {
+    const ChunkInfo& info = this->chunks.at(chunk);
+    string bytes(info.length, '\0');
+    this->file.clear();
+    this->file.seekg(info.offset);
+    this->file.read(bytes.data(), bytes.size());
+    return bytes;
+}
+
+Window Reader::window(double t0, double t1) const {
+    Window res;
+    auto name = [&](uint32_t id) -> const string& { return this->names.at(id); };
+    for (uint32_t i = 0; i < this->chunks.size(); i++) {
+        if (this->chunks[i].t_max < t0 || this->chunks[i].t_min > t1) {
+            continue;
+        }
+        const string bytes = this->load(i);
+        Tables t(bytes);
+
+        const vector<double> occ_time = t.occ.times(t.occ_n);
+        const vector<uint32_t> station = t.occ.deltas(t.occ_n);
+        for (size_t j = 0; j < t.occ_n; j++) {
+            const int64_t size = t.occ.zigzag();
+            if (t0 <= occ_time[j] && occ_time[j] <= t1) {
+                res.occupancy.push_back(OccupancyRow { occ_time[j], name(station[j]), size });
+            }
+        }
+
+        const vector<double> trip_time = t.trip.times(t.trip_n);
+        const vector<uint32_t> package = t.trip.deltas(t.trip_n);
+        const vector<uint32_t> src = t.trip.deltas(t.trip_n);
+        for (size_t j = 0; j < t.trip_n; j++) {
+            const uint32_t dst = src[j] + t.trip.zigzag();
+            if (t0 <= trip_time[j] && trip_time[j] <= t1) {
+                res.trips.push_back(
+                    TripRow { trip_time[j], name(package[j]), name(src[j]), name(dst) }
+                );
+            }
+        }
+
+        const vector<double> event_time = t.event.times(t.event_n);
+        for (size_t j = 0; j < t.event_n; j++) {
+            const uint32_t kind = t.event.varint();
+            if (t0 <= event_time[j] && event_time[j] <= t1) {
+                res.events.push_back(EventRow { event_time[j], name(kind) });
+            }
+        }
+    }
+    return res;
+}
+
+vector<TripRow> Reader::trip(const string& package) const {
+    vector<TripRow> res;
+    auto it = this->packages.find(package);
+    if (it == this->packages.end()) {
+        return res;
+    }
+    const PackageIndex& index = it->second;
+    for (uint32_t i: index.chunks) {
+        const string bytes = this->load(i);
+        Tables t(bytes);
+        // 只解码 trip 表
+        const vector<double> time = t.trip.times(t.trip_n);
+        const vector<uint32_t> packages = t.trip.deltas(t.trip_n);
+        const vector<uint32_t> src = t.trip.deltas(t.trip_n);
+        for (size_t j = 0; j < t.trip_n; j++) {
+            const uint32_t dst = src[j] + t.trip.zigzag();
+            if (packages[j] == index.id) {
+                res.push_back(
+                    TripRow { time[j], package, this->names.at(src[j]), this->names.at(dst) }
+                );
+            }
+        }
+    }
+    return res;
+}
+
+} // namespace trace
@@ -0,0 +1,168 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <string>
+#include <typeindex>
+#include <unordered_map>
+#include <vector>
+
+namespace trace {
+using std::map;
+using std::string;
+using std::vector;
+
+// 列式 trace：按模拟时间切块，每块内三张表（occupancy / trip / event）按列存放
+// 时间列游程编码（同一快照的多行时间相同），名字编号列存差值的 zigzag varint
+// 文件尾部是名字表、块目录（偏移、长度、时间范围）和包裹 -> 块的索引
+// 读取时只解码与查询相交的块，UI 打开大文件不必全部读入；格式见 trace.cpp
+
+// 某站点在 time 时 buffer 中的包裹数，对应 number_package_in_station.csv
+struct OccupancyRow {
+    double time;
+    string station;
+    int64_t size;
+};
+
+// 对应 package_trip.csv：src == dst 表示到达或在终点处理
+struct TripRow {
+    double time;
+    string package;
+    string src;
+    string dst;
+};
+
+// 处理了一个 kind 类型的事件
+struct EventRow {
+    double time;
+    string kind;
+};
+
+struct Window {
+    vector<OccupancyRow> occupancy;
+    vector<TripRow> trips;
+    vector<EventRow> events;
+};
+
+// 块目录的一项：块在文件中的位置与其中行的时间范围（批处理的 trip 时间可能早于事件时间）
+struct ChunkInfo {
+    uint64_t offset;
+    uint64_t length;
+    double t_min;
+    double t_max;
+};
+
+struct Writer {
+public:
+    // chunk_span: 每块覆盖的模拟时间；块内行数超过 chunk_rows 时也会提前切块
+    explicit Writer(const string& path, double chunk_span = 24, size_t chunk_rows = 1 << 16);
+    ~Writer();
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+
+    void occupancy(double time, const string& station, int64_t size);
+    void trip(double time, const string& package, const string& src, const string& dst);
+    // kind 取 demangle 后的事件类型名
+    void event(double time, std::type_index kind);
+    // 写出最后一块和尾部索引，析构时也会调用
+    void close();
+
+private:
+    struct Chunk {
+        vector<double> occ_time;
+        vector<uint32_t> occ_station;
+        vector<int64_t> occ_size;
+        vector<double> trip_time;
+        vector<uint32_t> trip_package;
+        vector<uint32_t> trip_src;
+        vector<uint32_t> trip_dst;
+        vector<double> event_time;
+        vector<uint32_t> event_kind;
+
+        size_t rows() const {
+            return occ_time.size() + trip_time.size() + event_time.size();
+        }
+    };
+
+    std::ofstream file;
+    double chunk_span;
+    size_t chunk_rows;
+    bool closed = false;
+
+    std::unordered_map<string, uint32_t> ids;
+    std::unordered_map<std::type_index, uint32_t> kind_ids;
+    vector<string> names;
+    uint64_t written = 0;
+    Chunk chunk;
+    double chunk_start = 0;
+    double t_min = 0;
+    double t_max = 0;
+    vector<ChunkInfo> chunks;
+    // 包裹名字编号 -> 出现过的块（递增）
+    map<uint32_t, vector<uint32_t>> package_chunks;
+
+    uint32_t intern(const string& name);
+    void before_row(double time);
+    void flush_chunk();
+    void write(const string& bytes);
+};
+
+// 内存中的 occupancy / trip 列，与两个 CSV 的列对应，名字换成构造时给出的顺序编号
+// 供 C API 直接把各列交给调用方，不经过文本
+struct Columns {
+public:
+    Columns(const vector<string>& stations, const vector<string>& packages);
+
+    vector<double> occ_time;
+    vector<int32_t> occ_station;
+    vector<int32_t> occ_size;
+    vector<double> trip_time;
+    vector<int32_t> trip_package;
+    vector<int32_t> trip_src;
+    vector<int32_t> trip_dst;
+
+    void occupancy(double time, const string& station, int64_t size);
+    void trip(double time, const string& package, const string& src, const string& dst);
+
+private:
+    std::unordered_map<string, int32_t> station_ids;
+    std::unordered_map<string, int32_t> package_ids;
+};
+
+struct Reader {
+public:
+    explicit Reader(const string& path);
+
+    bool is_open() const {
+        return this->ok;
+    }
+    size_t chunk_cnt() const {
+        return this->chunks.size();
+    }
+    double begin_time() const;
+    double end_time() const;
+
+    // [t0, t1] 内的所有行，块内顺序与写入顺序一致
+    Window window(double t0, double t1) const;
+    // 某个包裹的全部 trip 行
+    vector<TripRow> trip(const string& package) const;
+
+private:
+    struct PackageIndex {
+        uint32_t id;
+        vector<uint32_t> chunks;
+    };
+
+    mutable std::ifstream file;
+    bool ok = false;
+    vector<string> names;
+    vector<ChunkInfo> chunks;
+    std::unordered_map<string, PackageIndex> packages;
+
+    string load(uint32_t chunk) const;
+};
+
+} // namespace trace
+#endif